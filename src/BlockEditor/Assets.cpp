@@ -1,21 +1,31 @@
 #include "stdafx.h"
 #include "Assets.h"
 #include "Core.h"
+#include "Tile.h"
 #include "map_shader.h"
 #include "sprite_shader.h"
 #include "font_dejavu.h"
 
 static Assets* _instance = nullptr;
+static std::once_flag _instanceFlag;
+static bool _headless = false;
 
 Assets* Assets::_Get()
 {
-    if (!_instance)
-    {
-        _instance = new Assets();
-    }
+    std::call_once(_instanceFlag, []() { _instance = new Assets(); });
     return _instance;
 };
 
+void Assets::SetHeadless(bool headless)
+{
+    _headless = headless;
+}
+
+bool Assets::IsHeadless()
+{
+    return _headless;
+}
+
 Assets::ModelHandle::ModelHandle(std::filesystem::path path)
 {
     _path = path;
@@ -172,9 +182,39 @@ Assets::ModelHandle::ModelHandle(std::filesystem::path path)
     {
         mesh.indices[i] = meshInds[i];
     }
-    UploadMesh(&mesh, false);
+    if (!_headless) UploadMesh(&mesh, false);
 
     _model.meshes[m] = mesh;
+
+    // Pre-transform the geometry into every orientation that tiles can have
+    _orientedMeshes.resize(TILE_ORIENTATION_COUNT * _model.meshCount);
+    for (int o = 0; o < TILE_ORIENTATION_COUNT; ++o)
+    {
+        const Matrix& rotation = TileOrientationMatrices()[o];
+        for (int i = 0; i < _model.meshCount; ++i)
+        {
+            const RLMesh& srcMesh = _model.meshes[i];
+            OrientedMesh& oriented = _orientedMeshes[o * _model.meshCount + i];
+            oriented.positions.resize(srcMesh.vertexCount);
+            oriented.normals.resize(srcMesh.vertexCount);
+            for (int v = 0; v < srcMesh.vertexCount; ++v)
+            {
+                oriented.positions[v] = Vector3Transform(Vector3{ srcMesh.vertices[v * 3], srcMesh.vertices[v * 3 + 1], srcMesh.vertices[v * 3 + 2] }, rotation);
+                oriented.normals[v] = Vector3Transform(Vector3{ srcMesh.normals[v * 3], srcMesh.normals[v * 3 + 1], srcMesh.normals[v * 3 + 2] }, rotation);
+            }
+
+            if (srcMesh.indices == NULL) continue;
+            oriented.planes.resize(srcMesh.triangleCount);
+            for (int t = 0; t < srcMesh.triangleCount; ++t)
+            {
+                const Vector3& v0 = oriented.positions[srcMesh.indices[t * 3 + 0]];
+                const Vector3& v1 = oriented.positions[srcMesh.indices[t * 3 + 1]];
+                const Vector3& v2 = oriented.positions[srcMesh.indices[t * 3 + 2]];
+                Vector3 normal = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(v1, v0), Vector3Subtract(v2, v0)));
+                oriented.planes[t] = Vector4{ normal.x, normal.y, normal.z, -Vector3DotProduct(normal, v0) };
+            }
+        }
+    }
 }
 
 Assets::ModelHandle::~ModelHandle()
@@ -184,6 +224,9 @@ Assets::ModelHandle::~ModelHandle()
 
 Assets::Assets()
 {
+    // Without a graphics context, there is nothing to create the built-in assets with.
+    if (_headless) return;
+
     // Generate missing texture image (a black-and-magenta checkerboard)
     RLImage texImg = { 0 };
     texImg.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8;
@@ -220,6 +263,26 @@ Assets::Assets()
     _mapShaderInstanced.locs[SHADER_LOC_VECTOR_VIEW] = GetShaderLocation(_mapShaderInstanced, "viewPos");
     _mapShaderInstanced.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(_mapShaderInstanced, "instanceTransform");
 
+    // Initialize the instanced shader that takes packed tile instances
+    _mapShaderPacked = LoadShaderFromMemory(MAP_SHADER_PACKED_V_SRC, MAP_SHADER_F_SRC);
+    _mapShaderPacked.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(_mapShaderPacked, "mvp");
+    _mapShaderPacked.locs[SHADER_LOC_VECTOR_VIEW] = GetShaderLocation(_mapShaderPacked, "viewPos");
+    _mapShaderPacked.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(_mapShaderPacked, "instanceData");
+    _mapShaderPacked.locs[SHADER_LOC_CEL_SPACING] = GetShaderLocation(_mapShaderPacked, "celSpacing");
+    {
+        // The orientations never change, so they are uploaded once as the columns of their rotation matrices.
+        float axes[TILE_ORIENTATION_COUNT * 9];
+        for (int o = 0; o < TILE_ORIENTATION_COUNT; ++o)
+        {
+            const Matrix& m = TileOrientationMatrices()[o];
+            const float columns[9] = { m.m0, m.m1, m.m2, m.m4, m.m5, m.m6, m.m8, m.m9, m.m10 };
+            memcpy(&axes[o * 9], columns, sizeof(columns));
+        }
+        rlEnableShader(_mapShaderPacked.id);
+        rlSetUniform(GetShaderLocation(_mapShaderPacked, "orientationAxes"), axes, SHADER_UNIFORM_VEC3, TILE_ORIENTATION_COUNT * 3);
+        rlDisableShader();
+    }
+
     _mapShader = LoadShaderFromMemory(MAP_SHADER_V_SRC, MAP_SHADER_F_SRC);
     _mapShader.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(_mapShader, "mvp");
     _mapShader.locs[SHADER_LOC_VECTOR_VIEW] = GetShaderLocation(_mapShader, "viewPos");
@@ -276,6 +339,11 @@ const RLShader& Assets::GetMapShader(bool instanced)
     return instanced ? _Get()->_mapShaderInstanced : _Get()->_mapShader;
 }
 
+const RLShader& Assets::GetPackedMapShader()
+{
+    return _Get()->_mapShaderPacked;
+}
+
 const RLShader& Assets::GetSpriteShader()
 {
     return _Get()->_spriteShader;
@@ -299,6 +367,7 @@ RLTexture Assets::GetMissingTexture()
 std::shared_ptr<Assets::TexHandle> Assets::GetTexture(std::filesystem::path texturePath)
 {
     Assets* a = _Get();
+    std::lock_guard<std::mutex> lock(a->_cacheMutex);
     //Attempt to find the texture in the cache
     if (a->_textures.find(texturePath) != a->_textures.end())
     {
@@ -309,12 +378,22 @@ std::shared_ptr<Assets::TexHandle> Assets::GetTexture(std::filesystem::path text
         }
     }
 
-    //Load the texture if it is no longer stored in the cache
-    RLTexture2D texture = LoadTexture(texturePath.string().c_str());
+    //Load the texture if it is no longer stored in the cache. Headless, only the path is kept.
+    RLTexture2D texture = { 0 };
+    bool missing = false;
+    if (_headless)
+    {
+        missing = !std::filesystem::is_regular_file(texturePath);
+    }
+    else
+    {
+        texture = LoadTexture(texturePath.string().c_str());
+        missing = (texture.width == 0);
+    }
     //Replace with the checkerboard texture if the file didn't load
-    if (texture.width == 0) texture = a->_missingTexture;
+    if (missing) texture = a->_missingTexture;
 
-    auto sharedPtr = std::make_shared<TexHandle>(texture, texturePath);
+    auto sharedPtr = std::make_shared<TexHandle>(texture, texturePath, missing);
     //Cache the texture
     a->_textures[texturePath] = std::weak_ptr<TexHandle>(sharedPtr);
     return sharedPtr;
@@ -323,6 +402,7 @@ std::shared_ptr<Assets::TexHandle> Assets::GetTexture(std::filesystem::path text
 std::shared_ptr<Assets::ModelHandle> Assets::GetModel(std::filesystem::path path)
 {
     Assets* a = _Get();
+    std::lock_guard<std::mutex> lock(a->_cacheMutex);
     //Attempt to find the model in the cache
     if (a->_models.find(path) != a->_models.end())
     {
@@ -5,6 +5,7 @@
 // A repository that caches all loaded resources and their file paths.
 // It is implemented as a singleton with a static interface. 
 // (This circumvents certain limitations regarding static members and allows the constructor to be called automatically when the first method is called.)
+// Textures and models can be requested from several threads at once.
 class Assets
 {
 public:
@@ -12,13 +13,16 @@ public:
 	class TexHandle
 	{
 	public:
-		inline TexHandle(RLTexture2D texture, std::filesystem::path path) { _texture = texture; _path = path; }
-		inline ~TexHandle() { UnloadTexture(_texture); }
+		inline TexHandle(RLTexture2D texture, std::filesystem::path path, bool missing) { _texture = texture; _path = path; _missing = missing; }
+		inline ~TexHandle() { if (!_missing) UnloadTexture(_texture); }
 		inline RLTexture2D GetTexture() const { return _texture; }
 		inline std::filesystem::path GetPath() const { return _path; }
+		// Returns true if the file couldn't be loaded, in which case the texture is the shared missing texture.
+		inline bool IsMissing() const { return _missing; }
 	private:
 		RLTexture2D _texture;
 		std::filesystem::path _path;
+		bool _missing;
 	};
 
 	//A RAII wrapper for a Raylib Model (unloads on destruction)
@@ -30,16 +34,33 @@ public:
 		~ModelHandle();
 		inline RLModel GetModel() const { return _model; }
 		inline std::filesystem::path GetPath() const { return _path; }
+
+		// The geometry of one of the model's meshes, rotated into one of the tile orientations.
+		struct OrientedMesh
+		{
+			std::vector<Vector3> positions;
+			std::vector<Vector3> normals;
+			std::vector<Vector4> planes; // Plane of each triangle, with the normal in xyz and the distance from the origin in w.
+		};
+		// Returns the mesh's geometry rotated by TileOrientationMatrices()[orientation].
+		inline const OrientedMesh& GetOrientedMesh(int orientation, int mesh) const { return _orientedMeshes[orientation * _model.meshCount + mesh]; }
 	private:
 		RLModel _model;
 		std::filesystem::path _path;
+		std::vector<OrientedMesh> _orientedMeshes; // Every mesh in every orientation, ordered by orientation and then by mesh.
 	};
 
 	static std::shared_ptr<TexHandle>   GetTexture(std::filesystem::path path); //Returns a shared pointer to the cached texture at `path`, loading it if it hasn't been loaded.
 	static std::shared_ptr<ModelHandle> GetModel(std::filesystem::path path);   //Returns a shared pointer to the cached model at `path`, loading it if it hasn't been loaded.
 
+	// Makes assets load without a graphics context, for converting maps from the command line. Textures only keep their paths,
+	// models only keep their geometry in memory, and the shaders, font and other built-in assets are left empty. Must be called before any other method.
+	static void SetHeadless(bool headless);
+	static bool IsHeadless();
+
 	static const Font& GetFont(); //Returns the default application font (dejavu.fnt)
 	static const RLShader& GetMapShader(bool instanced); //Returns the shader used to render tiles
+	static const RLShader& GetPackedMapShader(); //Returns the instanced tile shader that takes TileInstances. The grid spacing is set when drawing with it.
 	static const RLShader& GetSpriteShader(); // Returns the shader used to render billboards
 	static const RLModel& GetEntSphere(); //Returns the sphere that represents entities visually
 	static const RLMesh& GetSpriteQuad();
@@ -48,15 +69,17 @@ protected:
 	//Asset caches that hold weak references to all the loaded textures and models
 	std::map<std::filesystem::path, std::weak_ptr<TexHandle>>   _textures;
 	std::map<std::filesystem::path, std::weak_ptr<ModelHandle>> _models;
+	std::mutex _cacheMutex; // Guards both caches
 
 	//Assets that are alive the whole application
-	Font _font; //Default application font (dejavu.fnt)
-	RLTexture2D _missingTexture; //RLTexture to display when the texture file to be loaded isn't found
-	RLModel _entSphere; //The sphere that represents entities visually
-	RLShader _mapShader; //The non-instanced version that is used to render tiles outside of the map itself
-	RLShader _mapShaderInstanced; //The instanced version is used to render the tiles
-	RLShader _spriteShader;
-	RLMesh _spriteQuad;
+	Font _font{}; //Default application font (dejavu.fnt)
+	RLTexture2D _missingTexture{}; //RLTexture to display when the texture file to be loaded isn't found
+	RLModel _entSphere{}; //The sphere that represents entities visually
+	RLShader _mapShader{}; //The non-instanced version that is used to render tiles outside of the map itself
+	RLShader _mapShaderInstanced{}; //The instanced version is used to render the tiles
+	RLShader _mapShaderPacked{}; //Instanced version that expands packed tile instances instead of taking matrices
+	RLShader _spriteShader{};
+	RLMesh _spriteQuad{};
 private:
 	Assets();
 	~Assets();
@@ -0,0 +1,155 @@
+#pragma once
+
+// The baked map format: a binary file that a game can map into memory and draw from without parsing anything.
+// This header only depends on the standard library, so that it can be copied into a runtime as it is.
+//
+// Layout (all numbers are little-endian, and every table and blob starts on a BAKED_MAP_ALIGNMENT byte boundary):
+//   BakedMapHeader
+//   BakedChunk[chunkCount]        Chunks with geometry, each pointing to a run of ranges
+//   BakedRange[rangeCount]        Draw ranges, each with one material and its own vertex and index blobs
+//   BakedMaterial[materialCount]
+//   BakedEntity[entityCount]
+//   Strings                       UTF-8 texture paths and entity properties, not null terminated
+//   Blobs                         Interleaved BakedVertex arrays and 16-bit triangle list indices
+
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+#define BAKED_MAP_MAGIC 0x504D4254u // "TBMP"
+#define BAKED_MAP_VERSION 1
+#define BAKED_MAP_ALIGNMENT 16
+
+static_assert(std::endian::native == std::endian::little, "Baked maps are little-endian, and are read and written in place");
+
+struct BakedMapHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexStride; // sizeof(BakedVertex)
+	uint32_t indexSize; // Bytes per index
+	float spacing; // Size of a cel in world units
+	int32_t chunkSize; // Cels along each side of a chunk, or 0 if the whole map is one chunk
+	int32_t chunkCounts[3]; // Chunks along X, Y and Z. A chunk's index is (y * countZ + z) * countX + x.
+	uint32_t chunkCount, rangeCount, materialCount, entityCount;
+	uint32_t reserved[3];
+	uint64_t chunkTableOffset, rangeTableOffset, materialTableOffset, entityTableOffset;
+	uint64_t stringsOffset, stringsSize;
+};
+static_assert(sizeof(BakedMapHeader) == 112, "BakedMapHeader must not have padding");
+
+struct BakedChunk
+{
+	int32_t coords[3]; // Position in chunks
+	uint32_t firstRange, rangeCount;
+	float boundsMin[3], boundsMax[3];
+	uint32_t reserved;
+};
+static_assert(sizeof(BakedChunk) == 48, "BakedChunk must not have padding");
+
+struct BakedRange
+{
+	uint32_t material;
+	uint32_t vertexCount, indexCount;
+	uint32_t reserved;
+	uint64_t vertexOffset, indexOffset; // From the start of the file
+};
+static_assert(sizeof(BakedRange) == 32, "BakedRange must not have padding");
+
+struct BakedMaterial
+{
+	uint32_t textureOffset, textureLength; // Texture path in the strings, relative to the map file
+	uint32_t reserved[2];
+};
+static_assert(sizeof(BakedMaterial) == 16, "BakedMaterial must not have padding");
+
+struct BakedEntity
+{
+	float position[3];
+	float radius;
+	float yaw, pitch; // Degrees
+	uint8_t color[4];
+	uint32_t propertiesOffset, propertiesLength; // JSON object in the strings, with the same fields as the glTF export's extras
+	uint32_t reserved[3];
+};
+static_assert(sizeof(BakedEntity) == 48, "BakedEntity must not have padding");
+
+struct BakedVertex
+{
+	float position[3];
+	float normal[3];
+	float texcoord[2];
+};
+static_assert(sizeof(BakedVertex) == 32, "BakedVertex must not have padding");
+
+// Read-only view of a baked map in memory, such as a mapped file. Nothing is copied or converted: the vertex and index blobs
+// can be handed to the GPU straight from the pointers it returns. The memory has to stay valid while the view is in use.
+class BakedMapView
+{
+public:
+	// Checks the header, and that every table and blob lies inside of the `size` bytes at `data`. Returns false if it isn't a valid baked map of this version.
+	bool Open(const void* data, size_t size)
+	{
+		_data = static_cast<const uint8_t*>(data);
+		_size = size;
+		if (_data == nullptr || _size < sizeof(BakedMapHeader) || reinterpret_cast<uintptr_t>(_data) % alignof(uint64_t) != 0) return _Fail();
+
+		const BakedMapHeader& header = GetHeader();
+		if (header.magic != BAKED_MAP_MAGIC || header.version != BAKED_MAP_VERSION) return _Fail();
+		if (header.vertexStride != sizeof(BakedVertex) || header.indexSize != sizeof(uint16_t)) return _Fail();
+		if (!_Contains(header.chunkTableOffset, uint64_t(header.chunkCount) * sizeof(BakedChunk))
+			|| !_Contains(header.rangeTableOffset, uint64_t(header.rangeCount) * sizeof(BakedRange))
+			|| !_Contains(header.materialTableOffset, uint64_t(header.materialCount) * sizeof(BakedMaterial))
+			|| !_Contains(header.entityTableOffset, uint64_t(header.entityCount) * sizeof(BakedEntity))
+			|| !_Contains(header.stringsOffset, header.stringsSize)) return _Fail();
+
+		for (const BakedChunk& chunk : GetChunks())
+		{
+			if (uint64_t(chunk.firstRange) + chunk.rangeCount > header.rangeCount) return _Fail();
+		}
+		for (const BakedRange& range : std::span<const BakedRange>(_At<BakedRange>(header.rangeTableOffset), header.rangeCount))
+		{
+			if (range.material >= header.materialCount) return _Fail();
+			if (!_Contains(range.vertexOffset, uint64_t(range.vertexCount) * sizeof(BakedVertex))) return _Fail();
+			if (!_Contains(range.indexOffset, uint64_t(range.indexCount) * sizeof(uint16_t))) return _Fail();
+		}
+		for (const BakedMaterial& material : GetMaterials())
+		{
+			if (uint64_t(material.textureOffset) + material.textureLength > header.stringsSize) return _Fail();
+		}
+		for (const BakedEntity& entity : GetEntities())
+		{
+			if (uint64_t(entity.propertiesOffset) + entity.propertiesLength > header.stringsSize) return _Fail();
+		}
+		return true;
+	}
+
+	const BakedMapHeader& GetHeader() const { return *_At<BakedMapHeader>(0); }
+	std::span<const BakedChunk> GetChunks() const { return { _At<BakedChunk>(GetHeader().chunkTableOffset), GetHeader().chunkCount }; }
+	std::span<const BakedRange> GetRanges(const BakedChunk& chunk) const { return { _At<BakedRange>(GetHeader().rangeTableOffset) + chunk.firstRange, chunk.rangeCount }; }
+	std::span<const BakedMaterial> GetMaterials() const { return { _At<BakedMaterial>(GetHeader().materialTableOffset), GetHeader().materialCount }; }
+	std::span<const BakedEntity> GetEntities() const { return { _At<BakedEntity>(GetHeader().entityTableOffset), GetHeader().entityCount }; }
+
+	std::span<const BakedVertex> GetVertices(const BakedRange& range) const { return { _At<BakedVertex>(range.vertexOffset), range.vertexCount }; }
+	std::span<const uint16_t> GetIndices(const BakedRange& range) const { return { _At<uint16_t>(range.indexOffset), range.indexCount }; }
+
+	std::string_view GetTexturePath(const BakedMaterial& material) const { return _String(material.textureOffset, material.textureLength); }
+	std::string_view GetProperties(const BakedEntity& entity) const { return _String(entity.propertiesOffset, entity.propertiesLength); }
+private:
+	const uint8_t* _data = nullptr;
+	size_t _size = 0;
+
+	template<class T>
+	const T* _At(uint64_t offset) const { return reinterpret_cast<const T*>(_data + offset); }
+	std::string_view _String(uint32_t offset, uint32_t length) const { return { _At<char>(GetHeader().stringsOffset + offset), length }; }
+	// Returns true if the `length` bytes at `offset` are inside of the data, and the offset is aligned.
+	bool _Contains(uint64_t offset, uint64_t length) const { return offset % BAKED_MAP_ALIGNMENT == 0 && offset <= _size && length <= _size - offset; }
+	bool _Fail()
+	{
+		_data = nullptr;
+		_size = 0;
+		return false;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "stdafx.h"
+#include "BoxColliders.h"
+
+std::vector<ColliderBox> MergeColliderBoxes(std::vector<uint8_t> cels, int width, int height, int length)
+{
+	auto index = [&](int i, int j, int k) { return size_t(i) + (size_t(k) * width) + (size_t(j) * width * length); };
+	// Returns true if every cel in the row of `w` cels starting at (i, j, k) still needs a box
+	auto rowIsSet = [&](int i, int j, int k, int w)
+		{
+			const uint8_t* row = &cels[index(i, j, k)];
+			return std::all_of(row, row + w, [](uint8_t cel) { return cel != 0; });
+		};
+
+	std::vector<ColliderBox> boxes;
+	for (int j = 0; j < height; ++j)
+	{
+		for (int k = 0; k < length; ++k)
+		{
+			for (int i = 0; i < width; ++i)
+			{
+				if (!cels[index(i, j, k)]) continue;
+
+				ColliderBox box = { i, j, k, 1, 1, 1 };
+				while (i + box.width < width && cels[index(i + box.width, j, k)]) ++box.width;
+				while (k + box.length < length && rowIsSet(i, j, k + box.length, box.width)) ++box.length;
+				while (j + box.height < height)
+				{
+					bool layerIsSet = true;
+					for (int z = k; z < k + box.length && layerIsSet; ++z) layerIsSet = rowIsSet(i, j + box.height, z, box.width);
+					if (!layerIsSet) break;
+					++box.height;
+				}
+
+				// Covered cels are cleared, so that later boxes don't overlap this one
+				for (int y = j; y < j + box.height; ++y)
+				{
+					for (int z = k; z < k + box.length; ++z)
+					{
+						memset(&cels[index(i, y, z)], 0, box.width);
+					}
+				}
+				boxes.push_back(box);
+			}
+		}
+	}
+	return boxes;
+}
\ No newline at end of file
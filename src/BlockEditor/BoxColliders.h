@@ -0,0 +1,13 @@
+#pragma once
+
+// An axis aligned box of cels, with its lowest corner at cel (x, y, z).
+struct ColliderBox
+{
+	int x, y, z;
+	int width, height, length;
+};
+
+// Covers the cels that are set in `cels` (one byte per cel, in Grid::FlatIndex() order) with boxes that don't overlap.
+// Starting from the first cel that isn't covered yet, each box is grown along X, then Z, then Y for as long as every cel it takes is set.
+// This isn't guaranteed to find the fewest boxes, but on tile maps it comes close, in time linear in the number of cels.
+std::vector<ColliderBox> MergeColliderBoxes(std::vector<uint8_t> cels, int width, int height, int length);
\ No newline at end of file
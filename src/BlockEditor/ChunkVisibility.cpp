@@ -0,0 +1,134 @@
+#include "stdafx.h"
+#include "ChunkVisibility.h"
+#include "WorkerPool.h"
+
+// What a cel does to the lines of sight through it
+enum class SightCel : uint8_t
+{
+	OPEN,      // Empty, so lines of sight pass through
+	OPEN_TILE, // Has a tile that doesn't block, which can be seen as lines of sight pass through
+	SOLID,     // Has a cube tile, which can be seen but stops lines of sight
+};
+
+ChunkVisibility ComputeChunkVisibility(const TileGrid& grid, int chunkSize)
+{
+	ChunkVisibility visibility;
+	visibility.chunkCounts = grid.GetModelChunkCounts(chunkSize);
+	visibility.chunkCount = grid.GetModelChunkCount(chunkSize);
+	visibility.rowSize = (visibility.chunkCount + 7) / 8;
+	visibility.bits.assign(visibility.chunkCount * visibility.rowSize, 0);
+
+	const int size[3] = { int(grid.GetWidth()), int(grid.GetHeight()), int(grid.GetLength()) };
+	const std::array<int, 3>& counts = visibility.chunkCounts;
+	auto chunkOf = [&](int i, int j, int k) { return (size_t(j / chunkSize) * counts[2] + (k / chunkSize)) * counts[0] + (i / chunkSize); };
+
+	const std::vector<uint8_t> solid = grid.GetCubeCels();
+	std::vector<SightCel> cels(solid.size());
+	WorkerPool::ParallelFor(size[1], [&](size_t j)
+		{
+			for (int k = 0; k < size[2]; ++k)
+			{
+				for (int i = 0; i < size[0]; ++i)
+				{
+					const size_t cel = grid.FlatIndex(i, int(j), k);
+					cels[cel] = solid[cel] ? SightCel::SOLID : (grid.HasTile(i, int(j), k) ? SightCel::OPEN_TILE : SightCel::OPEN);
+				}
+			}
+		});
+
+	// The chunks that a viewer can stand in see themselves
+	for (int j = 0; j < size[1]; ++j)
+	{
+		for (int k = 0; k < size[2]; ++k)
+		{
+			for (int i = 0; i < size[0]; ++i)
+			{
+				if (cels[grid.FlatIndex(i, j, k)] == SightCel::SOLID) continue;
+				const size_t chunk = chunkOf(i, j, k);
+				visibility.bits[chunk * visibility.rowSize + chunk / 8] |= uint8_t(1 << (chunk % 8));
+			}
+		}
+	}
+
+	// The viewing chunks are split into blocks of 64 bit words, so that the two layers of each sweep fit into VISIBILITY_SWEEP_MEMORY
+	const size_t totalWords = (visibility.chunkCount + 63) / 64;
+	const size_t layerCels = size_t(size[0]) * size[2];
+	const size_t blockWords = std::min(totalWords, std::max(size_t(1), VISIBILITY_SWEEP_MEMORY / (2 * layerCels * sizeof(uint64_t))));
+	const size_t blockCount = (totalWords + blockWords - 1) / blockWords;
+
+	// seenBy[to * totalWords + w] holds word w of the set of chunks that can see chunk `to`
+	std::vector<uint64_t> seenBy(visibility.chunkCount * totalWords, 0);
+	std::mutex seenByMutex;
+	WorkerPool::ParallelFor(blockCount * 8, [&](size_t job)
+		{
+			const size_t block = job / 8;
+			const int octant = int(job % 8);
+			const int sign[3] = { (octant & 1) ? -1 : 1, (octant & 2) ? -1 : 1, (octant & 4) ? -1 : 1 };
+			const size_t firstWord = block * blockWords;
+			const size_t words = std::min(blockWords, totalWords - firstWord);
+			const size_t firstChunk = firstWord * 64, endChunk = std::min(visibility.chunkCount, (firstWord + words) * 64);
+
+			// The chunks of this block that can reach each cel of the previous and the current layer, going in the octant's directions
+			std::vector<uint64_t> previous(layerCels * words, 0), current(layerCels * words, 0);
+			std::vector<uint64_t> seen(visibility.chunkCount * words, 0);
+			auto addSeen = [&](size_t chunk, const uint64_t* from)
+				{
+					uint64_t* to = &seen[chunk * words];
+					for (size_t w = 0; w < words; ++w) to[w] |= from[w];
+				};
+
+			for (int jj = 0; jj < size[1]; ++jj)
+			{
+				const int j = (sign[1] > 0) ? jj : size[1] - 1 - jj;
+				for (int kk = 0; kk < size[2]; ++kk)
+				{
+					const int k = (sign[2] > 0) ? kk : size[2] - 1 - kk;
+					for (int ii = 0; ii < size[0]; ++ii)
+					{
+						const int i = (sign[0] > 0) ? ii : size[0] - 1 - ii;
+						uint64_t* reached = &current[(size_t(k) * size[0] + i) * words];
+						std::fill(reached, reached + words, 0);
+
+						// Lines of sight come in from the cels behind this one, along any of the octant's directions
+						for (int d = 1; d < 8; ++d)
+						{
+							const int pi = i - ((d & 1) ? sign[0] : 0), pj = j - ((d & 2) ? sign[1] : 0), pk = k - ((d & 4) ? sign[2] : 0);
+							if (pi < 0 || pi >= size[0] || pj < 0 || pj >= size[1] || pk < 0 || pk >= size[2]) continue;
+							const uint64_t* from = &((d & 2) ? previous : current)[(size_t(pk) * size[0] + pi) * words];
+							for (size_t w = 0; w < words; ++w) reached[w] |= from[w];
+						}
+
+						const size_t chunk = chunkOf(i, j, k);
+						const SightCel cel = cels[grid.FlatIndex(i, j, k)];
+						if (cel == SightCel::SOLID)
+						{
+							addSeen(chunk, reached);
+							std::fill(reached, reached + words, 0);
+							continue;
+						}
+						if (chunk >= firstChunk && chunk < endChunk) reached[(chunk - firstChunk) / 64] |= uint64_t(1) << ((chunk - firstChunk) % 64);
+						if (cel == SightCel::OPEN_TILE) addSeen(chunk, reached);
+					}
+				}
+				std::swap(previous, current);
+			}
+
+			std::lock_guard<std::mutex> lock(seenByMutex);
+			for (size_t to = 0; to < visibility.chunkCount; ++to)
+			{
+				for (size_t w = 0; w < words; ++w) seenBy[to * totalWords + firstWord + w] |= seen[to * words + w];
+			}
+		});
+
+	// Turn the sets of viewers of each chunk into the sets of chunks that each one sees
+	WorkerPool::ParallelFor(visibility.chunkCount, [&](size_t from)
+		{
+			uint8_t* row = &visibility.bits[from * visibility.rowSize];
+			for (size_t to = 0; to < visibility.chunkCount; ++to)
+			{
+				if ((seenBy[to * totalWords + from / 64] >> (from % 64)) & 1) row[to / 8] |= uint8_t(1 << (to % 8));
+			}
+		});
+
+	return visibility;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "TileGrid.h"
+
+// Most memory, in bytes, that one sweep of ComputeChunkVisibility keeps for the chunks that can reach each cel of two layers.
+// Maps with more chunks than fit are swept several times, for a block of viewing chunks at a time.
+#define VISIBILITY_SWEEP_MEMORY (16 * 1024 * 1024)
+
+// A potentially visible set for each of a grid's model chunks (see TileGrid::GetModelChunkCounts()).
+// Chunk b is in chunk a's set if a ray through open space could reach b's tiles from somewhere in a.
+struct ChunkVisibility
+{
+	std::array<int, 3> chunkCounts = { 0, 0, 0 };
+	size_t chunkCount = 0;
+	size_t rowSize = 0; // Bytes in each chunk's set
+	std::vector<uint8_t> bits; // One set after another. Bit b % 8 of byte b / 8 in a's set is on if chunk b is visible from a.
+
+	bool IsVisible(size_t from, size_t to) const { return (bits[from * rowSize + to / 8] >> (to % 8)) & 1; }
+	// Returns the set of chunk `from` as it is stored.
+	const uint8_t* GetRow(size_t from) const { return &bits[from * rowSize]; }
+};
+
+// Computes the potentially visible chunks of every chunk of `grid`, on the worker threads.
+// The sets are conservative: they can hold chunks that can't really be seen, but never leave out one that can.
+// A straight line only ever steps one way along each axis as it goes from cel to cel, so for each of the eight combinations of directions,
+// the open cels are swept in that order, passing on the chunks that could see them to the cels they lead to (including diagonally).
+// Cels are only treated as solid if their tile's shape is a cube, since any other shape could have gaps around it.
+ChunkVisibility ComputeChunkVisibility(const TileGrid& grid, int chunkSize);
\ No newline at end of file
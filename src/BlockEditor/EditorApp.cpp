@@ -76,6 +76,18 @@ EditorApp::EditorApp()
 			.mouseSensitivity = 0.5f,
 			.exportSeparateGeometry = false,
 			.cullFaces = true,
+			.greedyMeshing = false,
+			.exportIndices32 = false,
+			.weldVertices = false,
+			.exportOptimizeVertexCache = false,
+			.exportInstancing = false,
+			.exportBakeCubes = true,
+			.exportQuantize = false,
+			.exportAtlas = false,
+			.exportChunkSize = 0,
+			.exportVisibility = false,
+			.exportColliders = false,
+			.exportLodLevels = 0,
 			.defaultTexturePath = "../Data/Textures/Tiles/texel_checker.png",
 			.defaultShapePath = "../Data/Models/Shapes/cube.obj",
 	}
@@ -307,7 +319,7 @@ void EditorApp::TryOpenMap(std::filesystem::path path)
 		}
 		else if (path.extension() == ".ti")
 		{
-			if (m_mapManager->LoadTE2Map(path))
+			if (m_mapManager->LoadTE2Map(path, m_settings.texturesDir, m_settings.shapesDir))
 			{
 				m_lastSavedPath = "";
 				DisplayStatusMessage("Loaded .ti map '" + path.filename().string() + "'.", 5.0f, 100);
@@ -361,7 +373,7 @@ void EditorApp::TrySaveMap(std::filesystem::path path)
 	}
 }
 //-----------------------------------------------------------------------------
-void EditorApp::TryExportMap(std::filesystem::path path, bool separateGeometry)
+void EditorApp::TryExportMap(std::filesystem::path path)
 {
 	//Add correct extension if no extension is given.
 	if (path.extension().empty())
@@ -371,9 +383,26 @@ void EditorApp::TryExportMap(std::filesystem::path path, bool separateGeometry)
 
 	std::filesystem::directory_entry entry{ path };
 
-	if (path.extension() == ".gltf" || path.extension() == ".glb")
+	if (path.extension() == ".gltf" || path.extension() == ".glb" || path.extension() == ".temap")
 	{
-		if (m_mapManager->ExportGLTFScene(path, separateGeometry))
+		MapMan::ExportOptions options;
+		options.cullFaces = m_settings.cullFaces;
+		options.greedyMeshing = m_settings.greedyMeshing;
+		options.weldVertices = m_settings.weldVertices;
+		options.texturesDir = m_settings.texturesDir;
+		options.separateGeometry = m_settings.exportSeparateGeometry;
+		options.use32BitIndices = m_settings.exportIndices32;
+		options.optimizeVertexCache = m_settings.exportOptimizeVertexCache;
+		options.gpuInstancing = m_settings.exportInstancing;
+		options.bakeCubeTiles = m_settings.exportBakeCubes;
+		options.quantize = m_settings.exportQuantize;
+		options.atlasTextures = m_settings.exportAtlas;
+		options.chunkSize = m_settings.exportChunkSize;
+		options.chunkVisibility = m_settings.exportVisibility;
+		options.colliders = m_settings.exportColliders;
+		options.lodLevels = m_settings.exportLodLevels;
+		const bool exported = (path.extension() == ".temap") ? m_mapManager->ExportBakedMap(path, options) : m_mapManager->ExportGLTFScene(path, options);
+		if (exported)
 		{
 			DisplayStatusMessage(std::string("Exported map as ") + path.filename().string(), 5.0f, 100);
 		}
@@ -410,7 +439,11 @@ void EditorApp::LoadSettings()
 		nlohmann::json jData;
 		std::ifstream file(SETTINGS_FILE_PATH);
 		file >> jData;
-		EditorApp::from_json(jData, m_settings);
+		//Settings missing from older files keep their default values.
+		nlohmann::json jDefaults;
+		EditorApp::to_json(jDefaults, m_settings);
+		jDefaults.update(jData);
+		EditorApp::from_json(jDefaults, m_settings);
 	}
 	catch (std::exception e)
 	{
@@ -21,6 +21,18 @@ public:
 		mouseSensitivity,
 		exportSeparateGeometry,
 		cullFaces,
+		greedyMeshing,
+		exportIndices32,
+		weldVertices,
+		exportOptimizeVertexCache,
+		exportInstancing,
+		exportBakeCubes,
+		exportQuantize,
+		exportAtlas,
+		exportChunkSize,
+		exportVisibility,
+		exportColliders,
+		exportLodLevels,
 		exportFilePath,
 		defaultTexturePath,
 		defaultShapePath,
@@ -44,6 +56,8 @@ public:
 	std::string GetDefaultTexturePath() { return m_settings.defaultTexturePath; }
 	std::string GetDefaultShapePath() { return m_settings.defaultShapePath; }
 	bool IsCullingEnabled() { return m_settings.cullFaces; }
+	bool IsGreedyMeshingEnabled() { return m_settings.greedyMeshing; }
+	bool IsVertexWeldingEnabled() { return m_settings.weldVertices; }
 	Color GetBackgroundColor() { return Color(m_settings.backgroundColor[0], m_settings.backgroundColor[1], m_settings.backgroundColor[2], (uint8_t)255); }
 
 	//Indicates if rendering should be done in "preview mode", i.e. without editor widgets being drawn.
@@ -65,7 +79,7 @@ public:
 	void ShrinkMap();
 	void TryOpenMap(std::filesystem::path path);
 	void TrySaveMap(std::filesystem::path path);
-	void TryExportMap(std::filesystem::path path, bool separateGeometry);
+	void TryExportMap(std::filesystem::path path);
 
 	//Serializes settings into JSON file and exports.
 	void SaveSettings();
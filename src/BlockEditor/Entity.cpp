@@ -41,6 +41,19 @@ inline Matrix Ent::GetMatrix() const
         MatrixTranslate(position.x, position.y, position.z));
 }
 
+bool Ent::operator==(const Ent& other) const
+{
+    if (!active || !other.active) return active == other.active;
+
+    return display == other.display
+        && color.r == other.color.r && color.g == other.color.g && color.b == other.color.b && color.a == other.color.a
+        && radius == other.radius
+        && position.x == other.position.x && position.y == other.position.y && position.z == other.position.z
+        && yaw == other.yaw && pitch == other.pitch
+        && model == other.model && texture == other.texture
+        && properties == other.properties;
+}
+
 void Ent::Draw(const bool drawAxes) const
 {
     // All sprites share the same material, and the texture is changed for each one
@@ -147,32 +160,32 @@ EntGrid::EntGrid()
 }
 
 //Creates ent grid of given dimensions, default spacing.
-EntGrid::EntGrid(size_t width, size_t height, size_t length)
-    : Grid<Ent>(width, height, length, ENT_SPACING_DEFAULT, Ent())
+EntGrid::EntGrid(size_t width, size_t height, size_t length, GridStorage storage)
+    : Grid<Ent>(width, height, length, ENT_SPACING_DEFAULT, Ent(), storage)
 {
-    _labelsToDraw.reserve(m_grid.size());
 }
 
 void EntGrid::Draw(Camera3D& camera, int fromY, int toY)
 {
     _labelsToDraw.clear();
 
-    for (size_t i = fromY * m_width * m_length; i < (toY + 1) * m_width * m_length; ++i)
-    {
-        if (!m_grid[i].active) continue;
-
-        //Do frustrum culling check
-        Vector3 ndc = GetWorldToNDC(m_grid[i].position, camera);
-        if (ndc.z < 1.0f && ndc.x > -1.0f && ndc.x < 1.0f && ndc.y > -1.0f && ndc.y < 1.0f)
+    forEachCel(fromY, toY, [&](size_t, const Ent& ent)
         {
-            bool drawExtras = (ndc.z < DISPLAY_NAME_THRESHOLD);
+            if (!ent.active) return;
 
-            if (drawExtras && m_grid[i].properties.find("name") != m_grid[i].properties.end())
-                _labelsToDraw.push_back(std::make_pair(ndc, m_grid[i].properties["name"]));
+            //Do frustrum culling check
+            Vector3 ndc = GetWorldToNDC(ent.position, camera);
+            if (ndc.z < 1.0f && ndc.x > -1.0f && ndc.x < 1.0f && ndc.y > -1.0f && ndc.y < 1.0f)
+            {
+                bool drawExtras = (ndc.z < DISPLAY_NAME_THRESHOLD);
 
-            m_grid[i].Draw(drawExtras && !GetApp()->IsPreviewing());
-        }
-    }
+                auto name = ent.properties.find("name");
+                if (drawExtras && name != ent.properties.end())
+                    _labelsToDraw.push_back(std::make_pair(ndc, name->second));
+
+                ent.Draw(drawExtras && !GetApp()->IsPreviewing());
+            }
+        });
 }
 
 void EntGrid::DrawLabels(Camera3D& camera, int fromY, int toY)
@@ -33,6 +33,9 @@ struct Ent
 
     Matrix GetMatrix() const;
 
+    //Inactive entities compare equal to each other, regardless of their other fields.
+    bool operator==(const Ent& other) const;
+
     void Draw(const bool drawAxes) const;
 };
 
@@ -48,7 +51,7 @@ public:
     EntGrid();
 
     //Creates ent grid of given dimensions, default spacing.
-    EntGrid(size_t width, size_t height, size_t length);
+    EntGrid(size_t width, size_t height, size_t length, GridStorage storage = GridStorage::DENSE);
 
     //Will set the given ent to occupy the grid space, replacing any existing entity in that space.
     inline void AddEnt(int i, int j, int k, Ent ent)
@@ -64,7 +67,7 @@ public:
 
     inline bool HasEnt(int i, int j, int k) const
     {
-        return getCel(i, j, k).active;
+        return celAt(i, j, k).active;
     }
 
     inline Ent GetEnt(int i, int j, int k) const
@@ -79,12 +82,12 @@ public:
     }
 
     //Returns a smaller grid with a copy of the ent data in the rectangle defined by coordinates (i, j, k) and size (w, h, l).
-    inline EntGrid Subsection(int i, int j, int k, int w, int h, int l) const
+    inline EntGrid Subsection(int i, int j, int k, int w, int h, int l, GridStorage storage = GridStorage::DENSE) const
     {
         assert(i >= 0 && j >= 0 && k >= 0);
         assert(i + w <= int(m_width) && j + h <= int(m_height) && k + l <= int(m_length));
 
-        EntGrid newGrid(w, h, l);
+        EntGrid newGrid(w, h, l, storage);
 
         subsectionCopy(i, j, k, w, h, l, newGrid);
 
@@ -95,10 +98,10 @@ public:
     inline std::vector<Ent> GetEntList() const
     {
         std::vector<Ent> out;
-        for (const Ent& ent : m_grid)
-        {
-            if (ent.active) out.push_back(ent);
-        }
+        forEachCel(0, int(m_height) - 1, [&](size_t, const Ent& ent)
+            {
+                if (ent.active) out.push_back(ent);
+            });
         return out;
     }
 
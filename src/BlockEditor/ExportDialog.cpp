@@ -24,12 +24,12 @@ bool ExportDialog::Draw()
 
 	if (ImGui::BeginPopupModal("EXPORT .GLTF/.GLB SCENE", &open, ImGuiWindowFlags_AlwaysAutoResize))
 	{
-		ImGui::TextUnformatted(".gltf and .glb are both supported!");
+		ImGui::TextUnformatted(".gltf and .glb are both supported! .temap writes the baked runtime format (see BakedMap.h).");
 		ImGui::InputText("File path", m_filePathBuffer, TEXT_FIELD_MAX);
 		ImGui::SameLine();
 		if (ImGui::Button("Browse##gltfexport"))
 		{
-			m_dialog.reset(new FileDialog(std::string("Save .GLTF or .GLB file"), { std::string(".gltf"), std::string(".glb") }, [&](std::filesystem::path path) 
+			m_dialog.reset(new FileDialog(std::string("Save .GLTF, .GLB or .TEMAP file"), { std::string(".gltf"), std::string(".glb"), std::string(".temap") }, [&](std::filesystem::path path) 
 				{
 				m_settings.exportFilePath = std::filesystem::relative(path).string();
 				strcpy(m_filePathBuffer, m_settings.exportFilePath.c_str());
@@ -39,10 +39,36 @@ bool ExportDialog::Draw()
 
 		ImGui::Checkbox("Seperate nodes for each texture", &m_settings.exportSeparateGeometry);
 		ImGui::Checkbox("Cull redundant faces between tiles", &m_settings.cullFaces);
+		ImGui::Checkbox("Merge flat faces into larger quads", &m_settings.greedyMeshing);
+		ImGui::Checkbox("Merge duplicate vertices", &m_settings.weldVertices);
+		ImGui::Checkbox("Reorder triangles for the vertex cache", &m_settings.exportOptimizeVertexCache);
+		ImGui::Checkbox("Use 32-bit indices instead of splitting large meshes", &m_settings.exportIndices32);
+		ImGui::Checkbox("Quantize vertex attributes (KHR_mesh_quantization)", &m_settings.exportQuantize);
+		ImGui::Checkbox("Pack textures into atlases", &m_settings.exportAtlas);
+
+		bool chunked = m_settings.exportChunkSize > 0;
+		if (ImGui::Checkbox("Split the map into chunks", &chunked))
+		{
+			m_settings.exportChunkSize = chunked ? 16 : 0;
+		}
+		if (chunked)
+		{
+			ImGui::InputInt("Chunk size (cels)", &m_settings.exportChunkSize, 1, 8);
+			// Very small chunks would make a node for almost every tile
+			if (m_settings.exportChunkSize < 4) m_settings.exportChunkSize = 4;
+			ImGui::Checkbox("Compute which chunks can see each other", &m_settings.exportVisibility);
+		}
+		ImGui::Checkbox("Add colliders (boxes for cube tiles)", &m_settings.exportColliders);
+		ImGui::SliderInt("Coarser levels of detail (MSFT_lod)", &m_settings.exportLodLevels, 0, 3);
+		ImGui::Checkbox("Export tiles as instances of their shapes", &m_settings.exportInstancing);
+		if (m_settings.exportInstancing)
+		{
+			ImGui::Checkbox("Bake cube tiles so their hidden faces are culled", &m_settings.exportBakeCubes);
+		}
 
 		if (ImGui::Button("Export##exportgltf"))
 		{
-			GetApp()->TryExportMap(std::filesystem::path(m_settings.exportFilePath), m_settings.exportSeparateGeometry);
+			GetApp()->TryExportMap(std::filesystem::path(m_settings.exportFilePath));
 			GetApp()->SaveSettings();
 			ImGui::EndPopup();
 			return false;
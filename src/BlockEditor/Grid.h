@@ -2,21 +2,44 @@
 
 #include "Core.h"
 
+// Edge length, in cels, of the cubic bricks that chunked grids are divided into.
+#define GRID_CHUNK_SIZE 16
+
+// Determines how a grid keeps its cels in memory.
+enum class GridStorage
+{
+	DENSE,   // Every cel is stored in one contiguous array.
+	CHUNKED, // Cels are stored in bricks that are allocated on first write and released once all of their cels are the same again.
+};
+
 // Represents a 3 dimensional array of tiles and provides functions for converting coordinates.
+// Chunked grids compare cels with operator== to find out when a brick has become uniform and can be released.
 template<class Cel>
 class Grid
 {
 public:
 	// Constructs a grid filled with the given cel.
-	Grid(size_t width, size_t height, size_t length, float spacing, const Cel& fill)
+	Grid(size_t width, size_t height, size_t length, float spacing, const Cel& fill, GridStorage storage = GridStorage::DENSE)
 	{
 		m_width = width; m_height = height; m_length = length; m_spacing = spacing;
-		m_grid.resize(width * height * length);
+		m_fill = fill;
+		m_storage = storage;
 
-		for (size_t i = 0; i < m_grid.size(); ++i) { m_grid[i] = fill; }
+		if (m_storage == GridStorage::DENSE)
+		{
+			m_grid.assign(width * height * length, fill);
+			m_chunksX = m_chunksY = m_chunksZ = 0;
+		}
+		else
+		{
+			m_chunksX = (width + GRID_CHUNK_SIZE - 1) / GRID_CHUNK_SIZE;
+			m_chunksY = (height + GRID_CHUNK_SIZE - 1) / GRID_CHUNK_SIZE;
+			m_chunksZ = (length + GRID_CHUNK_SIZE - 1) / GRID_CHUNK_SIZE;
+			m_chunks.assign(m_chunksX * m_chunksY * m_chunksZ, Chunk{ {}, fill, 0 });
+		}
 	}
 	// Constructs a grid full of default-constructed cels.
-	Grid(size_t width, size_t height, size_t length, float spacing) : Grid(width, height, length, spacing, Cel()) {}
+	Grid(size_t width, size_t height, size_t length, float spacing, GridStorage storage = GridStorage::DENSE) : Grid(width, height, length, spacing, Cel(), storage) {}
 	virtual ~Grid() = default;
 
 	Vector3 WorldToGridPos(Vector3 worldPos) const
@@ -68,6 +91,20 @@ public:
 	size_t GetHeight() const { return m_height; }
 	size_t GetLength() const { return m_length; }
 	float GetSpacing() const { return m_spacing; }
+	GridStorage GetStorage() const { return m_storage; }
+
+	// Returns the number of bytes currently used to store the cels (not counting memory owned by the cels themselves).
+	size_t GetMemoryUsage() const
+	{
+		if (m_storage == GridStorage::DENSE) return m_grid.capacity() * sizeof(Cel);
+
+		size_t bytes = m_chunks.capacity() * sizeof(Chunk);
+		for (const Chunk& chunk : m_chunks)
+		{
+			bytes += chunk.cels.capacity() * sizeof(Cel);
+		}
+		return bytes;
+	}
 
 	Vector3 GetMinCorner() const
 	{
@@ -85,14 +122,147 @@ public:
 	}
 
 protected:
+	// A brick of GRID_CHUNK_SIZE^3 cels. `cels` is empty while every cel of the brick holds `uniform`.
+	// Otherwise, `uniform` is the value that the brick would collapse to, and `matching` counts the cels inside of the grid that hold it.
+	struct Chunk
+	{
+		std::vector<Cel> cels;
+		Cel uniform;
+		size_t matching = 0;
+	};
+
+	static constexpr size_t CHUNK_CELS = GRID_CHUNK_SIZE * GRID_CHUNK_SIZE * GRID_CHUNK_SIZE;
+
+	// Returns the number of cels of the brick containing (i, j, k) that are inside of the grid. Bricks on the far edges are cut off.
+	size_t chunkCelCount(int i, int j, int k) const
+	{
+		const int baseX = i - (i % GRID_CHUNK_SIZE), baseY = j - (j % GRID_CHUNK_SIZE), baseZ = k - (k % GRID_CHUNK_SIZE);
+		return size_t(Min(GRID_CHUNK_SIZE, int(m_width) - baseX)) * Min(GRID_CHUNK_SIZE, int(m_height) - baseY) * Min(GRID_CHUNK_SIZE, int(m_length) - baseZ);
+	}
+
+	size_t chunkIndex(int i, int j, int k) const
+	{
+		return ((j / GRID_CHUNK_SIZE) * m_chunksZ + (k / GRID_CHUNK_SIZE)) * m_chunksX + (i / GRID_CHUNK_SIZE);
+	}
+
+	static size_t chunkCelIndex(int i, int j, int k)
+	{
+		return (i % GRID_CHUNK_SIZE) + ((k % GRID_CHUNK_SIZE) * GRID_CHUNK_SIZE) + ((j % GRID_CHUNK_SIZE) * GRID_CHUNK_SIZE * GRID_CHUNK_SIZE);
+	}
+
+	const Cel& celAt(int i, int j, int k) const
+	{
+		if (m_storage == GridStorage::DENSE) return m_grid[FlatIndex(i, j, k)];
+
+		const Chunk& chunk = m_chunks[chunkIndex(i, j, k)];
+		return chunk.cels.empty() ? chunk.uniform : chunk.cels[chunkCelIndex(i, j, k)];
+	}
+
+	const Cel& celAt(size_t idx) const
+	{
+		if (m_storage == GridStorage::DENSE) return m_grid[idx];
+
+		return celAt(int(idx % m_width), int(idx / (m_width * m_length)), int((idx / m_width) % m_length));
+	}
+
 	void setCel(int i, int j, int k, const Cel& cel)
 	{
-		m_grid[FlatIndex(i, j, k)] = cel;
+		if (m_storage == GridStorage::DENSE)
+		{
+			m_grid[FlatIndex(i, j, k)] = cel;
+			return;
+		}
+
+		Chunk& chunk = m_chunks[chunkIndex(i, j, k)];
+		if (chunk.cels.empty())
+		{
+			if (cel == chunk.uniform) return;
+			chunk.cels.assign(CHUNK_CELS, chunk.uniform);
+			chunk.matching = chunkCelCount(i, j, k);
+		}
+
+		Cel& slot = chunk.cels[chunkCelIndex(i, j, k)];
+		const bool wasMatching = (slot == chunk.uniform);
+		const bool isMatching = (cel == chunk.uniform);
+		slot = cel;
+
+		if (wasMatching && !isMatching) --chunk.matching;
+		else if (!wasMatching && isMatching) ++chunk.matching;
+
+		// Once no cel holds the value the brick was counting, the brick can only become uniform with some other value,
+		// so it starts counting the value that was just written instead. This is what lets a brick that is painted over
+		// completely collapse to its new value. It costs one pass over the brick, which only happens after the old value is gone.
+		if (chunk.matching == 0) rebaseChunk(i, j, k, cel);
+
+		if (chunk.matching == chunkCelCount(i, j, k))
+		{
+			// The brick is uniform, so it doesn't need its own memory anymore.
+			std::vector<Cel>().swap(chunk.cels);
+		}
+	}
+
+	// Makes the brick containing (i, j, k) count the cels that hold `cel`.
+	void rebaseChunk(int i, int j, int k, const Cel& cel)
+	{
+		Chunk& chunk = m_chunks[chunkIndex(i, j, k)];
+		const int baseX = i - (i % GRID_CHUNK_SIZE), baseY = j - (j % GRID_CHUNK_SIZE), baseZ = k - (k % GRID_CHUNK_SIZE);
+		const int xEnd = Min(GRID_CHUNK_SIZE, int(m_width) - baseX);
+		const int yEnd = Min(GRID_CHUNK_SIZE, int(m_height) - baseY);
+		const int zEnd = Min(GRID_CHUNK_SIZE, int(m_length) - baseZ);
+		chunk.uniform = cel;
+		chunk.matching = 0;
+		for (int y = 0; y < yEnd; ++y)
+		{
+			for (int z = 0; z < zEnd; ++z)
+			{
+				for (int x = 0; x < xEnd; ++x)
+				{
+					if (chunk.cels[chunkCelIndex(x, y, z)] == cel) ++chunk.matching;
+				}
+			}
+		}
+	}
+
+	void setCel(size_t idx, const Cel& cel)
+	{
+		if (m_storage == GridStorage::DENSE)
+		{
+			m_grid[idx] = cel;
+			return;
+		}
+
+		setCel(int(idx % m_width), int(idx / (m_width * m_length)), int((idx / m_width) % m_length), cel);
 	}
 
 	Cel getCel(int i, int j, int k) const
 	{
-		return m_grid[FlatIndex(i, j, k)];
+		return celAt(i, j, k);
+	}
+
+	// Sets every cel in the rectangular prism with a corner at (i, j, k) and size (w, h, l).
+	void fillCels(int i, int j, int k, int w, int h, int l, const Cel& cel)
+	{
+		for (int y = j; y < j + h; ++y)
+		{
+			for (int z = k; z < k + l; ++z)
+			{
+				if (m_storage == GridStorage::DENSE)
+				{
+					size_t base = FlatIndex(0, y, z);
+					for (int x = i; x < i + w; ++x)
+					{
+						m_grid[base + x] = cel;
+					}
+				}
+				else
+				{
+					for (int x = i; x < i + w; ++x)
+					{
+						setCel(x, y, z, cel);
+					}
+				}
+			}
+		}
 	}
 
 	void copyCels(int i, int j, int k, const Grid<Cel>& src)
@@ -101,16 +271,27 @@ protected:
 		int xEnd = Min(i + src.m_width, m_width);
 		int yEnd = Min(j + src.m_height, m_height);
 		int zEnd = Min(k + src.m_length, m_length);
+		const bool dense = (m_storage == GridStorage::DENSE && src.m_storage == GridStorage::DENSE);
 		for (int z = k; z < zEnd; ++z)
 		{
 			for (int y = j; y < yEnd; ++y)
 			{
-				size_t ourBase = FlatIndex(0, y, z);
-				size_t theirBase = src.FlatIndex(0, y - j, z - k);
-				for (int x = i; x < xEnd; ++x)
+				if (dense)
 				{
-					const Cel& cel = src.m_grid[theirBase + (x - i)];
-					m_grid[ourBase + x] = cel;
+					size_t ourBase = FlatIndex(0, y, z);
+					size_t theirBase = src.FlatIndex(0, y - j, z - k);
+					for (int x = i; x < xEnd; ++x)
+					{
+						const Cel& cel = src.m_grid[theirBase + (x - i)];
+						m_grid[ourBase + x] = cel;
+					}
+				}
+				else
+				{
+					for (int x = i; x < xEnd; ++x)
+					{
+						setCel(x, y, z, src.celAt(x - i, y - j, z - k));
+					}
 				}
 			}
 		}
@@ -118,21 +299,93 @@ protected:
 
 	void subsectionCopy(int i, int j, int k, int w, int h, int l, Grid<Cel>& out) const
 	{
+		const bool dense = (m_storage == GridStorage::DENSE && out.m_storage == GridStorage::DENSE);
 		for (int z = k; z < k + l; ++z)
 		{
 			for (int y = j; y < j + h; ++y)
 			{
-				size_t ourBase = FlatIndex(0, y, z);
-				size_t theirBase = out.FlatIndex(0, y - j, z - k);
-				for (int x = i; x < i + w; ++x)
+				if (dense)
+				{
+					size_t ourBase = FlatIndex(0, y, z);
+					size_t theirBase = out.FlatIndex(0, y - j, z - k);
+					for (int x = i; x < i + w; ++x)
+					{
+						out.m_grid[theirBase + (x - i)] = m_grid[ourBase + x];
+					}
+				}
+				else
 				{
-					out.m_grid[theirBase + (x - i)] = m_grid[ourBase + x];
+					for (int x = i; x < i + w; ++x)
+					{
+						out.setCel(x - i, y - j, z - k, celAt(x, y, z));
+					}
+				}
+			}
+		}
+	}
+
+	// Replaces every cel, including the fill values of unallocated bricks, with `transform(cel)`.
+	// `transform` has to map the grid's fill cel to itself, and no two of the grid's cels to the same value, so that no brick changes whether it is uniform.
+	template<class Transform>
+	void transformCels(Transform transform)
+	{
+		for (Cel& cel : m_grid) cel = transform(cel);
+		for (Chunk& chunk : m_chunks)
+		{
+			chunk.uniform = transform(chunk.uniform);
+			for (Cel& cel : chunk.cels) cel = transform(cel);
+		}
+	}
+
+	// Calls `visit(flatIndex, cel)` in flat index order for every cel in the layers [fromY, toY] that differs from the fill cel.
+	// Chunked grids skip over unallocated bricks of the fill cel without looking at their cels.
+	template<class Visitor>
+	void forEachCel(int fromY, int toY, Visitor visit) const
+	{
+		if (m_storage == GridStorage::DENSE)
+		{
+			const size_t layerArea = m_width * m_length;
+			for (size_t t = fromY * layerArea; t < (toY + 1) * layerArea; ++t)
+			{
+				if (!(m_grid[t] == m_fill)) visit(t, m_grid[t]);
+			}
+			return;
+		}
+
+		for (int y = fromY; y <= toY; ++y)
+		{
+			for (int z = 0; z < int(m_length); ++z)
+			{
+				for (int x = 0; x < int(m_width); x += GRID_CHUNK_SIZE)
+				{
+					const Chunk& chunk = m_chunks[chunkIndex(x, y, z)];
+					const int xEnd = Min(x + GRID_CHUNK_SIZE, int(m_width));
+					if (chunk.cels.empty())
+					{
+						if (chunk.uniform == m_fill) continue;
+						for (int cx = x; cx < xEnd; ++cx)
+						{
+							visit(FlatIndex(cx, y, z), chunk.uniform);
+						}
+						continue;
+					}
+
+					const size_t rowBase = chunkCelIndex(0, y, z);
+					for (int cx = x; cx < xEnd; ++cx)
+					{
+						const Cel& cel = chunk.cels[rowBase + (cx - x)];
+						if (!(cel == m_fill)) visit(FlatIndex(cx, y, z), cel);
+					}
 				}
 			}
 		}
 	}
 
-	std::vector<Cel> m_grid;
+	std::vector<Cel> m_grid; // Cel array for dense grids
+	std::vector<Chunk> m_chunks; // Bricks for chunked grids, ordered by Y, then Z, then X
+	size_t m_chunksX, m_chunksY, m_chunksZ;
+	Cel m_fill;
+	GridStorage m_storage;
 	size_t m_width, m_height, m_length;
 	float m_spacing;
 };
\ No newline at end of file
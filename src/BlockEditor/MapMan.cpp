@@ -87,11 +87,9 @@ bool MapMan::SaveTE3Map(std::filesystem::path filePath)
 		jData["tiles"]["shapes"] = usedModelPaths;
 
 		// Make a copy of the map that reassigns all IDs to match the new lists
-		const int tileArea = _tileGrid.GetWidth() * _tileGrid.GetHeight() * _tileGrid.GetLength();
-		TileGrid optimizedGrid = _tileGrid.Subsection(0, 0, 0, _tileGrid.GetWidth(), _tileGrid.GetHeight(), _tileGrid.GetLength());
-		for (size_t i = 0; i < tileArea; ++i)
+		TileGrid optimizedGrid = _tileGrid.Subsection(0, 0, 0, _tileGrid.GetWidth(), _tileGrid.GetHeight(), _tileGrid.GetLength(), _tileGrid.GetStorage());
+		optimizedGrid.RemapTiles([&](Tile& tile)
 		{
-			Tile tile = optimizedGrid.GetTile(i);
 			for (int t = 0; t < usedTexIDs.size(); ++t)
 			{
 				if (usedTexIDs[t] == tile.texture)
@@ -108,8 +106,7 @@ bool MapMan::SaveTE3Map(std::filesystem::path filePath)
 					break;
 				}
 			}
-			optimizedGrid.SetTile(i, tile);
-		}
+		});
 
 		// Save the modified tile data
 		jData["tiles"]["data"] = optimizedGrid.GetOptimizedTileDataBase64();
@@ -172,7 +169,7 @@ bool MapMan::LoadTE3Map(std::filesystem::path filePath)
 			_modelList.push_back(Assets::GetModel(std::filesystem::path(path)));
 		}
 
-		_tileGrid = TileGrid(this, tData.at("width"), tData.at("height"), tData.at("length"), TILE_SPACING_DEFAULT, Tile());
+		_tileGrid = TileGrid(this, tData.at("width"), tData.at("height"), tData.at("length"), TILE_SPACING_DEFAULT, Tile(), GridStorage::CHUNKED);
 		_tileGrid.SetTileDataBase64(tData.at("data"));
 
 		_entGrid = EntGrid(_tileGrid.GetWidth(), _tileGrid.GetHeight(), _tileGrid.GetLength());
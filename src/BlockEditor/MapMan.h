@@ -5,6 +5,7 @@
 
 class MapMan
 {
+	friend struct MapManInspector; // Lets blockeditor-tests build maps without going through the undo history
 public:
 	class Action
 	{
@@ -44,7 +45,7 @@ public:
 
 	void NewMap(int width, int height, int length)
 	{
-		_tileGrid = TileGrid(this, width, height, length);
+		_tileGrid = TileGrid(this, width, height, length, GridStorage::CHUNKED);
 		_entGrid = EntGrid(width, height, length);
 		_undoHistory.clear();
 		_redoHistory.clear();
@@ -83,7 +84,7 @@ public:
 		_redoHistory.clear();
 		TileGrid oldTiles = _tileGrid;
 		EntGrid oldEnts = _entGrid;
-		_tileGrid = TileGrid(this, newWidth, newHeight, newLength);
+		_tileGrid = TileGrid(this, newWidth, newHeight, newLength, GridStorage::CHUNKED);
 		_entGrid = EntGrid(newWidth, newHeight, newLength);
 		_tileGrid.CopyTiles(ofsx, ofsy, ofsz, oldTiles, false);
 		_entGrid.CopyEnts(ofsx, ofsy, ofsz, oldEnts);
@@ -102,7 +103,7 @@ public:
 			{
 				for (size_t z = 0; z < _tileGrid.GetLength(); ++z)
 				{
-					if (_tileGrid.GetTile(x, y, z) || _entGrid.HasEnt(x, y, z))
+					if (_tileGrid.HasTile(x, y, z) || _entGrid.HasEnt(x, y, z))
 					{
 						if (x < minX) minX = x;
 						if (y < minY) minY = y;
@@ -117,12 +118,12 @@ public:
 		if (minX > maxX || minY > maxY || minZ > maxZ)
 		{
 			//If there aren't any tiles, just make it 1x1x1.
-			_tileGrid = TileGrid(this, 1, 1, 1);
+			_tileGrid = TileGrid(this, 1, 1, 1, GridStorage::CHUNKED);
 			_entGrid = EntGrid(1, 1, 1);
 		}
 		else
 		{
-			_tileGrid = _tileGrid.Subsection(minX, minY, minZ, maxX - minX + 1, maxY - minY + 1, maxZ - minZ + 1);
+			_tileGrid = _tileGrid.Subsection(minX, minY, minZ, maxX - minX + 1, maxY - minY + 1, maxZ - minZ + 1, GridStorage::CHUNKED);
 			_entGrid = _entGrid.Subsection(minX, minY, minZ, maxX - minX + 1, maxY - minY + 1, maxZ - minZ + 1);
 		}
 	}
@@ -133,13 +134,56 @@ public:
 	// Loads a .te3 map from the given path. Returns false if there was an error.
 	bool LoadTE3Map(std::filesystem::path filePath);
 
-	// Loads and converts a Total Invasion II .ti map from the given path. Returns false on error.
-	bool LoadTE2Map(std::filesystem::path filePath);
+	// Loads and converts a Total Invasion II .ti map from the given path, taking its textures and shapes from the given directories. Returns false on error.
+	bool LoadTE2Map(std::filesystem::path filePath, std::filesystem::path texturesDir, std::filesystem::path shapesDir);
+
+	// Options for ExportGLTFScene
+	struct ExportOptions
+	{
+		// Meshing options for the generated geometry, as in TileGrid::GenerateModel().
+		bool cullFaces = true;
+		bool greedyMeshing = false;
+		bool weldVertices = false;
+		// Directory that texture paths are made relative to when naming the nodes of separate geometry.
+		std::filesystem::path texturesDir;
+		// If true, then the geometry will be put into separate GLTF nodes according to their tile texture.
+		bool separateGeometry = false;
+		// If true, then the indices are written as 32-bit integers and each texture's geometry is one primitive.
+		// Otherwise, they are 16-bit and each texture's geometry is split into primitives of up to MODEL_MESH_MAX_VERTICES vertices.
+		bool use32BitIndices = false;
+		// If true, then the triangles and vertices of each mesh are reordered to make better use of the GPU's vertex cache.
+		bool optimizeVertexCache = false;
+		// If true, then each combination of shape and texture is written once, and its tiles are placed with the EXT_mesh_gpu_instancing extension.
+		bool gpuInstancing = false;
+		// If true while instancing, then cube shaped tiles are still baked into the map's geometry so that their hidden faces can be culled.
+		bool bakeCubeTiles = true;
+		// If true, then vertex attributes are quantized with KHR_mesh_quantization: 16-bit positions for baked geometry, 8-bit normals,
+		// and 16-bit texture coordinates for primitives whose coordinates all lie between 0 and 1.
+		bool quantize = false;
+		// If true, then the tile textures are packed into atlases, which are saved as PNGs next to the file.
+		// Their geometry is then drawn with one material per atlas. Faces that repeat a texture, like merged quads, are cut where it repeats.
+		// Only textures that the shapes of instanced tiles repeat keep their own materials.
+		bool atlasTextures = false;
+		// If positive, then the map is split into cubes of this many cels along each side, and each cube gets its own node.
+		// The geometry of a chunk is always in its own node, so separateGeometry doesn't apply.
+		int chunkSize = 0;
+		// If true while chunked, then the chunks that each chunk might see are computed and written to the map node's extras as "pvs".
+		// Its "sets" hold a base64 bitset for every chunk, numbered like TileGrid's model chunks. Bit n % 8 of byte n / 8 is set if chunk n might be visible.
+		bool chunkVisibility = false;
+		// If true, then a "collision" node is added with box colliders merged from the cube tiles, and a triangle mesh collider for the tiles with other shapes.
+		// Each box is a node without a mesh, whose translation and scale turn a unit cube centered on it into the box.
+		bool colliders = false;
+		// Number of coarser levels of detail, each downsampled twice as much as the one before it, that are linked to the map's nodes with MSFT_lod.
+		// When chunked, only levels whose downsampling factor divides the chunk size are made.
+		int lodLevels = 0;
+	};
 
 	// Exports the map as a .gltf file, returning false on error.
-	// If separateGeometry is true, then the geometry will be put into separate
-	// GLTF nodes according to their tile texture.
-	bool ExportGLTFScene(std::filesystem::path filePath, bool separateGeometry);
+	bool ExportGLTFScene(std::filesystem::path filePath, const ExportOptions& options);
+
+	// Exports the map's geometry and entities in the baked format described in BakedMap.h, returning false on error.
+	// Only the meshing, chunkSize and optimizeVertexCache options apply.
+	bool ExportBakedMap(std::filesystem::path filePath, const ExportOptions& options);
 
 	// Executes a undoable tile action for filling an area with one tile
 	void ExecuteTileAction(size_t i, size_t j, size_t k, size_t w, size_t h, size_t l, Tile newTile);
@@ -200,6 +244,13 @@ public:
 		return _modelList[id]->GetModel();
 	}
 
+	// Returns the handle of the model, which also holds its geometry in every tile orientation. Returns null for invalid IDs.
+	const Assets::ModelHandle* ModelHandleFromID(const ModelID id) const
+	{
+		if (id == NO_MODEL || id >= _modelList.size()) return nullptr;
+		return _modelList[id].get();
+	}
+
 	RLTexture TexFromID(const TexID id) const
 	{
 		if (id == NO_TEX || id >= _textureList.size()) return RLTexture{};
@@ -0,0 +1,368 @@
+#include "stdafx.h"
+#include "MeshTools.h"
+#include "Core.h"
+#include "RLMath.h"
+
+// The rounded attributes of one vertex: position, texture coordinates and normal.
+typedef std::array<int32_t, 8> WeldKey;
+
+struct WeldKeyHash
+{
+	size_t operator()(const WeldKey& key) const
+	{
+		size_t hash = 14695981039346656037ULL;
+		for (int32_t c : key)
+		{
+			hash = (hash ^ std::hash<int32_t>()(c)) * 1099511628211ULL;
+		}
+		return hash;
+	}
+};
+
+int WeldMeshVertices(RLMesh& mesh)
+{
+	if (mesh.indices == NULL || mesh.vertices == NULL || mesh.vertexCount == 0) return 0;
+	if (mesh.texcoords2 != NULL || mesh.tangents != NULL || mesh.colors != NULL || mesh.boneIds != NULL) return 0;
+
+	auto quantize = [](float value) { return int32_t(lroundf(value * MESH_WELD_PRECISION)); };
+
+	// Vertices keep the order in which their first copy appears, so that the result doesn't depend on the hash table.
+	std::unordered_map<WeldKey, int, WeldKeyHash> lookup;
+	lookup.reserve(mesh.vertexCount);
+	std::vector<int> remap(mesh.vertexCount);
+	int newCount = 0;
+	for (int v = 0; v < mesh.vertexCount; ++v)
+	{
+		WeldKey key = {};
+		for (int c = 0; c < 3; ++c) key[c] = quantize(mesh.vertices[v * 3 + c]);
+		if (mesh.texcoords != NULL)
+		{
+			for (int c = 0; c < 2; ++c) key[3 + c] = quantize(mesh.texcoords[v * 2 + c]);
+		}
+		if (mesh.normals != NULL)
+		{
+			for (int c = 0; c < 3; ++c) key[5 + c] = quantize(mesh.normals[v * 3 + c]);
+		}
+
+		auto [iter, added] = lookup.emplace(key, newCount);
+		remap[v] = iter->second;
+		if (!added) continue;
+
+		// Move the vertex down to its new index. It never overtakes a vertex that hasn't been read yet.
+		memmove(&mesh.vertices[newCount * 3], &mesh.vertices[v * 3], sizeof(float) * 3);
+		if (mesh.texcoords != NULL) memmove(&mesh.texcoords[newCount * 2], &mesh.texcoords[v * 2], sizeof(float) * 2);
+		if (mesh.normals != NULL) memmove(&mesh.normals[newCount * 3], &mesh.normals[v * 3], sizeof(float) * 3);
+		++newCount;
+	}
+
+	for (int i = 0; i < mesh.triangleCount * 3; ++i)
+	{
+		mesh.indices[i] = (unsigned short)remap[mesh.indices[i]];
+	}
+
+	const int removed = mesh.vertexCount - newCount;
+	mesh.vertexCount = newCount;
+	return removed;
+}
+
+MeshCacheStats AnalyzeMeshVertexCache(const RLMesh& mesh, int cacheSize)
+{
+	MeshCacheStats stats;
+	stats.vertices = mesh.vertexCount;
+	if (mesh.indices == NULL) return stats;
+	stats.triangles = mesh.triangleCount;
+
+	// The time each vertex entered the cache. A vertex is still cached if fewer than `cacheSize` vertices have entered since.
+	std::vector<size_t> entryTimes(mesh.vertexCount, 0);
+	size_t time = 0;
+	for (int i = 0; i < mesh.triangleCount * 3; ++i)
+	{
+		const unsigned short v = mesh.indices[i];
+		if (entryTimes[v] == 0 || time - entryTimes[v] >= size_t(cacheSize))
+		{
+			++time;
+			entryTimes[v] = time;
+			++stats.transforms;
+		}
+	}
+	return stats;
+}
+
+// Scores a vertex by how much it is worth drawing one of its triangles next: vertices that are in the cache or have few triangles left score higher.
+static float VertexCacheScore(int cachePosition, int remainingTriangles)
+{
+	if (remainingTriangles == 0) return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The vertices of the last triangle get a fixed lower score, so that the optimizer doesn't just make strips.
+		if (cachePosition < 3) score = 0.75f;
+		else score = powf(1.0f - float(cachePosition - 3) / float(MESH_VERTEX_CACHE_SIZE - 3), 1.5f);
+	}
+	// Prefer vertices with few triangles left, so that they can leave the cache for good sooner.
+	score += 2.0f / sqrtf(float(remainingTriangles));
+	return score;
+}
+
+void OptimizeMeshVertexCache(RLMesh& mesh)
+{
+	if (mesh.indices == NULL || mesh.triangleCount == 0) return;
+	const int triCount = mesh.triangleCount;
+
+	// List the triangles that use each vertex
+	std::vector<int> useStarts(mesh.vertexCount + 1, 0);
+	for (int i = 0; i < triCount * 3; ++i) ++useStarts[mesh.indices[i] + 1];
+	for (int v = 0; v < mesh.vertexCount; ++v) useStarts[v + 1] += useStarts[v];
+	std::vector<int> uses(triCount * 3);
+	std::vector<int> useCursors(useStarts.begin(), useStarts.end() - 1);
+	for (int i = 0; i < triCount * 3; ++i) uses[useCursors[mesh.indices[i]]++] = i / 3;
+
+	std::vector<int> remaining(mesh.vertexCount);
+	std::vector<int> cachePositions(mesh.vertexCount, -1);
+	std::vector<float> vertexScores(mesh.vertexCount);
+	for (int v = 0; v < mesh.vertexCount; ++v)
+	{
+		remaining[v] = useStarts[v + 1] - useStarts[v];
+		vertexScores[v] = VertexCacheScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triScores(triCount);
+	std::vector<bool> added(triCount, false);
+	int bestTri = 0;
+	for (int t = 0; t < triCount; ++t)
+	{
+		triScores[t] = vertexScores[mesh.indices[t * 3]] + vertexScores[mesh.indices[t * 3 + 1]] + vertexScores[mesh.indices[t * 3 + 2]];
+		if (triScores[t] > triScores[bestTri]) bestTri = t;
+	}
+
+	std::vector<unsigned short> newIndices;
+	newIndices.reserve(triCount * 3);
+	std::vector<int> cache, newCache;
+	cache.reserve(MESH_VERTEX_CACHE_SIZE + 3);
+	newCache.reserve(MESH_VERTEX_CACHE_SIZE + 3);
+	int scanCursor = 0; // Used to find a triangle to continue with when none of the cached vertices have any left
+	for (int n = 0; n < triCount; ++n)
+	{
+		if (bestTri < 0)
+		{
+			while (added[scanCursor]) ++scanCursor;
+			bestTri = scanCursor;
+		}
+
+		added[bestTri] = true;
+		const unsigned short* tri = &mesh.indices[bestTri * 3];
+		newIndices.insert(newIndices.end(), tri, tri + 3);
+
+		// Move the triangle's vertices to the front of the cache
+		newCache.assign(tri, tri + 3);
+		for (int v : cache)
+		{
+			if (v != tri[0] && v != tri[1] && v != tri[2]) newCache.push_back(v);
+		}
+		for (int c = 0; c < 3; ++c) --remaining[tri[c]];
+
+		// Vertices that fell out of the cache lose their bonus
+		for (size_t c = MESH_VERTEX_CACHE_SIZE; c < newCache.size(); ++c)
+		{
+			cachePositions[newCache[c]] = -1;
+			vertexScores[newCache[c]] = VertexCacheScore(-1, remaining[newCache[c]]);
+		}
+		for (size_t c = 0; c < newCache.size(); ++c)
+		{
+			if (c < MESH_VERTEX_CACHE_SIZE) cachePositions[newCache[c]] = int(c);
+			vertexScores[newCache[c]] = VertexCacheScore(cachePositions[newCache[c]], remaining[newCache[c]]);
+		}
+
+		// Rescore the triangles of every vertex that changed, and pick the best one to draw next
+		bestTri = -1;
+		float bestScore = -1.0f;
+		for (int v : newCache)
+		{
+			for (int u = useStarts[v]; u < useStarts[v + 1]; ++u)
+			{
+				const int t = uses[u];
+				if (added[t]) continue;
+				triScores[t] = vertexScores[mesh.indices[t * 3]] + vertexScores[mesh.indices[t * 3 + 1]] + vertexScores[mesh.indices[t * 3 + 2]];
+				if (triScores[t] > bestScore)
+				{
+					bestScore = triScores[t];
+					bestTri = t;
+				}
+			}
+		}
+
+		if (newCache.size() > MESH_VERTEX_CACHE_SIZE) newCache.resize(MESH_VERTEX_CACHE_SIZE);
+		std::swap(cache, newCache);
+	}
+
+	memcpy(mesh.indices, newIndices.data(), newIndices.size() * sizeof(unsigned short));
+}
+
+// Moves each element of `count` components of an attribute array to `remap[element]`.
+template<class T>
+static void RemapVertexAttribute(T* data, const std::vector<int>& remap, int count)
+{
+	if (data == NULL) return;
+	std::vector<T> old(data, data + remap.size() * count);
+	for (size_t v = 0; v < remap.size(); ++v)
+	{
+		memcpy(&data[remap[v] * count], &old[v * count], sizeof(T) * count);
+	}
+}
+
+void OptimizeMeshVertexFetch(RLMesh& mesh)
+{
+	if (mesh.indices == NULL || mesh.vertexCount == 0) return;
+
+	// Vertices that aren't used by any triangle go to the end
+	std::vector<int> remap(mesh.vertexCount, -1);
+	int next = 0;
+	for (int i = 0; i < mesh.triangleCount * 3; ++i)
+	{
+		if (remap[mesh.indices[i]] < 0) remap[mesh.indices[i]] = next++;
+	}
+	for (int v = 0; v < mesh.vertexCount; ++v)
+	{
+		if (remap[v] < 0) remap[v] = next++;
+	}
+
+	for (int i = 0; i < mesh.triangleCount * 3; ++i)
+	{
+		mesh.indices[i] = (unsigned short)remap[mesh.indices[i]];
+	}
+	RemapVertexAttribute(mesh.vertices, remap, 3);
+	RemapVertexAttribute(mesh.texcoords, remap, 2);
+	RemapVertexAttribute(mesh.texcoords2, remap, 2);
+	RemapVertexAttribute(mesh.normals, remap, 3);
+	RemapVertexAttribute(mesh.tangents, remap, 4);
+	RemapVertexAttribute(mesh.colors, remap, 4);
+}
+
+// One corner of a triangle that is being cut up by WrapMeshTexCoords.
+struct WrapVertex
+{
+	float position[3];
+	float texcoord[2];
+	float normal[3];
+};
+
+// Keeps the part of a convex polygon whose texture coordinate along `axis` is on the `side` (1 or -1) of `bound`.
+static std::vector<WrapVertex> ClipTexCoords(const std::vector<WrapVertex>& polygon, int axis, float bound, float side)
+{
+	std::vector<WrapVertex> result;
+	for (size_t i = 0; i < polygon.size(); ++i)
+	{
+		const WrapVertex& a = polygon[i];
+		const WrapVertex& b = polygon[(i + 1) % polygon.size()];
+		const float da = side * (a.texcoord[axis] - bound), db = side * (b.texcoord[axis] - bound);
+		if (da >= 0.0f) result.push_back(a);
+		if ((da > 0.0f && db < 0.0f) || (da < 0.0f && db > 0.0f))
+		{
+			const float t = da / (da - db);
+			WrapVertex crossing;
+			for (int c = 0; c < 3; ++c) crossing.position[c] = a.position[c] + (b.position[c] - a.position[c]) * t;
+			for (int c = 0; c < 2; ++c) crossing.texcoord[c] = a.texcoord[c] + (b.texcoord[c] - a.texcoord[c]) * t;
+			for (int c = 0; c < 3; ++c) crossing.normal[c] = a.normal[c] + (b.normal[c] - a.normal[c]) * t;
+			crossing.texcoord[axis] = bound;
+			result.push_back(crossing);
+		}
+	}
+	return result;
+}
+
+std::vector<RLMesh> WrapMeshTexCoords(const RLMesh& mesh, int maxVertices)
+{
+	std::vector<RLMesh> meshes;
+	std::vector<float> positions, texcoords, normals;
+	std::vector<unsigned short> indices;
+	auto finishMesh = [&]()
+		{
+			if (indices.empty()) return;
+			RLMesh result = {};
+			result.vertexCount = int(positions.size() / 3);
+			result.triangleCount = int(indices.size() / 3);
+			result.vertices = SAFE_MALLOC(float, positions.size());
+			memcpy(result.vertices, positions.data(), positions.size() * sizeof(float));
+			result.texcoords = SAFE_MALLOC(float, texcoords.size());
+			memcpy(result.texcoords, texcoords.data(), texcoords.size() * sizeof(float));
+			if (mesh.normals != NULL)
+			{
+				result.normals = SAFE_MALLOC(float, normals.size());
+				memcpy(result.normals, normals.data(), normals.size() * sizeof(float));
+			}
+			result.indices = SAFE_MALLOC(unsigned short, indices.size());
+			memcpy(result.indices, indices.data(), indices.size() * sizeof(unsigned short));
+			meshes.push_back(result);
+			positions.clear();
+			texcoords.clear();
+			normals.clear();
+			indices.clear();
+		};
+
+	// Coordinates this close to a whole number count as on it, so that pieces too thin to see aren't made
+	const float tolerance = 1.0f / MESH_WELD_PRECISION;
+	for (int tri = 0; tri < mesh.triangleCount; ++tri)
+	{
+		std::vector<WrapVertex> corners(3);
+		for (int c = 0; c < 3; ++c)
+		{
+			const int v = (mesh.indices != NULL) ? mesh.indices[tri * 3 + c] : tri * 3 + c;
+			WrapVertex& corner = corners[c];
+			memcpy(corner.position, &mesh.vertices[v * 3], sizeof(corner.position));
+			for (int k = 0; k < 2; ++k) corner.texcoord[k] = (mesh.texcoords != NULL) ? mesh.texcoords[v * 2 + k] : 0.0f;
+			for (int k = 0; k < 3; ++k) corner.normal[k] = (mesh.normals != NULL) ? mesh.normals[v * 3 + k] : 0.0f;
+		}
+
+		// Cut the triangle into a piece for each whole square of texture coordinates that it covers
+		int first[2], last[2];
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			const float low = Minf(Minf(corners[0].texcoord[axis], corners[1].texcoord[axis]), corners[2].texcoord[axis]);
+			const float high = Maxf(Maxf(corners[0].texcoord[axis], corners[1].texcoord[axis]), corners[2].texcoord[axis]);
+			first[axis] = (int)floorf(low + tolerance);
+			last[axis] = Max(first[axis], (int)ceilf(high - tolerance) - 1);
+		}
+		for (int cv = first[1]; cv <= last[1]; ++cv)
+		{
+			for (int cu = first[0]; cu <= last[0]; ++cu)
+			{
+				std::vector<WrapVertex> piece = corners;
+				if (cu > first[0]) piece = ClipTexCoords(piece, 0, float(cu), 1.0f);
+				if (cu < last[0]) piece = ClipTexCoords(piece, 0, float(cu + 1), -1.0f);
+				if (cv > first[1]) piece = ClipTexCoords(piece, 1, float(cv), 1.0f);
+				if (cv < last[1]) piece = ClipTexCoords(piece, 1, float(cv + 1), -1.0f);
+				if (piece.size() < 3) continue;
+
+				float area = 0.0f;
+				for (size_t i = 0; i < piece.size(); ++i)
+				{
+					const WrapVertex& a = piece[i];
+					const WrapVertex& b = piece[(i + 1) % piece.size()];
+					area += a.texcoord[0] * b.texcoord[1] - b.texcoord[0] * a.texcoord[1];
+				}
+				if (fabsf(area) < tolerance * tolerance) continue;
+
+				if (int(positions.size() / 3 + piece.size()) > maxVertices) finishMesh();
+				const size_t base = positions.size() / 3;
+				for (const WrapVertex& vertex : piece)
+				{
+					positions.insert(positions.end(), vertex.position, vertex.position + 3);
+					texcoords.push_back(Clamp(vertex.texcoord[0] - float(cu), 0.0f, 1.0f));
+					texcoords.push_back(Clamp(vertex.texcoord[1] - float(cv), 0.0f, 1.0f));
+					const float length = sqrtf(vertex.normal[0] * vertex.normal[0] + vertex.normal[1] * vertex.normal[1] + vertex.normal[2] * vertex.normal[2]);
+					for (int c = 0; c < 3; ++c) normals.push_back(length > 0.0f ? vertex.normal[c] / length : 0.0f);
+				}
+				// The pieces are convex and keep the triangle's winding, so they can be split into a fan
+				for (size_t k = 1; k + 1 < piece.size(); ++k)
+				{
+					indices.push_back((unsigned short)base);
+					indices.push_back((unsigned short)(base + k));
+					indices.push_back((unsigned short)(base + k + 1));
+				}
+			}
+		}
+	}
+	finishMesh();
+	return meshes;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "RL.h"
+
+// Vertex attributes are compared in units of 1 / MESH_WELD_PRECISION when welding.
+#define MESH_WELD_PRECISION 4096.0f
+
+// Merges the vertices of an indexed mesh that have the same position, texture coordinates and normal (after rounding), and updates the indices to match.
+// The vertex arrays are compacted in place, but GPU buffers are not touched, so this should be called before uploading the mesh.
+// Meshes without indices or with attributes besides those three are left alone. Returns the number of vertices that were removed.
+int WeldMeshVertices(RLMesh& mesh);
+
+// Number of entries in the post-transform vertex cache that meshes are optimized for and measured with.
+#define MESH_VERTEX_CACHE_SIZE 32
+
+// Results of running a mesh's indices through a simulated FIFO post-transform vertex cache.
+struct MeshCacheStats
+{
+	size_t transforms = 0; // Vertices that missed the cache and had to be transformed
+	size_t triangles = 0;
+	size_t vertices = 0;
+
+	// Average cache miss ratio: transforms per triangle. 0.5 is the best possible for large grids, 3 is the worst.
+	float ACMR() const { return triangles > 0 ? float(transforms) / float(triangles) : 0.0f; }
+	// Average transform to vertex ratio: transforms per vertex. 1 is the best possible.
+	float ATVR() const { return vertices > 0 ? float(transforms) / float(vertices) : 0.0f; }
+
+	MeshCacheStats& operator+=(const MeshCacheStats& other)
+	{
+		transforms += other.transforms; triangles += other.triangles; vertices += other.vertices;
+		return *this;
+	}
+};
+
+// Measures how well the mesh's triangle order uses a FIFO vertex cache with `cacheSize` entries.
+MeshCacheStats AnalyzeMeshVertexCache(const RLMesh& mesh, int cacheSize = MESH_VERTEX_CACHE_SIZE);
+
+// Reorders the triangles of an indexed mesh so that they reuse recently transformed vertices, using Tom Forsyth's linear-speed vertex cache optimization.
+void OptimizeMeshVertexCache(RLMesh& mesh);
+
+// Reorders the vertices of an indexed mesh into the order that its indices first use them, which makes vertex fetches more sequential.
+// Call this after OptimizeMeshVertexCache. Like WeldMeshVertices, it only changes the CPU-side arrays.
+void OptimizeMeshVertexFetch(RLMesh& mesh);
+
+// Splits the triangles of an indexed mesh wherever their texture coordinates cross a whole number, and moves the coordinates of each piece
+// by whole numbers to lie between 0 and 1. The pieces look the same with a repeating texture, but can also be drawn from part of an atlas.
+// Returns the new meshes, each with at most `maxVertices` vertices. Only positions, texture coordinates and normals are kept.
+std::vector<RLMesh> WrapMeshTexCoords(const RLMesh& mesh, int maxVertices);
\ No newline at end of file
@@ -445,6 +445,7 @@ enum rlTextureFilter {
 
 // GL equivalent data types
 #define RL_UNSIGNED_BYTE                        0x1401      // GL_UNSIGNED_BYTE
+#define RL_UNSIGNED_SHORT                       0x1403      // GL_UNSIGNED_SHORT
 #define RL_FLOAT                                0x1406      // GL_FLOAT
 
 // Shader attribute data types
@@ -490,7 +491,8 @@ enum ShaderLocationIndex {
 	SHADER_LOC_MAP_CUBEMAP,         // Shader location: samplerCube texture: cubemap
 	SHADER_LOC_MAP_IRRADIANCE,      // Shader location: samplerCube texture: irradiance
 	SHADER_LOC_MAP_PREFILTER,       // Shader location: samplerCube texture: prefilter
-	SHADER_LOC_MAP_BRDF             // Shader location: sampler2d texture: brdf
+	SHADER_LOC_MAP_BRDF,            // Shader location: sampler2d texture: brdf
+	SHADER_LOC_CEL_SPACING          // Shader location: float uniform: grid spacing of packed instances
 };
 
 #define SHADER_LOC_MAP_DIFFUSE      SHADER_LOC_MAP_ALBEDO
@@ -602,12 +604,25 @@ void rlGetGlTextureFormats(int format, unsigned int* glInternalFormat, unsigned
 const char* rlGetPixelFormatName(unsigned int format);              // Get name string for pixel format
 RLMaterial LoadMaterialDefault();
 
+// The functions that create, fill and draw from GPU buffers. They default to OpenGL, and can be replaced
+// with rlSetBufferBackend() to see what is sent to the GPU without a graphics context.
+struct rlBufferBackend {
+	unsigned int (*loadVertexBuffer)(const void* buffer, int size, bool dynamic);
+	unsigned int (*loadVertexBufferElement)(const void* buffer, int size, bool dynamic);
+	void (*updateVertexBuffer)(unsigned int bufferId, const void* data, int dataSize, int offset);
+	void (*unloadVertexBuffer)(unsigned int vboId);
+	void (*drawMeshInstancedPackedBuffer)(RLMesh mesh, RLMaterial material, Matrix transform, float spacing, unsigned int instanceBufferId, int firstInstance, int instances);
+};
+
+rlBufferBackend rlSetBufferBackend(rlBufferBackend backend); // Set the buffer functions, returns the ones used until now
+
 
 void UploadMesh(RLMesh* mesh, bool dynamic);
 
 unsigned int rlLoadVertexArray();             // Load vertex array (vao) if supported
 bool rlEnableVertexArray(unsigned int vaoId);     // Enable vertex array (VAO, if supported)
 unsigned int rlLoadVertexBuffer(const void* buffer, int size, bool dynamic); // Load a vertex buffer object
+void rlUpdateVertexBuffer(unsigned int bufferId, const void* data, int dataSize, int offset); // Update vertex buffer object data on GPU buffer
 void rlSetVertexAttribute(unsigned int index, int compSize, int type, bool normalized, int stride, const void* pointer); // Set vertex attribute data configuration
 void rlEnableVertexAttribute(unsigned int index); // Enable vertex attribute index
 void rlSetVertexAttributeDefault(int locIndex, const void* value, int attribType, int count); // Set vertex attribute default value, when attribute to provided
@@ -641,11 +656,15 @@ RLAPI RLImage LoadImage(const char* fileName);
 
 RLAPI unsigned char* LoadFileData(const char* fileName, int* dataSize); // Load file data as byte array (read)
 RLAPI RLImage LoadImageFromMemory(const char* fileType, const unsigned char* fileData, int dataSize);      // Load image from memory buffer, fileType refers to extension: i.e. '.png'
+RLAPI bool ExportImage(RLImage image, const char* fileName);                                               // Export image data to file (PNG), returns true on success
 RLAPI const char* GetFileExtension(const char* fileName);         // Get pointer to extension for a filename string (includes dot: '.png')
 
 RLAPI void SetMaterialTexture(RLMaterial* material, int mapType, RLTexture2D texture);          // Set texture for a material map type (MATERIAL_MAP_DIFFUSE, MATERIAL_MAP_SPECULAR...)
 
 RLAPI void DrawMeshInstanced(RLMesh mesh, RLMaterial material, const Matrix* transforms, int instances); // Draw multiple mesh instances with material and different transforms
+RLAPI void DrawMeshInstancedEx(RLMesh mesh, RLMaterial material, Matrix transform, const Matrix* transforms, int instances); // Draw multiple mesh instances, with one extra transform applied to all of them
+RLAPI void DrawMeshInstancedPacked(RLMesh mesh, RLMaterial material, Matrix transform, float spacing, const unsigned short* instanceData, int instances); // Draw multiple mesh instances described by 4 unsigned shorts each, which the shader turns into transforms
+RLAPI void DrawMeshInstancedPackedBuffer(RLMesh mesh, RLMaterial material, Matrix transform, float spacing, unsigned int instanceBufferId, int firstInstance, int instances); // Draw a range of packed mesh instances from a persistent vertex buffer
 
 RLAPI void rlEnableShader(unsigned int id);             // Enable shader program
 
@@ -21,8 +21,34 @@ bool rlEnableVertexArray(unsigned int vaoId)
 	return result;
 }
 
+static unsigned int LoadVertexBufferGL(const void* buffer, int size, bool dynamic);
+static unsigned int LoadVertexBufferElementGL(const void* buffer, int size, bool dynamic);
+static void UpdateVertexBufferGL(unsigned int bufferId, const void* data, int dataSize, int offset);
+static void UnloadVertexBufferGL(unsigned int vboId);
+static void DrawMeshInstancedPackedBufferGL(RLMesh mesh, RLMaterial material, Matrix transform, float spacing, unsigned int instanceBufferId, int firstInstance, int instances);
+
+static rlBufferBackend bufferBackend = {
+	LoadVertexBufferGL,
+	LoadVertexBufferElementGL,
+	UpdateVertexBufferGL,
+	UnloadVertexBufferGL,
+	DrawMeshInstancedPackedBufferGL,
+};
+
+// Set the functions that buffers go through, and return the ones used until now
+rlBufferBackend rlSetBufferBackend(rlBufferBackend backend)
+{
+	std::swap(bufferBackend, backend);
+	return backend;
+}
+
 // Load a new attributes buffer
 unsigned int rlLoadVertexBuffer(const void* buffer, int size, bool dynamic)
+{
+	return bufferBackend.loadVertexBuffer(buffer, size, dynamic);
+}
+
+static unsigned int LoadVertexBufferGL(const void* buffer, int size, bool dynamic)
 {
 	unsigned int id = 0;
 
@@ -33,6 +59,18 @@ unsigned int rlLoadVertexBuffer(const void* buffer, int size, bool dynamic)
 	return id;
 }
 
+// Update data in a GPU vertex buffer, starting at `offset` bytes into it
+void rlUpdateVertexBuffer(unsigned int bufferId, const void* data, int dataSize, int offset)
+{
+	bufferBackend.updateVertexBuffer(bufferId, data, dataSize, offset);
+}
+
+static void UpdateVertexBufferGL(unsigned int bufferId, const void* data, int dataSize, int offset)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+	glBufferSubData(GL_ARRAY_BUFFER, offset, dataSize, data);
+}
+
 // Set vertex attribute
 void rlSetVertexAttribute(unsigned int index, int compSize, int type, bool normalized, int stride, const void* pointer)
 {
@@ -74,6 +112,11 @@ void rlDisableVertexAttribute(unsigned int index)
 
 // Load a new attributes element buffer
 unsigned int rlLoadVertexBufferElement(const void* buffer, int size, bool dynamic)
+{
+	return bufferBackend.loadVertexBufferElement(buffer, size, dynamic);
+}
+
+static unsigned int LoadVertexBufferElementGL(const void* buffer, int size, bool dynamic)
 {
 	unsigned int id = 0;
 
@@ -241,6 +284,11 @@ void rlUnloadVertexArray(unsigned int vaoId)
 
 // Unload vertex buffer (VBO)
 void rlUnloadVertexBuffer(unsigned int vboId)
+{
+	bufferBackend.unloadVertexBuffer(vboId);
+}
+
+static void UnloadVertexBufferGL(unsigned int vboId)
 {
 	glDeleteBuffers(1, &vboId);
 }
@@ -274,8 +322,8 @@ void UnloadModel(RLModel model)
 // Unload mesh from memory (RAM and VRAM)
 void UnloadMesh(RLMesh mesh)
 {
-	// Unload rlgl mesh vboId data
-	rlUnloadVertexArray(mesh.vaoId);
+	// Unload rlgl mesh vboId data. Meshes that were never uploaded, like the ones generated for export, don't have any.
+	if (mesh.vaoId > 0) rlUnloadVertexArray(mesh.vaoId);
 
 	if (mesh.vboId != NULL) for (int i = 0; i < MAX_MESH_VERTEX_BUFFERS; i++) rlUnloadVertexBuffer(mesh.vboId[i]);
 	RL_FREE(mesh.vboId);
@@ -435,8 +483,42 @@ void rlEnableVertexBufferElement(unsigned int id)
 #endif
 }
 
+static void DrawMeshInstancedData(RLMesh mesh, RLMaterial material, Matrix transform, float spacing, const void* instanceData, unsigned int instanceBufferId, int firstInstance, int instances, bool packed);
+
 // Draw multiple mesh instances with material and different transforms
 void DrawMeshInstanced(RLMesh mesh, RLMaterial material, const Matrix* transforms, int instances)
+{
+	DrawMeshInstancedData(mesh, material, MatrixIdentity(), 0.0f, transforms, 0, 0, instances, false);
+}
+
+// Draw multiple mesh instances, with an additional transform applied to all of them
+void DrawMeshInstancedEx(RLMesh mesh, RLMaterial material, Matrix transform, const Matrix* transforms, int instances)
+{
+	DrawMeshInstancedData(mesh, material, transform, 0.0f, transforms, 0, 0, instances, false);
+}
+
+// Draw multiple mesh instances, each described by 4 unsigned shorts that the shader expands into a transform in a grid with the given spacing
+void DrawMeshInstancedPacked(RLMesh mesh, RLMaterial material, Matrix transform, float spacing, const unsigned short* instanceData, int instances)
+{
+	DrawMeshInstancedData(mesh, material, transform, spacing, instanceData, 0, 0, instances, true);
+}
+
+// Draw a range of packed mesh instances that have already been uploaded to a vertex buffer
+void DrawMeshInstancedPackedBuffer(RLMesh mesh, RLMaterial material, Matrix transform, float spacing, unsigned int instanceBufferId, int firstInstance, int instances)
+{
+	bufferBackend.drawMeshInstancedPackedBuffer(mesh, material, transform, spacing, instanceBufferId, firstInstance, instances);
+}
+
+static void DrawMeshInstancedPackedBufferGL(RLMesh mesh, RLMaterial material, Matrix transform, float spacing, unsigned int instanceBufferId, int firstInstance, int instances)
+{
+	DrawMeshInstancedData(mesh, material, transform, spacing, NULL, instanceBufferId, firstInstance, instances, true);
+}
+
+// Instance data is either an array of matrices, or an array of 4 unsigned shorts per instance when `packed` is true.
+// Either way, it is sent to the shader attribute at location SHADER_LOC_MATRIX_MODEL.
+// When `instanceBufferId` isn't zero, packed instances are read from that buffer instead of being uploaded.
+// `spacing` is only used by packed instances, and is sent to the shader uniform at location SHADER_LOC_CEL_SPACING.
+static void DrawMeshInstancedData(RLMesh mesh, RLMaterial material, Matrix transform, float spacing, const void* instanceData, unsigned int instanceBufferId, int firstInstance, int instances, bool packed)
 {
 #if defined(GRAPHICS_API_OPENGL_33) || defined(GRAPHICS_API_OPENGL_ES2)
 	// Instancing required variables
@@ -479,7 +561,7 @@ void DrawMeshInstanced(RLMesh mesh, RLMaterial material, const Matrix* transform
 	// NOTE: At this point the modelview matrix just contains the view matrix (camera)
 	// That's because BeginMode3D() sets it and there is no model-drawing function
 	// that modifies it, all use rlPushMatrix() and rlPopMatrix()
-	Matrix matModel = MatrixIdentity();
+	Matrix matModel = transform;
 	Matrix matView = rlGetMatrixModelview(); // TODO:  
 	Matrix matModelView = MatrixIdentity();
 	Matrix matProjection = rlGetMatrixProjection();
@@ -488,27 +570,54 @@ void DrawMeshInstanced(RLMesh mesh, RLMaterial material, const Matrix* transform
 	if (material.shader.locs[SHADER_LOC_MATRIX_VIEW] != -1) rlSetUniformMatrix(material.shader.locs[SHADER_LOC_MATRIX_VIEW], matView);
 	if (material.shader.locs[SHADER_LOC_MATRIX_PROJECTION] != -1) rlSetUniformMatrix(material.shader.locs[SHADER_LOC_MATRIX_PROJECTION], matProjection);
 
-	// Create instances buffer
-	instanceTransforms = (float16*)RL_MALLOC(instances * sizeof(float16));
+	if (packed)
+	{
+		if (material.shader.locs[SHADER_LOC_CEL_SPACING] != -1) rlSetUniform(material.shader.locs[SHADER_LOC_CEL_SPACING], &spacing, SHADER_UNIFORM_FLOAT, 1);
 
-	// Fill buffer with instances transformations as float16 arrays
-	for (int i = 0; i < instances; i++) instanceTransforms[i] = MatrixToFloatV(transforms[i]);
+		rlEnableVertexArray(mesh.vaoId);
+		if (instanceBufferId != 0)
+		{
+			// Draw from the caller's buffer without creating a new one
+			rlEnableVertexBuffer(instanceBufferId);
+		}
+		else
+		{
+			// Packed instances are uploaded as they are
+			instancesVboId = rlLoadVertexBuffer(instanceData, instances * 4 * sizeof(unsigned short), false);
+		}
+
+		// Each instance is read as a vec4 of (non-normalized) integers, starting at the first instance to draw
+		const size_t stride = 4 * sizeof(unsigned short);
+		rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_MATRIX_MODEL]);
+		rlSetVertexAttribute(material.shader.locs[SHADER_LOC_MATRIX_MODEL], 4, RL_UNSIGNED_SHORT, 0, int(stride), (void*)(firstInstance * stride));
+		rlSetVertexAttributeDivisor(material.shader.locs[SHADER_LOC_MATRIX_MODEL], 1);
+	}
+	else
+	{
+		const Matrix* transforms = (const Matrix*)instanceData;
 
-	// Enable mesh VAO to attach new buffer
-	rlEnableVertexArray(mesh.vaoId);
+		// Create instances buffer
+		instanceTransforms = (float16*)RL_MALLOC(instances * sizeof(float16));
 
-	// This could alternatively use a static VBO and either glMapBuffer() or glBufferSubData().
-	// It isn't clear which would be reliably faster in all cases and on all platforms,
-	// anecdotally glMapBuffer() seems very slow (syncs) while glBufferSubData() seems
-	// no faster, since we're transferring all the transform matrices anyway
-	instancesVboId = rlLoadVertexBuffer(instanceTransforms, instances * sizeof(float16), false);
+		// Fill buffer with instances transformations as float16 arrays
+		for (int i = 0; i < instances; i++) instanceTransforms[i] = MatrixToFloatV(transforms[i]);
 
-	// Instances transformation matrices are send to shader attribute location: SHADER_LOC_MATRIX_MODEL
-	for (unsigned int i = 0; i < 4; i++)
-	{
-		rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_MATRIX_MODEL] + i);
-		rlSetVertexAttribute(material.shader.locs[SHADER_LOC_MATRIX_MODEL] + i, 4, RL_FLOAT, 0, sizeof(Matrix), (void*)(i * sizeof(Vector4)));
-		rlSetVertexAttributeDivisor(material.shader.locs[SHADER_LOC_MATRIX_MODEL] + i, 1);
+		// Enable mesh VAO to attach new buffer
+		rlEnableVertexArray(mesh.vaoId);
+
+		// This could alternatively use a static VBO and either glMapBuffer() or glBufferSubData().
+		// It isn't clear which would be reliably faster in all cases and on all platforms,
+		// anecdotally glMapBuffer() seems very slow (syncs) while glBufferSubData() seems
+		// no faster, since we're transferring all the transform matrices anyway
+		instancesVboId = rlLoadVertexBuffer(instanceTransforms, instances * sizeof(float16), false);
+
+		// Instances transformation matrices are send to shader attribute location: SHADER_LOC_MATRIX_MODEL
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_MATRIX_MODEL] + i);
+			rlSetVertexAttribute(material.shader.locs[SHADER_LOC_MATRIX_MODEL] + i, 4, RL_FLOAT, 0, sizeof(Matrix), (void*)(i * sizeof(Vector4)));
+			rlSetVertexAttributeDivisor(material.shader.locs[SHADER_LOC_MATRIX_MODEL] + i, 1);
+		}
 	}
 
 	rlDisableVertexBuffer();
@@ -516,7 +625,7 @@ void DrawMeshInstanced(RLMesh mesh, RLMaterial material, const Matrix* transform
 
 	// Accumulate internal matrix transform (push/pop) and view matrix
 	// NOTE: In this case, model instance transformation must be computed in the shader
-	matModelView = MatrixMultiply(rlGetMatrixTransform(), matView);
+	matModelView = MatrixMultiply(MatrixMultiply(matModel, rlGetMatrixTransform()), matView);
 
 	// Upload model normal matrix (if locations available)
 	if (material.shader.locs[SHADER_LOC_MATRIX_NORMAL] != -1) rlSetUniformMatrix(material.shader.locs[SHADER_LOC_MATRIX_NORMAL], MatrixTranspose(MatrixInvert(matModel)));
@@ -651,7 +760,7 @@ void DrawMeshInstanced(RLMesh mesh, RLMaterial material, const Matrix* transform
 	rlDisableShader();
 
 	// Remove instance transforms buffer
-	rlUnloadVertexBuffer(instancesVboId);
+	if (instancesVboId != 0) rlUnloadVertexBuffer(instancesVboId);
 	RL_FREE(instanceTransforms);
 #endif
 }
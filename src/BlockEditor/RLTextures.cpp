@@ -2,6 +2,10 @@
 #include "RL.h"
 #include "stb/stb_image.h"
 
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"    // Required for: stbi_write_png() [ExportImage()]
+
 #ifndef GL_ETC1_RGB8_OES
 #define GL_ETC1_RGB8_OES                    0x8D64
 #endif
@@ -542,6 +546,31 @@ RLImage LoadImageFromMemory(const char* fileType, const unsigned char* fileData,
     return image;
 }
 
+// Export image data to a PNG file
+// NOTE: Images that aren't 8-bit RGBA are converted first
+bool ExportImage(RLImage image, const char* fileName)
+{
+    int success = 0;
+
+    if ((image.width == 0) || (image.height == 0) || (image.data == NULL)) return false;
+
+    if (image.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8)
+    {
+        success = stbi_write_png(fileName, image.width, image.height, 4, image.data, image.width * 4);
+    }
+    else
+    {
+        Color* colors = LoadImageColors(image);
+        if (colors != NULL) success = stbi_write_png(fileName, image.width, image.height, 4, colors, image.width * 4);
+        UnloadImageColors(colors);
+    }
+
+    if (success != 0) TRACELOG(LOG_INFO, "FILEIO: [%s] Image exported successfully", fileName);
+    else TRACELOG(LOG_WARNING, "FILEIO: [%s] Failed to export image", fileName);
+
+    return success != 0;
+}
+
 // Select and active a texture slot
 void rlActiveTextureSlot(int slot)
 {
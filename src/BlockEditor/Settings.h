@@ -7,6 +7,17 @@ struct Settings final
 	size_t undoMax;
 	float mouseSensitivity;
 	bool exportSeparateGeometry, cullFaces; //For GLTF export
+	bool greedyMeshing; //Merges coplanar faces into larger quads, for GLTF export and preview
+	bool exportIndices32; //For GLTF export
+	bool weldVertices; //Merges duplicate vertices, for GLTF export and preview
+	bool exportOptimizeVertexCache; //For GLTF export
+	bool exportInstancing, exportBakeCubes; //For GLTF export
+	bool exportQuantize; //For GLTF export
+	bool exportAtlas; //Packs tile textures into atlases, for GLTF export
+	int exportChunkSize; //For GLTF export. 0 exports the map in one piece.
+	bool exportVisibility; //Potentially visible sets of chunks, for GLTF export
+	bool exportColliders; //For GLTF export
+	int exportLodLevels; //Coarser levels of detail, for GLTF export
 	std::string exportFilePath; //For GLTF export
 	std::string defaultTexturePath;
 	std::string defaultShapePath;
@@ -0,0 +1,83 @@
+#include "stdafx.h"
+#include "TextureAtlas.h"
+#include "Core.h"
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imgui/imstb_rectpack.h"
+
+// Copies the image into the atlas at (x, y), and repeats its edge pixels `padding` times on every side.
+static void BlitPadded(Color* atlas, int atlasWidth, const Color* pixels, int width, int height, int x, int y, int padding)
+{
+	for (int ay = y - padding; ay < y + height + padding; ++ay)
+	{
+		const int sy = Min(Max(ay - y, 0), height - 1);
+		for (int ax = x - padding; ax < x + width + padding; ++ax)
+		{
+			const int sx = Min(Max(ax - x, 0), width - 1);
+			atlas[ay * atlasWidth + ax] = pixels[sy * width + sx];
+		}
+	}
+}
+
+std::vector<RLImage> PackTextureAtlases(const std::vector<RLImage>& images, int maxSize, int padding, std::vector<AtlasEntry>& entries)
+{
+	entries.assign(images.size(), AtlasEntry{});
+
+	// Rectangles that still need a place, including their padding. Images that can't fit even on their own are skipped.
+	std::vector<stbrp_rect> remaining;
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		const int width = images[i].width + padding * 2;
+		const int height = images[i].height + padding * 2;
+		if (images[i].data == NULL || width > maxSize || height > maxSize) continue;
+		remaining.push_back(stbrp_rect{ int(i), width, height });
+	}
+
+	std::vector<RLImage> atlases;
+	std::vector<stbrp_node> nodes(maxSize);
+	while (!remaining.empty())
+	{
+		// Use the smallest power of two size that fits everything that's left, or the largest size if nothing does.
+		size_t area = 0;
+		for (const stbrp_rect& rect : remaining) area += size_t(rect.w) * rect.h;
+		int size = 1;
+		while (size < maxSize && size_t(size) * size < area) size *= 2;
+
+		std::vector<stbrp_rect> rects;
+		for (; ; size *= 2)
+		{
+			size = Min(size, maxSize);
+			rects = remaining;
+			stbrp_context context;
+			stbrp_init_target(&context, size, size, nodes.data(), size);
+			if (stbrp_pack_rects(&context, rects.data(), int(rects.size())) || size == maxSize) break;
+		}
+
+		RLImage atlas = { 0 };
+		atlas.width = size;
+		atlas.height = size;
+		atlas.mipmaps = 1;
+		atlas.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+		atlas.data = RL_CALLOC(size_t(size) * size, sizeof(Color));
+
+		remaining.clear();
+		for (const stbrp_rect& rect : rects)
+		{
+			if (!rect.was_packed)
+			{
+				remaining.push_back(rect);
+				continue;
+			}
+
+			const RLImage& image = images[rect.id];
+			Color* pixels = LoadImageColors(image);
+			BlitPadded((Color*)atlas.data, size, pixels, image.width, image.height, rect.x + padding, rect.y + padding, padding);
+			UnloadImageColors(pixels);
+
+			entries[rect.id] = AtlasEntry{ int(atlases.size()), rect.x + padding, rect.y + padding, image.width, image.height };
+		}
+		atlases.push_back(atlas);
+	}
+	return atlases;
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "RL.h"
+
+// Where one image was placed in a texture atlas. The rectangle doesn't include the padding around the image.
+struct AtlasEntry
+{
+	int atlas = -1; // Index of the atlas, or -1 if the image wasn't packed
+	int x = 0, y = 0, width = 0, height = 0;
+};
+
+// Packs the images into as few RGBA atlases as possible, each no larger than `maxSize` pixels on a side, and returns the atlases.
+// Each image is surrounded by `padding` pixels that repeat its edges, so that filtering doesn't pick up its neighbors.
+// `entries` receives the place of each image. Images that don't fit into an empty atlas are left out. The caller has to unload the atlases.
+std::vector<RLImage> PackTextureAtlases(const std::vector<RLImage>& images, int maxSize, int padding, std::vector<AtlasEntry>& entries);
\ No newline at end of file
@@ -10,6 +10,7 @@ typedef int ModelID;
 #define TILE_SPACING_DEFAULT 2.0f
 #define NO_TEX -1
 #define NO_MODEL -1
+#define TILE_ORIENTATION_COUNT 24
 
 struct Tile
 {
@@ -21,6 +22,8 @@ struct Tile
 		return shape > NO_MODEL && texture > NO_TEX;
 	}
 
+	bool operator==(const Tile& other) const = default;
+
 	ModelID shape = NO_MODEL;
 	int angle = 0; // Yaw in whole number of degrees
 	TexID texture = NO_TEX;
@@ -30,4 +33,72 @@ struct Tile
 inline Matrix TileRotationMatrix(const Tile& tile)
 {
 	return MatrixMultiply(MatrixRotateX(ToRadians(float(-tile.pitch))), MatrixRotYDeg(float(-tile.angle)));
+}
+
+// Returns the rotation matrices of all 24 axis-aligned orientations.
+// The first 16 are the tile rotations, in the order given by TileOrientation(). The rest also have a roll around the Z axis.
+inline const std::array<Matrix, TILE_ORIENTATION_COUNT>& TileOrientationMatrices()
+{
+	static const std::array<Matrix, TILE_ORIENTATION_COUNT> orientations = []()
+		{
+			std::array<Matrix, TILE_ORIENTATION_COUNT> result;
+			int count = 0;
+			for (int roll = 0; roll < 360; roll += 90)
+			{
+				for (int pitch = 0; pitch < 360; pitch += 90)
+				{
+					for (int yaw = 0; yaw < 360; yaw += 90)
+					{
+						Matrix matrix = MatrixMultiply(MatrixRotate(Vector3{ 0.0f, 0.0f, 1.0f }, ToRadians(float(roll))), TileRotationMatrix(Tile(NO_MODEL, yaw, NO_TEX, pitch)));
+
+						// Snap to whole numbers (and get rid of negative zeros) so that identical rotations compare equal.
+						float* elements = &matrix.m0;
+						for (int e = 0; e < 16; ++e) elements[e] = roundf(elements[e]) + 0.0f;
+
+						bool duplicate = false;
+						for (int o = 0; o < count && !duplicate; ++o)
+						{
+							duplicate = (memcmp(&result[o], &matrix, sizeof(Matrix)) == 0);
+						}
+						if (!duplicate) result[count++] = matrix;
+					}
+				}
+			}
+			assert(count == TILE_ORIENTATION_COUNT);
+			return result;
+		}();
+	return orientations;
+}
+
+// Returns the index of the tile's rotation in TileOrientationMatrices(). Angles are rounded to the nearest 90 degrees.
+inline int TileOrientation(const Tile& tile)
+{
+	const int yawSteps = int(lroundf(float(tile.angle) / 90.0f)) & 3;
+	const int pitchSteps = int(lroundf(float(tile.pitch) / 90.0f)) & 3;
+	return pitchSteps * 4 + yawSteps;
+}
+
+// Compact form of a tile's transform that is used for instanced rendering.
+struct TileInstance
+{
+	uint16_t x, y, z; // Grid coordinates
+	uint16_t orientation; // Index into TileOrientationMatrices()
+
+	bool operator==(const TileInstance& other) const = default;
+};
+static_assert(sizeof(TileInstance) == 8);
+
+inline TileInstance PackTileInstance(int i, int j, int k, const Tile& tile)
+{
+	return TileInstance{ uint16_t(i), uint16_t(j), uint16_t(k), uint16_t(TileOrientation(tile)) };
+}
+
+// Returns the transform of the tile instance in a grid with the given spacing, positioned at the center of its cel.
+inline Matrix UnpackTileInstance(const TileInstance& instance, float spacing)
+{
+	Matrix matrix = TileOrientationMatrices()[instance.orientation];
+	matrix.m12 = (float(instance.x) + 0.5f) * spacing;
+	matrix.m13 = (float(instance.y) + 0.5f) * spacing;
+	matrix.m14 = (float(instance.z) + 0.5f) * spacing;
+	return matrix;
 }
\ No newline at end of file
@@ -3,71 +3,125 @@
 #include "MapMan.h"
 #include "EditorApp.h"
 #include "RL.h"
+#include "WorkerPool.h"
+#include "MeshTools.h"
 #include "cppcodec/base64_default_rfc4648.hpp"
 
 TileGrid::TileGrid() : TileGrid(nullptr, 0, 0, 0)
 {
 }
 
-TileGrid::TileGrid(MapMan* mapMan, size_t width, size_t height, size_t length)
-	: TileGrid(mapMan, width, height, length, TILE_SPACING_DEFAULT, Tile{ NO_MODEL, 0, NO_TEX, 0 })
+TileGrid::TileGrid(MapMan* mapMan, size_t width, size_t height, size_t length, GridStorage storage)
+	: TileGrid(mapMan, width, height, length, TILE_SPACING_DEFAULT, Tile{ NO_MODEL, 0, NO_TEX, 0 }, storage)
 {
 }
 
-TileGrid::TileGrid(MapMan* mapMan, size_t width, size_t height, size_t length, float spacing, Tile fill)
-	: Grid<Tile>(width, height, length, spacing, fill)
+TileGrid::TileGrid(MapMan* mapMan, size_t width, size_t height, size_t length, float spacing, Tile fill, GridStorage storage)
+	: Grid<PaletteID>(width, height, length, spacing, PALETTE_EMPTY, storage)
 {
+	_palette.push_back(Tile());
+
+	// The grid's own fill cel is always the empty tile, so that only non-empty tiles take up space in chunked grids.
+	if (fill) fillCels(0, 0, 0, width, height, length, _GetPaletteID(fill));
+
 	_mapMan = mapMan;
-	_batchFromY = 0;
-	_batchToY = height - 1;
-	_batchPosition = Vector3Zero();
 	_model = nullptr;
 	_regenBatches = true;
 	_regenModel = true;
 	_modelCulled = false;
+	_modelGreedy = false;
+	_modelWelded = false;
+}
+
+PaletteID TileGrid::_GetPaletteID(const Tile& tile)
+{
+	// Entries whose tiles have all been painted over are only dropped once they're needed
+	if (tile && _palette.size() >= PALETTE_MAX_SIZE && _paletteLookup.find(_PaletteKey(tile)) == _paletteLookup.end()) _CompactPalette();
+	return _GetPaletteIDWithoutCompacting(tile);
+}
+
+PaletteID TileGrid::_GetPaletteIDWithoutCompacting(const Tile& tile)
+{
+	// All empty tiles are treated the same, regardless of their other fields.
+	if (!tile) return PALETTE_EMPTY;
+
+	PaletteKey key = _PaletteKey(tile);
+	auto iter = _paletteLookup.find(key);
+	if (iter != _paletteLookup.end()) return iter->second;
+
+	if (_palette.size() >= PALETTE_MAX_SIZE)
+	{
+		std::cerr << "TileGrid: Error: The grid already uses " << (PALETTE_MAX_SIZE - 1) << " distinct tiles. A tile with shape " << tile.shape
+			<< " and texture " << tile.texture << " could not be placed." << std::endl;
+		if (GetApp()) GetApp()->DisplayStatusMessage("ERROR: Too many distinct tiles in the map. Some tiles were not placed. Check the console.", 5.0f, 100);
+		return PALETTE_EMPTY;
+	}
+
+	PaletteID id = PaletteID(_palette.size());
+	_palette.push_back(tile);
+	_paletteLookup[key] = id;
+	return id;
+}
+
+void TileGrid::_CompactPalette()
+{
+	std::vector<int> remap(_palette.size(), -1);
+	remap[PALETTE_EMPTY] = PALETTE_EMPTY;
+	std::vector<Tile> palette = { Tile() };
+	forEachCel(0, int(m_height) - 1, [&](size_t, PaletteID id)
+		{
+			if (remap[id] >= 0) return;
+			remap[id] = int(palette.size());
+			palette.push_back(_palette[id]);
+		});
+	transformCels([&](PaletteID id) { return PaletteID(remap[id]); });
+
+	_palette = std::move(palette);
+	_paletteLookup.clear();
+	for (size_t p = PALETTE_EMPTY + 1; p < _palette.size(); ++p) _paletteLookup.try_emplace(_PaletteKey(_palette[p]), PaletteID(p));
 }
 
 Tile TileGrid::GetTile(int i, int j, int k) const
 {
-	return getCel(i, j, k);
+	return _palette[celAt(i, j, k)];
 }
 
 Tile TileGrid::GetTile(int flatIndex) const
 {
-	return m_grid[flatIndex];
+	return _palette[celAt(size_t(flatIndex))];
+}
+
+bool TileGrid::HasTile(int i, int j, int k) const
+{
+	return celAt(i, j, k) != PALETTE_EMPTY;
 }
 
 void TileGrid::SetTile(int i, int j, int k, const Tile& tile)
 {
-	setCel(i, j, k, tile);
-	_regenBatches = true;
-	_regenModel = true;
+	// Tiles that don't fit into the palette leave the cel as it was
+	const PaletteID id = _GetPaletteID(tile);
+	if (tile && id == PALETTE_EMPTY) return;
+	setCel(i, j, k, id);
+	_MarkDirty(i, j, k, 1, 1, 1);
 }
 
 void TileGrid::SetTile(int flatIndex, const Tile& tile)
 {
-	m_grid[flatIndex] = tile;
-	_regenBatches = true;
-	_regenModel = true;
+	const PaletteID id = _GetPaletteID(tile);
+	if (tile && id == PALETTE_EMPTY) return;
+	setCel(size_t(flatIndex), id);
+	Vector3 gridPos = UnflattenIndex(size_t(flatIndex));
+	_MarkDirty(int(gridPos.x), int(gridPos.y), int(gridPos.z), 1, 1, 1);
 }
 
 void TileGrid::SetTileRect(int i, int j, int k, int w, int h, int l, const Tile& tile)
 {
 	assert(i >= 0 && j >= 0 && k >= 0);
 	assert(i + w <= int(m_width) && j + h <= int(m_height) && k + l <= int(m_length));
-	for (int y = j; y < j + h; ++y)
-	{
-		for (int z = k; z < k + l; ++z)
-		{
-			size_t base = FlatIndex(0, y, z);
-			for (int x = i; x < i + w; ++x)
-			{
-				m_grid[base + x] = tile;
-			}
-		}
-	}
-	_regenBatches = true;
-	_regenModel = true;
+	const PaletteID id = _GetPaletteID(tile);
+	if (tile && id == PALETTE_EMPTY) return;
+	fillCels(i, j, k, w, h, l, id);
+	_MarkDirty(i, j, k, w, h, l);
 }
 
 void TileGrid::CopyTiles(int i, int j, int k, const TileGrid& src, bool ignoreEmpty)
@@ -76,89 +130,375 @@ void TileGrid::CopyTiles(int i, int j, int k, const TileGrid& src, bool ignoreEm
 	int xEnd = Min(i + int(src.m_width), int(m_width));
 	int yEnd = Min(j + int(src.m_height), int(m_height));
 	int zEnd = Min(k + int(src.m_length), int(m_length));
+
+	// Translate the source grid's palette into this grid's palette once, rather than once per tile.
+	// If the tiles that are new to this grid don't fit, then the palette is compacted up front, since compacting renumbers it.
+	std::vector<PaletteID> remap(src._palette.size());
+	size_t newEntries = 0;
+	for (size_t p = PALETTE_EMPTY + 1; p < src._palette.size(); ++p)
+	{
+		if (_paletteLookup.find(_PaletteKey(src._palette[p])) == _paletteLookup.end()) ++newEntries;
+	}
+	if (_palette.size() + newEntries > PALETTE_MAX_SIZE) _CompactPalette();
+	for (size_t p = 0; p < src._palette.size(); ++p)
+	{
+		remap[p] = _GetPaletteIDWithoutCompacting(src._palette[p]);
+	}
+
 	for (int z = k; z < zEnd; ++z)
 	{
 		for (int y = j; y < yEnd; ++y)
 		{
-			size_t ourBase = FlatIndex(0, y, z);
-			size_t theirBase = src.FlatIndex(0, y - j, z - k);
 			for (int x = i; x < xEnd; ++x)
 			{
-				const Tile& tile = src.m_grid[theirBase + (x - i)];
-				if (!ignoreEmpty || tile)
+				PaletteID id = src.celAt(x - i, y - j, z - k);
+				if (id != PALETTE_EMPTY && remap[id] == PALETTE_EMPTY) continue; // Didn't fit into the palette
+				if (!ignoreEmpty || id != PALETTE_EMPTY)
 				{
-					m_grid[ourBase + x] = tile;
+					setCel(x, y, z, remap[id]);
 				}
 			}
 		}
 	}
-	_regenBatches = true;
-	_regenModel = true;
+	_MarkDirty(i, j, k, xEnd - i, yEnd - j, zEnd - k);
 }
 
 void TileGrid::UnsetTile(int i, int j, int k)
 {
-	m_grid[FlatIndex(i, j, k)].shape = NO_MODEL;
-	_regenBatches = true;
-	_regenModel = true;
+	setCel(i, j, k, PALETTE_EMPTY);
+	_MarkDirty(i, j, k, 1, 1, 1);
 }
 
-TileGrid TileGrid::Subsection(int i, int j, int k, int w, int h, int l) const
+TileGrid TileGrid::Subsection(int i, int j, int k, int w, int h, int l, GridStorage storage) const
 {
 	assert(i >= 0 && j >= 0 && k >= 0);
 	assert(i + w <= int(m_width) && j + h <= int(m_height) && k + l <= int(m_length));
 
-	TileGrid newGrid(_mapMan, w, h, l);
+	TileGrid newGrid(_mapMan, w, h, l, storage);
 
-	subsectionCopy(i, j, k, w, h, l, newGrid);
+	// Only the tiles that are used inside of the subsection go into the new grid's palette.
+	std::vector<int> remap(_palette.size(), -1);
+	remap[PALETTE_EMPTY] = PALETTE_EMPTY;
+	for (int z = k; z < k + l; ++z)
+	{
+		for (int y = j; y < j + h; ++y)
+		{
+			for (int x = i; x < i + w; ++x)
+			{
+				PaletteID id = celAt(x, y, z);
+				if (remap[id] < 0) remap[id] = newGrid._GetPaletteID(_palette[id]);
+				newGrid.setCel(x - i, y - j, z - k, PaletteID(remap[id]));
+			}
+		}
+	}
 
 	newGrid._regenBatches = true;
 
 	return newGrid;
 }
 
-void TileGrid::_RegenBatches(Vector3 position, int fromY, int toY)
+void TileGrid::RemapTiles(const std::function<void(Tile&)>& remap)
 {
-	if (!_mapMan) return;
+	_paletteLookup.clear();
+	for (size_t p = 1; p < _palette.size(); ++p)
+	{
+		remap(_palette[p]);
+		// Entries that end up identical keep working, but only the first is handed out to new tiles.
+		_paletteLookup.try_emplace(_PaletteKey(_palette[p]), PaletteID(p));
+	}
+	_MarkDirty(0, 0, 0, int(m_width), int(m_height), int(m_length));
+}
 
-	_drawBatches.clear();
-	_batchFromY = fromY;
-	_batchToY = toY;
-	_batchPosition = position;
-	_regenBatches = false;
+void TileGrid::_MarkDirty(int i, int j, int k, int w, int h, int l)
+{
+	_regenBatches = true;
+	_regenModel = true;
+
+	// If the render chunks haven't been made yet, then they will all be built on the next regen anyway.
+	if (_renderChunks.empty() || w <= 0 || h <= 0 || l <= 0) return;
 
-	const size_t layerArea = m_width * m_length;
-	// Create a hash map of dynamic arrays for each combination of texture and mesh
-	for (int y = fromY; y <= toY; ++y)
+	for (int y = j; y < j + h; ++y)
 	{
-		for (size_t t = y * layerArea; t < (y + 1) * layerArea; ++t)
+		for (int cz = k / GRID_CHUNK_SIZE; cz <= (k + l - 1) / GRID_CHUNK_SIZE; ++cz)
 		{
-			const Tile& tile = m_grid[t];
-			if (tile)
+			for (int cx = i / GRID_CHUNK_SIZE; cx <= (i + w - 1) / GRID_CHUNK_SIZE; ++cx)
 			{
-				// Calculate world space matrix for the tile
-				Vector3 gridPos = UnflattenIndex(t);
-				Vector3 worldPos = Vector3Add(position, GridToWorldPos(gridPos, true));
-				Matrix rotMatrix = TileRotationMatrix(tile);
-				Matrix matrix = MatrixMultiply(rotMatrix, MatrixTranslate(worldPos.x, worldPos.y, worldPos.z));
-
-				const RLModel& shape = _mapMan->ModelFromID(tile.shape);
-				for (int m = 0; m < shape.meshCount; ++m)
+				const size_t c = _RenderChunkIndex(cx, y, cz);
+				if (!_renderChunks[c].dirty)
 				{
-					// Add the tile's transform to the instance arrays for each mesh
-					auto pair = std::make_pair(tile.texture, &shape.meshes[m]);
-					if (_drawBatches.find(pair) == _drawBatches.end())
-					{
-						// Put in a vector for this pair if there hasn't been one already
-						_drawBatches[pair] = std::vector<Matrix>();
-					}
-					_drawBatches[pair].push_back(matrix);
+					_renderChunks[c].dirty = true;
+					_dirtyChunks.push_back(c);
 				}
 			}
 		}
 	}
 }
 
+size_t TileGrid::_RenderChunkIndex(int cx, int y, int cz) const
+{
+	const size_t chunksX = (m_width + GRID_CHUNK_SIZE - 1) / GRID_CHUNK_SIZE;
+	const size_t chunksZ = (m_length + GRID_CHUNK_SIZE - 1) / GRID_CHUNK_SIZE;
+	return (y * chunksZ + cz) * chunksX + cx;
+}
+
+void TileGrid::_RegenChunk(int cx, int y, int cz)
+{
+	RenderChunk& chunk = _renderChunks[_RenderChunkIndex(cx, y, cz)];
+	chunk.batches.clear();
+	chunk.instances.clear();
+	chunk.dirty = false;
+
+	const int xEnd = Min((cx + 1) * GRID_CHUNK_SIZE, int(m_width));
+	const int zEnd = Min((cz + 1) * GRID_CHUNK_SIZE, int(m_length));
+	for (int z = cz * GRID_CHUNK_SIZE; z < zEnd; ++z)
+	{
+		for (int x = cx * GRID_CHUNK_SIZE; x < xEnd; ++x)
+		{
+			const Tile& tile = _palette[celAt(x, y, z)];
+			if (!tile) continue;
+
+			// The instance is relative to the grid. The grid's position is applied when drawing.
+			const TileInstance instance = PackTileInstance(x, y, z, tile);
+
+			const RLModel& shape = _mapMan->ModelFromID(tile.shape);
+			const int firstBatch = _BatchIndex(tile.texture, tile.shape);
+			for (int m = 0; m < shape.meshCount; ++m)
+			{
+				// Add an instance of each of the shape's meshes
+				chunk.batches.push_back(firstBatch + m);
+				chunk.instances.push_back(instance);
+			}
+		}
+	}
+}
+
+int TileGrid::_BatchIndex(TexID texture, ModelID shape)
+{
+	if (size_t(texture) >= _batchTable.size()) _batchTable.resize(texture + 1);
+	std::vector<int>& row = _batchTable[texture];
+	if (size_t(shape) >= row.size()) row.resize(shape + 1, -1);
+
+	if (row[shape] < 0)
+	{
+		// Allocate consecutive batches for each of the shape's meshes
+		row[shape] = int(_drawBatches.size());
+		const RLModel& model = _mapMan->ModelFromID(shape);
+		for (int m = 0; m < model.meshCount; ++m)
+		{
+			_drawBatches.push_back(DrawBatch{ texture, shape, m });
+		}
+	}
+	return row[shape];
+}
+
+void TileGrid::_RegenBatches()
+{
+	if (!_mapMan) return;
+
+	_regenBatches = false;
+
+	const int chunksX = int((m_width + GRID_CHUNK_SIZE - 1) / GRID_CHUNK_SIZE);
+	const int chunksZ = int((m_length + GRID_CHUNK_SIZE - 1) / GRID_CHUNK_SIZE);
+	const size_t layerChunks = size_t(chunksX * chunksZ);
+	if (_renderChunks.size() != layerChunks * m_height)
+	{
+		_renderChunks.assign(layerChunks * m_height, RenderChunk());
+		_drawBatches.clear();
+		_batchTable.clear();
+		_dirtyChunks.clear();
+		for (size_t c = 0; c < _renderChunks.size(); ++c)
+		{
+			_RegenChunk(int(c % chunksX), int(c / layerChunks), int((c / chunksX) % chunksZ));
+		}
+		_SortInstances();
+		return;
+	}
+
+	if (_dirtyChunks.empty()) return;
+
+	// Returns the instances of a chunk grouped by batch, keeping their order within each batch.
+	auto groupByBatch = [](const RenderChunk& chunk)
+		{
+			std::vector<std::pair<int, TileInstance>> grouped(chunk.batches.size());
+			for (size_t i = 0; i < grouped.size(); ++i) grouped[i] = { chunk.batches[i], chunk.instances[i] };
+			std::stable_sort(grouped.begin(), grouped.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+			return grouped;
+		};
+
+	// Only the chunks that were edited since the last regen need their instances recalculated.
+	// Note the layers of the batches whose instances in those chunks changed.
+	const size_t batchCount = _drawBatches.size();
+	std::vector<std::pair<int, int>> touched; // (batch, layer)
+	for (size_t c : _dirtyChunks)
+	{
+		const int y = int(c / layerChunks);
+		const std::vector<std::pair<int, TileInstance>> before = groupByBatch(_renderChunks[c]);
+		_RegenChunk(int(c % chunksX), y, int((c / chunksX) % chunksZ));
+		const std::vector<std::pair<int, TileInstance>> after = groupByBatch(_renderChunks[c]);
+
+		for (size_t i = 0, j = 0; i < before.size() || j < after.size();)
+		{
+			const int b = std::min(i < before.size() ? before[i].first : INT_MAX, j < after.size() ? after[j].first : INT_MAX);
+			const size_t iStart = i, jStart = j;
+			while (i < before.size() && before[i].first == b) ++i;
+			while (j < after.size() && after[j].first == b) ++j;
+			if (!std::equal(before.begin() + iStart, before.begin() + i, after.begin() + jStart, after.begin() + j)) touched.emplace_back(b, y);
+		}
+	}
+
+	// Edits that cover a large part of the map, or that need new batches, are cheaper to sort from scratch.
+	const bool resort = (_dirtyChunks.size() > _renderChunks.size() / 4 || _drawBatches.size() != batchCount);
+	_dirtyChunks.clear();
+	if (resort)
+	{
+		_SortInstances();
+		return;
+	}
+
+	// Gather the new instances of the touched batches, going over the chunks of each touched layer once.
+	std::sort(touched.begin(), touched.end(), [](const auto& a, const auto& b) { return std::tie(a.second, a.first) < std::tie(b.second, b.first); });
+	touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+	std::vector<std::vector<TileInstance>> gathered(touched.size());
+	std::vector<int> slots(_drawBatches.size(), -1);
+	for (size_t t = 0; t < touched.size();)
+	{
+		const int y = touched[t].second;
+		size_t layerEnd = t;
+		for (; layerEnd < touched.size() && touched[layerEnd].second == y; ++layerEnd) slots[touched[layerEnd].first] = int(layerEnd);
+
+		for (size_t c = y * layerChunks; c < (y + 1) * layerChunks; ++c)
+		{
+			const RenderChunk& chunk = _renderChunks[c];
+			for (size_t i = 0; i < chunk.batches.size(); ++i)
+			{
+				if (slots[chunk.batches[i]] >= 0) gathered[slots[chunk.batches[i]]].push_back(chunk.instances[i]);
+			}
+		}
+
+		for (; t < layerEnd; ++t) slots[touched[t].first] = -1;
+	}
+
+	// Then patch each batch, with its layers in increasing order.
+	std::vector<size_t> order(touched.size());
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return touched[a].first < touched[b].first; });
+	std::vector<int> layers;
+	std::vector<std::vector<TileInstance>> layerInstances;
+	for (size_t o = 0; o < order.size(); ++o)
+	{
+		layers.push_back(touched[order[o]].second);
+		layerInstances.push_back(std::move(gathered[order[o]]));
+		if (o + 1 < order.size() && touched[order[o + 1]].first == touched[order[o]].first) continue;
+
+		if (!_PatchBatch(touched[order[o]].first, layers, layerInstances))
+		{
+			_SortInstances();
+			return;
+		}
+		layers.clear();
+		layerInstances.clear();
+	}
+}
+
+void TileGrid::_SortInstances()
+{
+	const size_t layerChunks = _renderChunks.size() / std::max<size_t>(m_height, 1);
+
+	// Sort the instances of all chunks into one array, grouped by batch and then by layer, with a counting sort.
+	// First count the instances of each layer of each batch, storing the count in the slot after it...
+	const size_t stride = m_height + 1;
+	_layerStarts.assign(_drawBatches.size() * stride, 0);
+	for (size_t c = 0; c < _renderChunks.size(); ++c)
+	{
+		const size_t y = c / layerChunks;
+		for (int b : _renderChunks[c].batches)
+		{
+			++_layerStarts[b * stride + y + 1];
+		}
+	}
+
+	// ...then turn the counts into offsets. Each batch starts after the one before it, plus some room for that batch to grow,
+	// so that placing tiles only moves the instances of their own batch.
+	size_t base = 0;
+	for (size_t b = 0; b < _drawBatches.size(); ++b)
+	{
+		size_t* starts = &_layerStarts[b * stride];
+		starts[0] = base;
+		for (size_t y = 1; y < stride; ++y)
+		{
+			starts[y] += starts[y - 1];
+		}
+		const size_t count = starts[m_height] - base;
+		base = starts[m_height] + count / 4 + 16;
+	}
+
+	// Finally, place every instance at the next free slot in its range.
+	_instanceBuffer.outdated = true;
+	_instances.assign(base, TileInstance{});
+	std::vector<size_t> cursors = _layerStarts;
+	for (size_t c = 0; c < _renderChunks.size(); ++c)
+	{
+		const size_t y = c / layerChunks;
+		const RenderChunk& chunk = _renderChunks[c];
+		for (size_t i = 0; i < chunk.batches.size(); ++i)
+		{
+			_instances[cursors[chunk.batches[i] * stride + y]++] = chunk.instances[i];
+		}
+	}
+}
+
+bool TileGrid::_PatchBatch(int b, const std::vector<int>& layers, const std::vector<std::vector<TileInstance>>& layerInstances)
+{
+	const size_t stride = m_height + 1;
+	size_t* starts = &_layerStarts[b * stride];
+	const size_t roomEnd = (size_t(b + 1) < _drawBatches.size()) ? _layerStarts[(b + 1) * stride] : _instances.size();
+
+	// Put together the new contents of the batch from its lowest changed layer, up to the first layer after the last
+	// changed one that stays where it is. Layers in between that didn't change are copied over from their old place.
+	const int fromY = layers.front();
+	std::vector<TileInstance> patched;
+	std::vector<size_t> newStarts;
+	int toY = fromY;
+	for (size_t l = 0; toY < int(m_height); ++toY)
+	{
+		if (l == layers.size() && starts[fromY] + patched.size() == starts[toY]) break;
+
+		newStarts.push_back(starts[fromY] + patched.size());
+		if (l < layers.size() && layers[l] == toY)
+		{
+			patched.insert(patched.end(), layerInstances[l].begin(), layerInstances[l].end());
+			++l;
+		}
+		else
+		{
+			patched.insert(patched.end(), _instances.begin() + starts[toY], _instances.begin() + starts[toY + 1]);
+		}
+	}
+
+	const size_t begin = starts[fromY];
+	const size_t oldEnd = starts[toY];
+	const size_t newEnd = begin + patched.size();
+	if (newEnd > roomEnd) return false;
+
+	for (int y = fromY; y < toY; ++y)
+	{
+		starts[y] = newStarts[y - fromY];
+	}
+	if (toY == int(m_height)) starts[m_height] = newEnd;
+
+	// Only the instances that differ from the ones already there need to be written and uploaded.
+	// If the batch didn't change size, then the instances that it ends with might not have moved either.
+	size_t same = 0, sameAtEnd = 0;
+	while (begin + same < std::min(oldEnd, newEnd) && _instances[begin + same] == patched[same]) ++same;
+	if (oldEnd == newEnd)
+	{
+		while (begin + same + sameAtEnd < newEnd && _instances[newEnd - 1 - sameAtEnd] == patched[patched.size() - 1 - sameAtEnd]) ++sameAtEnd;
+	}
+	std::copy(patched.begin() + same, patched.end() - sameAtEnd, _instances.begin() + begin + same);
+	_instanceBuffer.Invalidate(begin + same, newEnd - sameAtEnd);
+	return true;
+}
+
 void TileGrid::Draw(Vector3 position)
 {
 	Draw(position, 0, m_height - 1);
@@ -168,28 +508,44 @@ void TileGrid::Draw(Vector3 position, int fromY, int toY)
 {
 	if (!_mapMan) return;
 
-	if (GetApp()->IsPreviewing())
+	if (GetApp() && GetApp()->IsPreviewing())
 	{
 		DrawModel(GetModel(), position, 1.0f, Color::White);
 	}
 	else
 	{
-		if (_regenBatches || fromY != _batchFromY || toY != _batchToY || !Vector3Equals(position, _batchPosition))
+		if (_regenBatches)
+		{
+			_RegenBatches();
+		}
+		if (_instanceBuffer.NeedsUpload())
 		{
-			_RegenBatches(position, fromY, toY);
+			_instanceBuffer.Upload(_instances);
 		}
+		fromY = Max(fromY, 0);
+		toY = Min(toY, int(m_height) - 1);
 
 		RLMaterial tileMaterial = LoadMaterialDefault();
-		tileMaterial.shader = Assets::GetMapShader(true);
+		tileMaterial.shader = Assets::GetPackedMapShader();
 
 		//Call DrawMeshInstanced for each combination of material and mesh.
-		for (auto& [pair, matrices] : _drawBatches) 
+		const size_t stride = m_height + 1;
+		for (size_t b = 0; b < _drawBatches.size() && fromY <= toY; ++b)
 		{
+			// Only draw the instances belonging to the visible layers
+			size_t first = _layerStarts[b * stride + fromY];
+			size_t count = _layerStarts[b * stride + toY + 1] - first;
+			if (count == 0) continue;
+
+			// The mesh is looked up every time in case the model has been reloaded since the batch was made.
+			const RLModel& shape = _mapMan->ModelFromID(_drawBatches[b].shape);
+			if (_drawBatches[b].mesh >= shape.meshCount) continue;
+
 			//Reusing the same material for everything and just changing the albedo map between batches
-			RLTexture2D texture = _mapMan->TexFromID(pair.first);
+			RLTexture2D texture = _mapMan->TexFromID(_drawBatches[b].texture);
 			// std::cout << texture.id << std::endl;
 			SetMaterialTexture(&tileMaterial, MATERIAL_MAP_ALBEDO, texture);
-			DrawMeshInstanced(*pair.second, tileMaterial, matrices.data(), matrices.size());
+			DrawMeshInstancedPackedBuffer(shape.meshes[_drawBatches[b].mesh], tileMaterial, MatrixTranslate(position.x, position.y, position.z), m_spacing, _instanceBuffer.vboId, int(first), int(count));
 		}
 
 		//Free material w/o unloading its textures
@@ -197,13 +553,57 @@ void TileGrid::Draw(Vector3 position, int fromY, int toY)
 	}
 }
 
+void TileGrid::InstanceBuffer::Upload(const std::vector<TileInstance>& instances)
+{
+	const size_t size = instances.size() * sizeof(TileInstance);
+	if (vboId == 0 || size > capacity)
+	{
+		Unload();
+		// Leave some room to grow, so that placing a few more tiles doesn't need a new buffer.
+		capacity = std::max<size_t>(size + size / 2, 64 * sizeof(TileInstance));
+		vboId = rlLoadVertexBuffer(NULL, int(capacity), true);
+	}
+
+	if (outdated)
+	{
+		if (size > 0) rlUpdateVertexBuffer(vboId, instances.data(), int(size), 0);
+	}
+	else
+	{
+		// Send each run of overlapping ranges once
+		std::sort(dirtyRanges.begin(), dirtyRanges.end());
+		for (size_t r = 0; r < dirtyRanges.size();)
+		{
+			const size_t begin = dirtyRanges[r].first;
+			size_t end = dirtyRanges[r].second;
+			for (++r; r < dirtyRanges.size() && dirtyRanges[r].first <= end; ++r)
+			{
+				end = std::max(end, dirtyRanges[r].second);
+			}
+			rlUpdateVertexBuffer(vboId, instances.data() + begin, int((end - begin) * sizeof(TileInstance)), int(begin * sizeof(TileInstance)));
+		}
+	}
+	outdated = false;
+	dirtyRanges.clear();
+}
+
+void TileGrid::InstanceBuffer::Unload()
+{
+	if (vboId != 0) rlUnloadVertexBuffer(vboId);
+	vboId = 0;
+	capacity = 0;
+	outdated = true;
+	dirtyRanges.clear();
+}
+
 std::string TileGrid::GetTileDataBase64() const
 {
+	const size_t celCount = m_width * m_height * m_length;
 	std::vector<uint8_t> bin;
-	bin.reserve(m_grid.size() * sizeof(Tile));
-	for (size_t i = 0; i < m_grid.size(); ++i)
+	bin.reserve(celCount * sizeof(Tile));
+	for (size_t i = 0; i < celCount; ++i)
 	{
-		Tile savedTile = m_grid[i];
+		Tile savedTile = _palette[celAt(i)];
 
 		//Reinterpret each tile as a series of bytes and push them onto the vector.
 		const char* tileBin = reinterpret_cast<const char*>(&savedTile);
@@ -218,15 +618,16 @@ std::string TileGrid::GetTileDataBase64() const
 
 std::string TileGrid::GetOptimizedTileDataBase64() const
 {
+	const size_t celCount = m_width * m_height * m_length;
 	std::vector<uint8_t> bin;
-	bin.reserve(m_grid.size() * sizeof(Tile));
+	bin.reserve(celCount * sizeof(Tile));
 
 	int runLength = 0;
-	for (size_t i = 0; i < m_grid.size(); ++i)
+	for (size_t i = 0; i < celCount; ++i)
 	{
-		Tile savedTile = m_grid[i];
+		Tile savedTile = _palette[celAt(i)];
 
-		if (!savedTile && i < m_grid.size() - 1)
+		if (!savedTile && i < celCount - 1)
 		{
 			// Blank tiles (except for the last tile in the grid) are represented as runs.
 			++runLength;
@@ -271,13 +672,13 @@ void TileGrid::SetTileDataBase64(std::string data)
 			int j = 0;
 			for (j = 0; j < -loadedTile.shape; ++j)
 			{
-				m_grid[gridIndex + j] = Tile{ NO_MODEL, 0, NO_TEX, 0 };
+				setCel(gridIndex + j, PALETTE_EMPTY);
 			}
 			gridIndex += j;
 		}
 		else
 		{
-			m_grid[gridIndex] = loadedTile;
+			setCel(gridIndex, _GetPaletteID(loadedTile));
 			++gridIndex;
 		}
 	}
@@ -288,12 +689,18 @@ std::pair<std::vector<TexID>, std::vector<ModelID>> TileGrid::GetUsedIDs() const
 {
 	std::set<TexID> usedTexIDs;
 	std::set<ModelID> usedModelIDs;
-	for (const auto& tile : m_grid)
+	// Palette entries can outlive the tiles that use them, so only count the ones that are still referenced.
+	std::vector<bool> usedEntries(_palette.size(), false);
+	forEachCel(0, int(m_height) - 1, [&](size_t, PaletteID id)
+		{
+			usedEntries[id] = true;
+		});
+	for (size_t p = 0; p < _palette.size(); ++p)
 	{
-		if (tile)
+		if (usedEntries[p] && _palette[p])
 		{
-			usedTexIDs.insert(tile.texture);
-			usedModelIDs.insert(tile.shape);
+			usedTexIDs.insert(_palette[p].texture);
+			usedModelIDs.insert(_palette[p].shape);
 		}
 	}
 
@@ -303,187 +710,599 @@ std::pair<std::vector<TexID>, std::vector<ModelID>> TileGrid::GetUsedIDs() const
 		std::vector(usedModelIDs.begin(), usedModelIDs.end()));
 }
 
-RLModel* TileGrid::_GenerateModel(bool culling)
+// Grid offsets of the neighboring cel on each side of a cel, in the order +X, -X, +Y, -Y, +Z, -Z.
+// Opposite sides only differ in the lowest bit of their index.
+static const int CEL_SIDE_DIRECTIONS[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+
+// Returns the x, y or z component of the vector for an axis of 0, 1 or 2.
+static float AxisComponent(const Vector3& v, int axis)
+{
+	return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+size_t TileGrid::BoundaryFaceHash::operator()(const BoundaryFace& face) const
+{
+	size_t hash = 0;
+	for (int32_t c : face)
+	{
+		hash = (hash ^ std::hash<int32_t>()(c)) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+TileGrid::BoundarySignature TileGrid::_BuildBoundarySignature(ModelID shape, int orientation) const
+{
+	BoundarySignature signature;
+	const RLModel model = _mapMan->ModelFromID(shape);
+	const Assets::ModelHandle* handle = _mapMan->ModelHandleFromID(shape);
+	signature.triangleSides.resize(model.meshCount);
+	signature.triangleKeys.resize(model.meshCount);
+	signature.fullFaces.resize(model.meshCount);
+	for (int m = 0; m < model.meshCount; ++m)
+	{
+		const RLMesh& mesh = model.meshes[m];
+		if (mesh.indices == NULL) continue;
+		const Assets::ModelHandle::OrientedMesh& oriented = handle->GetOrientedMesh(orientation, m);
+		signature.triangleSides[m].assign(mesh.triangleCount, -1);
+		signature.triangleKeys[m].resize(mesh.triangleCount);
+		for (int t = 0; t < mesh.triangleCount; ++t)
+		{
+			// Find which side of the cel the triangle faces, if any
+			const Vector3 normal = Vector3{ oriented.planes[t].x, oriented.planes[t].y, oriented.planes[t].z };
+			int side = -1;
+			for (int s = 0; s < 6 && side < 0; ++s)
+			{
+				if (Vector3Equals(normal, Vector3{ float(CEL_SIDE_DIRECTIONS[s][0]), float(CEL_SIDE_DIRECTIONS[s][1]), float(CEL_SIDE_DIRECTIONS[s][2]) })) side = s;
+			}
+			if (side < 0) continue;
+
+			// The key is made of the vertices relative to the middle of that side, rounded and sorted.
+			// A face of the neighbor on that side gets the same key if it has the same vertices.
+			std::array<std::array<int32_t, 3>, 3> points;
+			for (int v = 0; v < 3; ++v)
+			{
+				const Vector3& pos = oriented.positions[mesh.indices[t * 3 + v]];
+				const float halfSpacing = m_spacing / 2.0f;
+				points[v][0] = int32_t(lroundf((pos.x - CEL_SIDE_DIRECTIONS[side][0] * halfSpacing) * BOUNDARY_FACE_PRECISION));
+				points[v][1] = int32_t(lroundf((pos.y - CEL_SIDE_DIRECTIONS[side][1] * halfSpacing) * BOUNDARY_FACE_PRECISION));
+				points[v][2] = int32_t(lroundf((pos.z - CEL_SIDE_DIRECTIONS[side][2] * halfSpacing) * BOUNDARY_FACE_PRECISION));
+			}
+			std::sort(points.begin(), points.end());
+
+			BoundaryFace& key = signature.triangleKeys[m][t];
+			for (int v = 0; v < 3; ++v)
+			{
+				for (int c = 0; c < 3; ++c) key[v * 3 + c] = points[v][c];
+			}
+			signature.triangleSides[m][t] = side;
+			signature.sides[side].insert(key);
+		}
+
+		// Look for sides that are covered by exactly two triangles forming a square over the whole side
+		if (mesh.texcoords == NULL || mesh.normals == NULL) continue;
+		auto nearlyEqual = [](float a, float b) { return fabsf(a - b) <= 1.0f / BOUNDARY_FACE_PRECISION; };
+		for (int side = 0; side < 6; ++side)
+		{
+			int triangles[2];
+			int triCount = 0;
+			for (int t = 0; t < mesh.triangleCount; ++t)
+			{
+				if (signature.triangleSides[m][t] != side) continue;
+				if (triCount < 2) triangles[triCount] = t;
+				++triCount;
+			}
+			if (triCount != 2) continue;
+
+			const int axis = side / 2;
+			const int uAxis = (axis == 0) ? 1 : 0;
+			const int vAxis = (axis == 2) ? 1 : 2;
+			const float halfSpacing = m_spacing / 2.0f;
+			const Vector3 sideNormal = Vector3{ float(CEL_SIDE_DIRECTIONS[side][0]), float(CEL_SIDE_DIRECTIONS[side][1]), float(CEL_SIDE_DIRECTIONS[side][2]) };
+
+			// Corners are numbered by (u > 0) | ((v > 0) << 1)
+			bool valid = true;
+			bool cornerFound[4] = { false, false, false, false };
+			Vector2 cornerUVs[4];
+			int missingCorner[2];
+			for (int i = 0; i < 2 && valid; ++i)
+			{
+				int cornerMask = 0;
+				for (int v = 0; v < 3 && valid; ++v)
+				{
+					const unsigned short index = mesh.indices[triangles[i] * 3 + v];
+					const Vector3& pos = oriented.positions[index];
+					const float n = AxisComponent(pos, axis) - CEL_SIDE_DIRECTIONS[side][axis] * halfSpacing;
+					const float u = AxisComponent(pos, uAxis);
+					const float w = AxisComponent(pos, vAxis);
+					if (!nearlyEqual(n, 0.0f) || !nearlyEqual(fabsf(u), halfSpacing) || !nearlyEqual(fabsf(w), halfSpacing)
+						|| !Vector3Equals(oriented.normals[index], sideNormal))
+					{
+						valid = false;
+						break;
+					}
+
+					const int corner = (u > 0.0f ? 1 : 0) | (w > 0.0f ? 2 : 0);
+					const Vector2 uv = Vector2{ mesh.texcoords[index * 2], mesh.texcoords[index * 2 + 1] };
+					if (cornerMask & (1 << corner)) valid = false; // Degenerate triangle
+					else if (cornerFound[corner] && !(nearlyEqual(cornerUVs[corner].x, uv.x) && nearlyEqual(cornerUVs[corner].y, uv.y))) valid = false; // Seam in the texture coordinates
+					cornerMask |= 1 << corner;
+					cornerFound[corner] = true;
+					cornerUVs[corner] = uv;
+				}
+				for (int c = 0; c < 4; ++c)
+				{
+					if (!(cornerMask & (1 << c))) missingCorner[i] = c;
+				}
+			}
+			// The triangles only cover the square without overlapping if they are missing opposite corners
+			if (!valid || (missingCorner[0] ^ missingCorner[1]) != 3) continue;
+
+			// The texture coordinates must change linearly across the face, by whole numbers so that they repeat seamlessly.
+			const Vector2 uvPerU = Vector2{ cornerUVs[1].x - cornerUVs[0].x, cornerUVs[1].y - cornerUVs[0].y };
+			const Vector2 uvPerV = Vector2{ cornerUVs[2].x - cornerUVs[0].x, cornerUVs[2].y - cornerUVs[0].y };
+			if (!nearlyEqual(cornerUVs[0].x + uvPerU.x + uvPerV.x, cornerUVs[3].x) || !nearlyEqual(cornerUVs[0].y + uvPerU.y + uvPerV.y, cornerUVs[3].y)) continue;
+			if (!nearlyEqual(uvPerU.x, roundf(uvPerU.x)) || !nearlyEqual(uvPerU.y, roundf(uvPerU.y))
+				|| !nearlyEqual(uvPerV.x, roundf(uvPerV.x)) || !nearlyEqual(uvPerV.y, roundf(uvPerV.y)))
+				continue;
+
+			FullFace& face = signature.fullFaces[m][side];
+			face.triangles[0] = triangles[0];
+			face.triangles[1] = triangles[1];
+			face.uv = cornerUVs[0];
+			face.uvPerU = Vector2{ roundf(uvPerU.x), roundf(uvPerU.y) };
+			face.uvPerV = Vector2{ roundf(uvPerV.x), roundf(uvPerV.y) };
+		}
+	}
+
+	// A side is covered by two triangles that split its square along either diagonal.
+	// Faces of the neighbor on that side are hidden even when they split it along the other one.
+	const int32_t half = int32_t(lroundf(m_spacing / 2.0f * BOUNDARY_FACE_PRECISION));
+	for (int side = 0; side < 6; ++side)
+	{
+		const int axis = side / 2;
+		const int uAxis = (axis == 0) ? 1 : 0;
+		const int vAxis = (axis == 2) ? 1 : 2;
+		auto hasTriangle = [&](std::initializer_list<int> corners)
+			{
+				std::array<std::array<int32_t, 3>, 3> points;
+				int v = 0;
+				for (int corner : corners)
+				{
+					points[v][axis] = 0;
+					points[v][uAxis] = (corner & 1) ? half : -half;
+					points[v][vAxis] = (corner & 2) ? half : -half;
+					++v;
+				}
+				std::sort(points.begin(), points.end());
+				BoundaryFace key;
+				for (int p = 0; p < 3; ++p)
+				{
+					for (int c = 0; c < 3; ++c) key[p * 3 + c] = points[p][c];
+				}
+				return signature.sides[side].count(key) > 0;
+			};
+		signature.coveredSides[side] = (hasTriangle({ 0, 1, 3 }) && hasTriangle({ 0, 2, 3 })) || (hasTriangle({ 1, 0, 2 }) && hasTriangle({ 1, 3, 2 }));
+	}
+	return signature;
+}
+
+RLModel* TileGrid::_GenerateModel(bool culling, bool greedy, bool weld, const std::function<bool(ModelID)>& shapeFilter, int chunkSize, std::vector<size_t>* meshChunks, size_t* weldedVertices)
 {
 	if (!_mapMan) return nullptr;
 
-	_RegenBatches(Vector3Zero(), 0, m_height - 1);
+	if (_regenBatches)
+	{
+		_RegenBatches();
+	}
+
+	// Geometry is sorted into buckets for each texture in each chunk. Without chunks, there is one bucket per texture.
+	const size_t numTextures = _mapMan->GetNumTextures();
+	const size_t numChunks = (chunkSize > 0) ? GetModelChunkCount(chunkSize) : 1;
+	auto bucketOf = [&](const TileInstance& instance, TexID texture)
+		{
+			return (chunkSize > 0 ? ModelChunkIndex(instance, chunkSize) : 0) * numTextures + texture;
+		};
 
 	// Collects vertex data for one of the model's meshes
-	// There is one mesh per texture in the model, which contains all of the geometry with said texture.
+	// Each bucket gets its own meshes, which contain all of the geometry with its texture in its chunk.
+	// A bucket's geometry is split into several meshes when it has too many vertices for 16-bit indices.
 	struct DynMesh
 	{
 		std::vector<float> positions;
 		std::vector<float> texCoords;
 		std::vector<float> normals;
 		std::vector<unsigned short> indices;
-		int triCount; // Independent form indices count since some models may not have indices
+		int triCount = 0; // Independent form indices count since some models may not have indices
+		size_t vertexCount = 0, indexCount = 0; // Space reserved for geometry before the arrays are filled in
 	};
 
-	DynMesh* meshMap = (DynMesh*)_alloca(_mapMan->GetNumTextures() * sizeof(DynMesh));
+	std::vector<std::vector<DynMesh>> meshMap(numTextures * numChunks);
+
+	// Where a piece of geometry goes in the meshes of its bucket
+	struct MeshPlacement
+	{
+		size_t bucket;
+		int mesh;
+		size_t vertexBase, indexBase;
+	};
 
-	for (int i = 0; i < _mapMan->GetNumTextures(); i++)
+	// Reserves space for geometry in the meshes of the bucket. A new mesh is started if `maxVertices` more vertices wouldn't fit in the current one.
+	auto placeGeometry = [&](size_t bucket, size_t maxVertices, size_t vertexCount, size_t indexCount) -> MeshPlacement
+		{
+			std::vector<DynMesh>& meshes = meshMap[bucket];
+			if (meshes.empty() || meshes.back().vertexCount + maxVertices > MODEL_MESH_MAX_VERTICES)
+			{
+				meshes.emplace_back();
+			}
+			DynMesh& mesh = meshes.back();
+			MeshPlacement placement = { bucket, int(meshes.size() - 1), mesh.vertexCount, mesh.indexCount };
+			mesh.vertexCount += vertexCount;
+			mesh.indexCount += indexCount;
+			return placement;
+		};
+
+	// Boundary signatures of the combinations of shape and orientation in the palette.
+	// They are all made up front, since the jobs below share them.
+	std::vector<BoundarySignature> signatures;
+	std::vector<const BoundarySignature*> paletteSignatures(_palette.size(), nullptr);
+	if (culling || greedy)
 	{
-		meshMap[i].positions = std::vector<float>();
-		meshMap[i].texCoords = std::vector<float>();
-		meshMap[i].normals = std::vector<float>();
-		meshMap[i].indices = std::vector<unsigned short>();
-		meshMap[i].triCount = 0;
+		std::map<std::pair<ModelID, int>, size_t> signatureLookup;
+		std::vector<std::pair<ModelID, int>> signatureKeys;
+		std::vector<size_t> paletteSignatureIndices(_palette.size(), 0);
+		for (size_t id = PALETTE_EMPTY + 1; id < _palette.size(); ++id)
+		{
+			const Tile& tile = _palette[id];
+			auto [iter, added] = signatureLookup.emplace(std::make_pair(tile.shape, TileOrientation(tile)), signatureKeys.size());
+			if (added) signatureKeys.push_back(iter->first);
+			paletteSignatureIndices[id] = iter->second;
+		}
+
+		signatures.resize(signatureKeys.size());
+		WorkerPool::ParallelFor(signatureKeys.size(), [&](size_t s)
+			{
+				signatures[s] = _BuildBoundarySignature(signatureKeys[s].first, signatureKeys[s].second);
+			});
+
+		for (size_t id = PALETTE_EMPTY + 1; id < _palette.size(); ++id)
+		{
+			paletteSignatures[id] = &signatures[paletteSignatureIndices[id]];
+		}
 	}
 
-	for (const auto& [pair, matrices] : _drawBatches)
+	// Returns true if the triangle is hidden by the tile on the side it faces.
+	auto isCulled = [&](const TileInstance& instance, const BoundarySignature& signature, int meshIndex, int tri)
+		{
+			// Only faces that point straight at a side of the cel can be hidden by the neighbor on that side.
+			const int side = signature.triangleSides[meshIndex][tri];
+			if (side < 0) return false;
+
+			int neighborX = (int)instance.x + CEL_SIDE_DIRECTIONS[side][0];
+			int neighborY = (int)instance.y + CEL_SIDE_DIRECTIONS[side][1];
+			int neighborZ = (int)instance.z + CEL_SIDE_DIRECTIONS[side][2];
+			if (neighborX < 0 || neighborY < 0 || neighborZ < 0 || neighborX >= m_width || neighborY >= m_height || neighborZ >= m_length)
+				return false;
+
+			PaletteID neighborID = celAt(neighborX, neighborY, neighborZ);
+			if (!_palette[neighborID])
+				return false;
+
+			// Cull if the neighbor has a face in the same spot, facing the other way, or if it covers that whole side and the triangle lies on it.
+			const BoundarySignature& nSignature = *paletteSignatures[neighborID];
+			const BoundaryFace& key = signature.triangleKeys[meshIndex][tri];
+			const int axis = side / 2;
+			if (nSignature.coveredSides[side ^ 1] && key[axis] == 0 && key[3 + axis] == 0 && key[6 + axis] == 0) return true;
+			return nSignature.sides[side ^ 1].count(key) > 0;
+		};
+
+	// Full faces set aside for greedy meshing, grouped by the plane they lie in and how they look.
+	// The key holds the bucket, the side, the plane's position along the side's axis (in cels), and the quantized texture coordinates.
+	// Since the bucket includes the chunk, faces are never merged across chunks.
+	typedef std::tuple<size_t, int, int, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t> GreedyPlaneKey;
+	struct GreedyFace
+	{
+		GreedyPlaneKey key;
+		FullFace face;
+		int u, v;
+	};
+	struct GreedyPlane
+	{
+		FullFace face;
+		std::vector<std::pair<int, int>> cels; // u and v coordinates of each face in the plane
+		std::vector<std::array<int, 4>> rects; // u, v, width and height of each rectangle the faces were merged into
+		std::vector<MeshPlacement> placements; // Where each rectangle goes
+	};
+	std::map<GreedyPlaneKey, GreedyPlane> greedyPlanes;
+
+	// A run of instances from one batch, whose geometry is generated on one of the worker threads.
+	// The results of all jobs are placed into the meshes in order, so the model is the same no matter how many threads there are.
+	struct GenerateJob
+	{
+		size_t batch;
+		size_t first, last; // Range of instances in _instances
+		std::vector<float> positions, texCoords, normals;
+		std::vector<unsigned short> indices; // Relative to the first vertex of the instance they belong to
+		std::vector<std::pair<uint32_t, uint32_t>> instanceSizes; // Number of vertices and indices added for each instance
+		std::vector<GreedyFace> fullFaces;
+		std::vector<MeshPlacement> placements; // Where each instance's geometry goes
+	};
+	std::vector<GenerateJob> jobs;
+	for (size_t b = 0; b < _drawBatches.size(); ++b)
 	{
-		RLMesh& shape = *pair.second;
-		DynMesh& mesh = meshMap[pair.first];
-		//Generate vertex data for this tile.
-		for (const Matrix& matrix : matrices)
+		if (shapeFilter && !shapeFilter(_drawBatches[b].shape)) continue;
+		const size_t begin = _layerStarts[b * (m_height + 1)];
+		const size_t end = _layerStarts[b * (m_height + 1) + m_height];
+		for (size_t first = begin; first < end; first += MODEL_JOB_INSTANCES)
 		{
-			// The index of the first vertex belonging to this shape.
-			int vBase = mesh.positions.size() / 3;
-			// Add vertex data
-			for (int v = 0; v < shape.vertexCount; v++)
+			GenerateJob& job = jobs.emplace_back();
+			job.batch = b;
+			job.first = first;
+			job.last = std::min(first + MODEL_JOB_INSTANCES, end);
+		}
+	}
+
+	// Generate the geometry of each job's instances
+	WorkerPool::ParallelFor(jobs.size(), [&](size_t j)
+		{
+			GenerateJob& job = jobs[j];
+			const RLModel& model = _mapMan->ModelFromID(_drawBatches[job.batch].shape);
+			const Assets::ModelHandle* handle = _mapMan->ModelHandleFromID(_drawBatches[job.batch].shape);
+			const int meshIndex = _drawBatches[job.batch].mesh;
+			if (meshIndex >= model.meshCount) return;
+			const RLMesh& shape = model.meshes[meshIndex];
+			if (shape.indices == NULL || shape.vertices == NULL) return;
+			const TexID texture = _drawBatches[job.batch].texture;
+
+			// Maps the vertices of the current tile's shape to their index in the tile's geometry, so that only used vertices are added.
+			std::vector<int> vertexRemap;
+
+			//Generate vertex data for this tile.
+			for (size_t i = job.first; i < job.last; ++i)
 			{
-				if (shape.vertices != NULL)
-				{
-					//RLTransform shape vertices into tile's orientation and position
-					Vector3 vec = Vector3{ shape.vertices[v * 3], shape.vertices[v * 3 + 1], shape.vertices[v * 3 + 2] };
-					vec = Vector3Transform(vec, matrix);
-					mesh.positions.push_back(vec.x);
-					mesh.positions.push_back(vec.y);
-					mesh.positions.push_back(vec.z);
-				}
+				const TileInstance& instance = _instances[i];
+				// The shape's geometry has already been rotated into each orientation, so it only needs to be moved into place.
+				const Assets::ModelHandle::OrientedMesh& oriented = handle->GetOrientedMesh(instance.orientation, meshIndex);
+				const Vector3 offset = GridToWorldPos(Vector3{ float(instance.x), float(instance.y), float(instance.z) }, true);
+				const BoundarySignature* signature = paletteSignatures[celAt(instance.x, instance.y, instance.z)];
+				const size_t firstVertex = job.positions.size() / 3;
+				const size_t firstIndex = job.indices.size();
+
+				vertexRemap.assign(shape.vertexCount, -1);
+				auto addVertex = [&](int v) -> unsigned short
+					{
+						if (vertexRemap[v] < 0)
+						{
+							vertexRemap[v] = job.positions.size() / 3 - firstVertex;
+							Vector3 vec = Vector3Add(oriented.positions[v], offset);
+							job.positions.push_back(vec.x);
+							job.positions.push_back(vec.y);
+							job.positions.push_back(vec.z);
+
+							// Missing attributes are filled with zeroes so that every array has one entry per vertex
+							const bool hasNormals = (shape.normals != NULL);
+							job.normals.push_back(hasNormals ? oriented.normals[v].x : 0.0f);
+							job.normals.push_back(hasNormals ? oriented.normals[v].y : 0.0f);
+							job.normals.push_back(hasNormals ? oriented.normals[v].z : 0.0f);
+
+							//Tex coordinates are just copied into the aggregate mesh
+							const bool hasTexCoords = (shape.texcoords != NULL);
+							job.texCoords.push_back(hasTexCoords ? shape.texcoords[v * 2] : 0.0f);
+							job.texCoords.push_back(hasTexCoords ? shape.texcoords[v * 2 + 1] : 0.0f);
+						}
+						return (unsigned short)vertexRemap[v];
+					};
+				// Adds the indices of triangle `tri`, relative to the current tile's vertices for now.
+				auto addTriangle = [&](int tri)
+					{
+						job.indices.push_back(addVertex(shape.indices[tri * 3 + 0]));
+						job.indices.push_back(addVertex(shape.indices[tri * 3 + 1]));
+						job.indices.push_back(addVertex(shape.indices[tri * 3 + 2]));
+					};
 
-				if (shape.normals != NULL)
+				// Add face data
+				for (int tri = 0; tri < shape.triangleCount; ++tri)
 				{
-					//RLTransform normals by the tile's rotation, but not its position
-					Matrix rotMatrix = matrix;
-					rotMatrix.m12 = 0.0f;
-					rotMatrix.m13 = 0.0f;
-					rotMatrix.m14 = 0.0f;
-
-					Vector3 norm = Vector3{ shape.normals[v * 3], shape.normals[v * 3 + 1], shape.normals[v * 3 + 2] };
-					norm = Vector3Transform(norm, rotMatrix);
-					mesh.normals.push_back(norm.x);
-					mesh.normals.push_back(norm.y);
-					mesh.normals.push_back(norm.z);
-				}
+					const int side = signature ? signature->triangleSides[meshIndex][tri] : -1;
+					if (greedy && side >= 0 && signature->fullFaces[meshIndex][side].triangles[0] >= 0)
+					{
+						// Full faces are merged with their neighbors later, unless only one of their triangles is visible.
+						// The face's triangles are the only ones on its side.
+						const FullFace& face = signature->fullFaces[meshIndex][side];
+						const bool culled0 = culling && isCulled(instance, *signature, meshIndex, face.triangles[0]);
+						const bool culled1 = culling && isCulled(instance, *signature, meshIndex, face.triangles[1]);
+						if (culled0 != culled1)
+						{
+							if (!(tri == face.triangles[0] ? culled0 : culled1)) addTriangle(tri);
+							continue;
+						}
+						if (tri != face.triangles[0] || culled0) continue;
+
+						const int axis = side / 2;
+						const int cel[3] = { instance.x, instance.y, instance.z };
+						const int layer = cel[axis] + (CEL_SIDE_DIRECTIONS[side][axis] > 0 ? 1 : 0);
+						const GreedyPlaneKey key = { bucketOf(instance, texture), side, layer,
+							int32_t(lroundf(face.uv.x * BOUNDARY_FACE_PRECISION)), int32_t(lroundf(face.uv.y * BOUNDARY_FACE_PRECISION)),
+							int32_t(face.uvPerU.x), int32_t(face.uvPerU.y), int32_t(face.uvPerV.x), int32_t(face.uvPerV.y) };
+						job.fullFaces.push_back(GreedyFace{ key, face, cel[(axis == 0) ? 1 : 0], cel[(axis == 2) ? 1 : 2] });
+						continue;
+					}
 
-				if (shape.texcoords != NULL)
-				{
-					//Tex coordinates are just copied into the aggregate mesh
-					mesh.texCoords.push_back(shape.texcoords[v * 2]);
-					mesh.texCoords.push_back(shape.texcoords[v * 2 + 1]);
+					// Do face culling
+					if (culling && isCulled(instance, *signature, meshIndex, tri)) continue;
+
+					addTriangle(tri);
 				}
+
+				job.instanceSizes.push_back({ uint32_t(job.positions.size() / 3 - firstVertex), uint32_t(job.indices.size() - firstIndex) });
+			}
+		});
+
+	// Gather the full faces into their planes, in the same order they would have been found in by one thread
+	for (const GenerateJob& job : jobs)
+	{
+		for (const GreedyFace& face : job.fullFaces)
+		{
+			GreedyPlane& plane = greedyPlanes[face.key];
+			plane.face = face.face;
+			plane.cels.push_back({ face.u, face.v });
+		}
+	}
+
+	// Merge the faces in each plane into as few rectangles as possible, by growing each rectangle along u and then along v.
+	std::vector<std::pair<const GreedyPlaneKey*, GreedyPlane*>> planeList;
+	planeList.reserve(greedyPlanes.size());
+	for (auto& [key, plane] : greedyPlanes)
+	{
+		planeList.push_back({ &key, &plane });
+	}
+	WorkerPool::ParallelFor(planeList.size(), [&](size_t p)
+		{
+			GreedyPlane& plane = *planeList[p].second;
+
+			int minU = INT_MAX, minV = INT_MAX, maxU = INT_MIN, maxV = INT_MIN;
+			for (const auto& [u, v] : plane.cels)
+			{
+				minU = Min(minU, u); maxU = Max(maxU, u);
+				minV = Min(minV, v); maxV = Max(maxV, v);
 			}
-			// Add face data
-			if (shape.indices != NULL)
+			const int sizeU = maxU - minU + 1;
+			const int sizeV = maxV - minV + 1;
+			std::vector<bool> mask(size_t(sizeU) * sizeV, false);
+			for (const auto& [u, v] : plane.cels)
 			{
-				for (int tri = 0; tri < shape.triangleCount; ++tri)
+				mask[size_t(v - minV) * sizeU + (u - minU)] = true;
+			}
+
+			for (int v = 0; v < sizeV; ++v)
+			{
+				for (int u = 0; u < sizeU; ++u)
 				{
-					// Vertex indices
-					unsigned short v0Index = (unsigned short)(vBase + shape.indices[tri * 3 + 0]);
-					unsigned short v1Index = (unsigned short)(vBase + shape.indices[tri * 3 + 1]);
-					unsigned short v2Index = (unsigned short)(vBase + shape.indices[tri * 3 + 2]);
+					if (!mask[size_t(v) * sizeU + u]) continue;
 
-					// Do face culling
-					if (culling)
+					int width = 1;
+					while (u + width < sizeU && mask[size_t(v) * sizeU + u + width]) ++width;
+					int height = 1;
+					for (bool canGrow = true; canGrow && v + height < sizeV; )
 					{
-						// Vertices
-						Vector3 v0 = Vector3{ mesh.positions[v0Index * 3 + 0], mesh.positions[v0Index * 3 + 1], mesh.positions[v0Index * 3 + 2] };
-						Vector3 v1 = Vector3{ mesh.positions[v1Index * 3 + 0], mesh.positions[v1Index * 3 + 1], mesh.positions[v1Index * 3 + 2] };
-						Vector3 v2 = Vector3{ mesh.positions[v2Index * 3 + 0], mesh.positions[v2Index * 3 + 1], mesh.positions[v2Index * 3 + 2] };
-
-						// Figure out if this triangle is near the border of the grid cel so it can be culled
-						Vector3 planeNormal = Vector3CrossProduct(
-							Vector3Subtract(v1, v0),
-							Vector3Subtract(v2, v0)
-						);
-						planeNormal = Vector3Normalize(planeNormal);
-
-						float planeDistance = -Vector3DotProduct(planeNormal, v0);
-
-						Vector3 tileGridPosition = WorldToGridPos(Vector3{ matrix.m12, matrix.m13, matrix.m14 });
-
-						// Determine the direction of the tile neighboring this face
-						int neighborX = (int)tileGridPosition.x;
-						int neighborY = (int)tileGridPosition.y;
-						int neighborZ = (int)tileGridPosition.z;
-						if (Vector3Equals(planeNormal, Vector3{ +1.0f,  0.0f,  0.0f })) neighborX += 1;
-						else if (Vector3Equals(planeNormal, Vector3{ -1.0f,  0.0f,  0.0f })) neighborX -= 1;
-						else if (Vector3Equals(planeNormal, Vector3{ 0.0f,  0.0f, -1.0f })) neighborZ -= 1;
-						else if (Vector3Equals(planeNormal, Vector3{ 0.0f,  0.0f, +1.0f })) neighborZ += 1;
-						else if (Vector3Equals(planeNormal, Vector3{ 0.0f, +1.0f,  0.0f })) neighborY += 1;
-						else if (Vector3Equals(planeNormal, Vector3{ 0.0f, -1.0f,  0.0f })) neighborY -= 1;
-						else goto nocull;
-
-						// Look at the neighboring tile's faces to determine whether to cull this triangle or not.
-						if (neighborX >= 0 && neighborY >= 0 && neighborZ >= 0 && neighborX < m_width && neighborY < m_height && neighborZ < m_length)
+						for (int x = u; x < u + width && canGrow; ++x)
 						{
-							Tile neighborTile = GetTile(neighborX, neighborY, neighborZ);
-							if (!neighborTile)
-								goto nocull;
-
-							Vector3 nWorldPos = GridToWorldPos(Vector3{ (float)neighborX, (float)neighborY, (float)neighborZ }, true);
-							Matrix nRotMatrix = TileRotationMatrix(neighborTile);
-							Matrix nMatrix = MatrixMultiply(nRotMatrix, MatrixTranslate(nWorldPos.x, nWorldPos.y, nWorldPos.z));
-
-							RLModel neighborModel = _mapMan->ModelFromID(neighborTile.shape);
-							for (int nm = 0; nm < neighborModel.meshCount; ++nm)
-							{
-								RLMesh neighborMesh = neighborModel.meshes[nm];
-								for (int nt = 0; nt < neighborMesh.triangleCount; ++nt)
-								{
-									// Indices
-									unsigned short nV0Index = neighborMesh.indices[nt * 3 + 0];
-									unsigned short nV1Index = neighborMesh.indices[nt * 3 + 1];
-									unsigned short nV2Index = neighborMesh.indices[nt * 3 + 2];
-
-									// Vertices
-									Vector3 nV0 = Vector3{ neighborMesh.vertices[nV0Index * 3 + 0], neighborMesh.vertices[nV0Index * 3 + 1], neighborMesh.vertices[nV0Index * 3 + 2] };
-									nV0 = Vector3Transform(nV0, nMatrix);
-									Vector3 nV1 = Vector3{ neighborMesh.vertices[nV1Index * 3 + 0], neighborMesh.vertices[nV1Index * 3 + 1], neighborMesh.vertices[nV1Index * 3 + 2] };
-									nV1 = Vector3Transform(nV1, nMatrix);
-									Vector3 nV2 = Vector3{ neighborMesh.vertices[nV2Index * 3 + 0], neighborMesh.vertices[nV2Index * 3 + 1], neighborMesh.vertices[nV2Index * 3 + 2] };
-									nV2 = Vector3Transform(nV2, nMatrix);
-
-									// Get neighbor's plane
-									Vector3 nPlaneNormal = Vector3CrossProduct(
-										Vector3Subtract(nV1, nV0),
-										Vector3Subtract(nV2, nV0)
-									);
-									nPlaneNormal = Vector3Normalize(nPlaneNormal);
-
-									float nPlaneDistance = -Vector3DotProduct(nPlaneNormal, nV0);
-
-									// If the plane of the cullable triangle and the plane of the neighbor's triangle are in the same spot but opposite directions...
-									if (FloatEquals(fabs(nPlaneDistance), fabs(planeDistance)) && FloatEquals(Vector3DotProduct(nPlaneNormal, planeNormal), -1.0f))
-									{
-										// Cull if all of the checked triangle's points correspond one of the neighbor's.
-										if (
-											(Vector3Equals(v0, nV0) || Vector3Equals(v0, nV1) || Vector3Equals(v0, nV2)) &&
-											(Vector3Equals(v1, nV0) || Vector3Equals(v1, nV1) || Vector3Equals(v1, nV2)) &&
-											(Vector3Equals(v2, nV0) || Vector3Equals(v2, nV1) || Vector3Equals(v2, nV2)))
-										{
-											goto cull;
-										}
-									}
-								}
-							}
+							canGrow = mask[size_t(v + height) * sizeU + x];
 						}
+						if (canGrow) ++height;
 					}
-
-				nocull:
-					// Add indices, but with the offset of the current tile's vertices.
-					mesh.indices.push_back(v0Index);
-					mesh.indices.push_back(v1Index);
-					mesh.indices.push_back(v2Index);
-					++mesh.triCount;
-				cull:
-					continue;
+					for (int y = v; y < v + height; ++y)
+					{
+						for (int x = u; x < u + width; ++x)
+						{
+							mask[size_t(y) * sizeU + x] = false;
+						}
+					}
+					plane.rects.push_back({ minU + u, minV + v, width, height });
 				}
 			}
+		});
+
+	// Decide where all of the geometry goes. This is the only part that has to happen in order,
+	// and it only adds up sizes, so that the geometry itself can be copied in parallel.
+	for (GenerateJob& job : jobs)
+	{
+		const RLModel& model = _mapMan->ModelFromID(_drawBatches[job.batch].shape);
+		const int meshIndex = _drawBatches[job.batch].mesh;
+		const size_t maxVertices = (meshIndex < model.meshCount) ? model.meshes[meshIndex].vertexCount : 0;
+		job.placements.reserve(job.instanceSizes.size());
+		for (size_t i = 0; i < job.instanceSizes.size(); ++i)
+		{
+			const auto [vertexCount, indexCount] = job.instanceSizes[i];
+			job.placements.push_back(placeGeometry(bucketOf(_instances[job.first + i], _drawBatches[job.batch].texture), maxVertices, vertexCount, indexCount));
+		}
+	}
+	for (auto& [key, plane] : greedyPlanes)
+	{
+		plane.placements.reserve(plane.rects.size());
+		for (size_t r = 0; r < plane.rects.size(); ++r)
+		{
+			plane.placements.push_back(placeGeometry(std::get<0>(key), 4, 4, 6));
 		}
 	}
+	for (std::vector<DynMesh>& meshes : meshMap)
+	{
+		for (DynMesh& mesh : meshes)
+		{
+			mesh.positions.resize(mesh.vertexCount * 3);
+			mesh.normals.resize(mesh.vertexCount * 3);
+			mesh.texCoords.resize(mesh.vertexCount * 2);
+			mesh.indices.resize(mesh.indexCount);
+			mesh.triCount = int(mesh.indexCount / 3);
+		}
+	}
+
+	// Copy the jobs' geometry and the merged rectangles into their places in the meshes
+	WorkerPool::ParallelFor(jobs.size() + planeList.size(), [&](size_t n)
+		{
+			if (n < jobs.size())
+			{
+				const GenerateJob& job = jobs[n];
+				size_t vertexCursor = 0, indexCursor = 0;
+				for (size_t i = 0; i < job.instanceSizes.size(); ++i)
+				{
+					const auto [vertexCount, indexCount] = job.instanceSizes[i];
+					const MeshPlacement& placement = job.placements[i];
+					DynMesh& mesh = meshMap[placement.bucket][placement.mesh];
+					std::copy_n(job.positions.data() + vertexCursor * 3, vertexCount * 3, mesh.positions.data() + placement.vertexBase * 3);
+					std::copy_n(job.normals.data() + vertexCursor * 3, vertexCount * 3, mesh.normals.data() + placement.vertexBase * 3);
+					std::copy_n(job.texCoords.data() + vertexCursor * 2, vertexCount * 2, mesh.texCoords.data() + placement.vertexBase * 2);
+					for (size_t idx = 0; idx < indexCount; ++idx)
+					{
+						// Add the offset of the tile's first vertex to its indices
+						mesh.indices[placement.indexBase + idx] = (unsigned short)(placement.vertexBase + job.indices[indexCursor + idx]);
+					}
+					vertexCursor += vertexCount;
+					indexCursor += indexCount;
+				}
+				return;
+			}
+
+			const GreedyPlaneKey& key = *planeList[n - jobs.size()].first;
+			const GreedyPlane& plane = *planeList[n - jobs.size()].second;
+			const int side = std::get<1>(key);
+			const int layer = std::get<2>(key);
+			const int axis = side / 2;
+			const int uAxis = (axis == 0) ? 1 : 0;
+			const int vAxis = (axis == 2) ? 1 : 2;
+			std::vector<DynMesh>& meshes = meshMap[std::get<0>(key)];
+
+			const Vector3 normal = Vector3{ float(CEL_SIDE_DIRECTIONS[side][0]), float(CEL_SIDE_DIRECTIONS[side][1]), float(CEL_SIDE_DIRECTIONS[side][2]) };
+			// Whether going around the corners in the order (u, v), (u + 1, v), (u + 1, v + 1) faces along the normal.
+			const bool frontFacing = (axis != 1) == (CEL_SIDE_DIRECTIONS[side][axis] > 0);
+			const int order[2][6] = { { 0, 1, 3, 0, 3, 2 }, { 0, 3, 1, 0, 2, 3 } };
+
+			for (size_t r = 0; r < plane.rects.size(); ++r)
+			{
+				const auto [u, v, width, height] = plane.rects[r];
+				const MeshPlacement& placement = plane.placements[r];
+				DynMesh& mesh = meshes[placement.mesh];
+
+				// Add the corners of the rectangle, with texture coordinates that repeat once per cel.
+				for (int c = 0; c < 4; ++c)
+				{
+					const int cu = (c & 1) ? width : 0;
+					const int cv = (c & 2) ? height : 0;
+					const size_t vertex = placement.vertexBase + c;
+					mesh.positions[vertex * 3 + axis] = layer * m_spacing;
+					mesh.positions[vertex * 3 + uAxis] = (u + cu) * m_spacing;
+					mesh.positions[vertex * 3 + vAxis] = (v + cv) * m_spacing;
+					mesh.normals[vertex * 3 + 0] = normal.x;
+					mesh.normals[vertex * 3 + 1] = normal.y;
+					mesh.normals[vertex * 3 + 2] = normal.z;
+					mesh.texCoords[vertex * 2 + 0] = plane.face.uv.x + plane.face.uvPerU.x * cu + plane.face.uvPerV.x * cv;
+					mesh.texCoords[vertex * 2 + 1] = plane.face.uv.y + plane.face.uvPerU.y * cu + plane.face.uvPerV.y * cv;
+				}
+				for (int idx = 0; idx < 6; ++idx)
+				{
+					mesh.indices[placement.indexBase + idx] = (unsigned short)(placement.vertexBase + order[frontFacing ? 0 : 1][idx]);
+				}
+			}
+		});
 
 	// Create Raylib mesh
 	RLModel* model = SAFE_MALLOC(RLModel, 1);
@@ -491,9 +1310,12 @@ RLModel* TileGrid::_GenerateModel(bool culling)
 	// Count the number of meshes (that aren't empty.)
 	int numMeshes = 0;
 	// We don't want to include any empty meshes, because that will cause an error in certain .gltf parsers.
-	for (int i = 0; i < _mapMan->GetNumTextures(); ++i)
+	for (const std::vector<DynMesh>& meshes : meshMap)
 	{
-		if (meshMap[i].triCount > 0) ++numMeshes;
+		for (const DynMesh& dMesh : meshes)
+		{
+			if (dMesh.triCount > 0) ++numMeshes;
+		}
 	}
 
 	model->materialCount = _mapMan->GetNumTextures();
@@ -512,46 +1334,58 @@ RLModel* TileGrid::_GenerateModel(bool culling)
 	for (int m = 0; m < model->materialCount; ++m)
 	{
 		model->materials[m] = LoadMaterialDefault();
-		model->materials[m].shader = Assets::GetMapShader(false);
 		model->materials[m].maps[MATERIAL_MAP_ALBEDO].texture = _mapMan->TexFromID(m);
 	}
 
-	// Copy mesh data into Raylib mesh
-	for (int i = 0, meshIndex = 0; i < model->materialCount; ++i)
+	// Copy mesh data into Raylib mesh. Meshes with the same texture (in the same chunk) stay next to each other.
+	if (meshChunks) meshChunks->clear();
+	int meshIndex = 0;
+	for (size_t bucket = 0; bucket < meshMap.size(); ++bucket)
 	{
-		DynMesh* dMesh = &meshMap[i];
-		if (dMesh->triCount <= 0) continue;
+		for (DynMesh& dynMesh : meshMap[bucket])
+		{
+			DynMesh* dMesh = &dynMesh;
+			if (dMesh->triCount <= 0) continue;
 
-		model->meshMaterial[meshIndex] = i;
+			model->meshMaterial[meshIndex] = int(bucket % numTextures);
+			if (meshChunks) meshChunks->push_back(bucket / numTextures);
 
-		model->meshes[meshIndex] = RLMesh{ 0 };
-		model->meshes[meshIndex].vertexCount = dMesh->positions.size() / 3;
-		model->meshes[meshIndex].triangleCount = dMesh->triCount;
+			model->meshes[meshIndex] = RLMesh{ 0 };
+			model->meshes[meshIndex].vertexCount = dMesh->positions.size() / 3;
+			model->meshes[meshIndex].triangleCount = dMesh->triCount;
 
-		if (dMesh->positions.size() > 0)
-		{
-			model->meshes[meshIndex].vertices = SAFE_MALLOC(float, dMesh->positions.size());
-			memcpy(model->meshes[meshIndex].vertices, dMesh->positions.data(), dMesh->positions.size() * sizeof(float));
-		}
-		if (dMesh->texCoords.size() > 0)
-		{
-			model->meshes[meshIndex].texcoords = SAFE_MALLOC(float, dMesh->texCoords.size());
-			memcpy(model->meshes[meshIndex].texcoords, dMesh->texCoords.data(), dMesh->texCoords.size() * sizeof(float));
-		}
-		if (dMesh->normals.size() > 0)
-		{
-			model->meshes[meshIndex].normals = SAFE_MALLOC(float, dMesh->normals.size());
-			memcpy(model->meshes[meshIndex].normals, dMesh->normals.data(), dMesh->normals.size() * sizeof(float));
-		}
-		if (dMesh->indices.size() > 0)
-		{
-			model->meshes[meshIndex].indices = SAFE_MALLOC(unsigned short, dMesh->indices.size());
-			memcpy(model->meshes[meshIndex].indices, dMesh->indices.data(), dMesh->indices.size() * sizeof(unsigned short));
-		}
+			if (dMesh->positions.size() > 0)
+			{
+				model->meshes[meshIndex].vertices = SAFE_MALLOC(float, dMesh->positions.size());
+				memcpy(model->meshes[meshIndex].vertices, dMesh->positions.data(), dMesh->positions.size() * sizeof(float));
+			}
+			if (dMesh->texCoords.size() > 0)
+			{
+				model->meshes[meshIndex].texcoords = SAFE_MALLOC(float, dMesh->texCoords.size());
+				memcpy(model->meshes[meshIndex].texcoords, dMesh->texCoords.data(), dMesh->texCoords.size() * sizeof(float));
+			}
+			if (dMesh->normals.size() > 0)
+			{
+				model->meshes[meshIndex].normals = SAFE_MALLOC(float, dMesh->normals.size());
+				memcpy(model->meshes[meshIndex].normals, dMesh->normals.data(), dMesh->normals.size() * sizeof(float));
+			}
+			if (dMesh->indices.size() > 0)
+			{
+				model->meshes[meshIndex].indices = SAFE_MALLOC(unsigned short, dMesh->indices.size());
+				memcpy(model->meshes[meshIndex].indices, dMesh->indices.data(), dMesh->indices.size() * sizeof(unsigned short));
+			}
 
-		UploadMesh(&model->meshes[meshIndex], false);
+			++meshIndex;
+		}
+	}
 
-		++meshIndex;
+	// Merge duplicate vertices, such as the corners that neighboring tiles share
+	if (weldedVertices) *weldedVertices = 0;
+	if (weld)
+	{
+		std::vector<int> removed(model->meshCount, 0);
+		WorkerPool::ParallelFor(model->meshCount, [&](size_t m) { removed[m] = WeldMeshVertices(model->meshes[m]); });
+		if (weldedVertices) *weldedVertices = std::accumulate(removed.begin(), removed.end(), size_t(0));
 	}
 
 	return model;
@@ -561,16 +1395,199 @@ const RLModel TileGrid::GetModel()
 {
 	if (!_mapMan) return RLModel{};
 	bool newCull = GetApp()->IsCullingEnabled();
-	if (_regenModel || _model == nullptr || newCull != _modelCulled)
+	bool newGreedy = GetApp()->IsGreedyMeshingEnabled();
+	bool newWeld = GetApp()->IsVertexWeldingEnabled();
+	if (_regenModel || _model == nullptr || newCull != _modelCulled || newGreedy != _modelGreedy || newWeld != _modelWelded)
 	{
 		if (_model != nullptr)
 		{
 			UnloadModel(*_model);
 		}
 		_modelCulled = newCull;
-		_model = _GenerateModel(_modelCulled);
+		_modelGreedy = newGreedy;
+		_modelWelded = newWeld;
+		_model = _GenerateModel(_modelCulled, _modelGreedy, _modelWelded);
 		_regenModel = false;
+
+		// Only the preview is drawn, so it is the only model that goes to the GPU.
+		for (int m = 0; m < _model->materialCount; ++m)
+		{
+			_model->materials[m].shader = Assets::GetMapShader(false);
+		}
+		for (int m = 0; m < _model->meshCount; ++m)
+		{
+			UploadMesh(&_model->meshes[m], false);
+		}
 	}
 
 	return *_model;
+}
+
+RLModel TileGrid::GenerateModel(bool culling, bool greedy, bool weld, const std::function<bool(ModelID)>& shapeFilter, int chunkSize, std::vector<size_t>* meshChunks,
+	size_t* weldedVertices)
+{
+	if (!_mapMan) return RLModel{};
+	RLModel* generated = _GenerateModel(culling, greedy, weld, shapeFilter, chunkSize, meshChunks, weldedVertices);
+	RLModel model = *generated;
+	free(generated);
+	return model;
+}
+
+size_t TileGrid::GetModelChunkCount(int chunkSize) const
+{
+	const std::array<int, 3> counts = GetModelChunkCounts(chunkSize);
+	return size_t(counts[0]) * counts[1] * counts[2];
+}
+
+std::array<int, 3> TileGrid::GetModelChunkCounts(int chunkSize) const
+{
+	return { (int(m_width) + chunkSize - 1) / chunkSize, (int(m_height) + chunkSize - 1) / chunkSize, (int(m_length) + chunkSize - 1) / chunkSize };
+}
+
+size_t TileGrid::ModelChunkIndex(const TileInstance& instance, int chunkSize) const
+{
+	const std::array<int, 3> counts = GetModelChunkCounts(chunkSize);
+	return (size_t(instance.y / chunkSize) * counts[2] + (instance.z / chunkSize)) * counts[0] + (instance.x / chunkSize);
+}
+
+std::vector<TileGrid::TileBatch> TileGrid::GetTileBatches()
+{
+	std::vector<TileBatch> batches;
+	if (!_mapMan) return batches;
+
+	_RegenBatches();
+
+	// Every mesh of a shape has its own batch with the same instances, so only the first mesh's batches are used.
+	for (size_t b = 0; b < _drawBatches.size(); ++b)
+	{
+		if (_drawBatches[b].mesh != 0) continue;
+		const size_t begin = _layerStarts[b * (m_height + 1)];
+		const size_t end = _layerStarts[b * (m_height + 1) + m_height];
+		if (begin == end) continue;
+		batches.push_back(TileBatch{ _drawBatches[b].texture, _drawBatches[b].shape,
+			std::vector<TileInstance>(_instances.begin() + begin, _instances.begin() + end) });
+	}
+	return batches;
+}
+
+bool TileGrid::IsCubeShape(ModelID shape) const
+{
+	if (!_mapMan) return false;
+	const BoundarySignature signature = _BuildBoundarySignature(shape, 0);
+	for (int side = 0; side < 6; ++side)
+	{
+		bool covered = false;
+		for (const std::array<FullFace, 6>& meshFaces : signature.fullFaces)
+		{
+			if (meshFaces[side].triangles[0] >= 0) covered = true;
+		}
+		if (!covered) return false;
+	}
+	return true;
+}
+
+std::vector<uint8_t> TileGrid::GetCubeCels() const
+{
+	std::vector<uint8_t> cubeCels(m_width * m_height * m_length, 0);
+	if (!_mapMan) return cubeCels;
+
+	const std::vector<uint8_t> cubeTiles = _GetCubePaletteEntries();
+	WorkerPool::ParallelFor(m_height, [&](size_t j)
+		{
+			for (size_t k = 0; k < m_length; ++k)
+			{
+				for (size_t i = 0; i < m_width; ++i)
+				{
+					cubeCels[FlatIndex(int(i), int(j), int(k))] = cubeTiles[celAt(int(i), int(j), int(k))];
+				}
+			}
+		});
+	return cubeCels;
+}
+
+std::vector<uint8_t> TileGrid::_GetCubePaletteEntries() const
+{
+	// Each shape is only checked once, instead of for every tile
+	std::vector<uint8_t> cubeTiles(_palette.size(), 0);
+	std::map<ModelID, bool> cubeShapes;
+	for (size_t p = 0; p < _palette.size(); ++p)
+	{
+		if (p == PALETTE_EMPTY) continue;
+		auto [iter, added] = cubeShapes.emplace(_palette[p].shape, false);
+		if (added) iter->second = IsCubeShape(_palette[p].shape);
+		cubeTiles[p] = iter->second;
+	}
+	return cubeTiles;
+}
+
+TileGrid TileGrid::Downsample(int factor) const
+{
+	TileGrid coarseGrid(_mapMan, (m_width + factor - 1) / factor, (m_height + factor - 1) / factor, (m_length + factor - 1) / factor,
+		m_spacing, Tile(), GridStorage::CHUNKED);
+	const std::vector<uint8_t> cubeTiles = _mapMan ? _GetCubePaletteEntries() : std::vector<uint8_t>(_palette.size(), 0);
+
+	// Votes for each distinct tile and texture in the current block
+	std::vector<std::pair<PaletteID, int>> tileVotes;
+	std::vector<std::pair<TexID, int>> textureVotes;
+	auto vote = [](auto& votes, auto value)
+		{
+			for (auto& [candidate, count] : votes)
+			{
+				if (candidate == value)
+				{
+					++count;
+					return;
+				}
+			}
+			votes.push_back({ value, 1 });
+		};
+
+	for (int cj = 0; cj < int(coarseGrid.m_height); ++cj)
+	{
+		for (int ck = 0; ck < int(coarseGrid.m_length); ++ck)
+		{
+			for (int ci = 0; ci < int(coarseGrid.m_width); ++ci)
+			{
+				tileVotes.clear();
+				textureVotes.clear();
+				int cels = 0, filled = 0;
+				for (int j = cj * factor; j < Min((cj + 1) * factor, int(m_height)); ++j)
+				{
+					for (int k = ck * factor; k < Min((ck + 1) * factor, int(m_length)); ++k)
+					{
+						for (int i = ci * factor; i < Min((ci + 1) * factor, int(m_width)); ++i)
+						{
+							++cels;
+							const PaletteID id = celAt(i, j, k);
+							if (id == PALETTE_EMPTY) continue;
+							++filled;
+							vote(tileVotes, id);
+							vote(textureVotes, _palette[id].texture);
+						}
+					}
+				}
+				// Ties are filled, so that walls and floors one cel thick survive the first level. They still disappear from coarser ones,
+				// where a single layer is less than half of a block.
+				if (filled * 2 < cels) continue;
+
+				// Cube tiles win over other shapes, so that solid walls stay closed
+				std::pair<PaletteID, int> bestTile = tileVotes[0];
+				for (const auto& candidate : tileVotes)
+				{
+					const bool better = (cubeTiles[candidate.first] != cubeTiles[bestTile.first]) ? cubeTiles[candidate.first] != 0 : candidate.second > bestTile.second;
+					if (better) bestTile = candidate;
+				}
+				std::pair<TexID, int> bestTexture = textureVotes[0];
+				for (const auto& candidate : textureVotes)
+				{
+					if (candidate.second > bestTexture.second) bestTexture = candidate;
+				}
+
+				Tile tile = _palette[bestTile.first];
+				tile.texture = bestTexture.first;
+				coarseGrid.SetTile(ci, cj, ck, tile);
+			}
+		}
+	}
+	return coarseGrid;
 }
\ No newline at end of file
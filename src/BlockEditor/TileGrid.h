@@ -5,15 +5,30 @@
 
 class MapMan;
 
-class TileGrid final : public Grid<Tile>
+// Index into a TileGrid's palette of distinct tiles.
+typedef uint16_t PaletteID;
+
+// Palette index that every TileGrid reserves for the empty tile.
+#define PALETTE_EMPTY 0
+#define PALETTE_MAX_SIZE 0x10000
+
+// Generated models split the geometry of a texture into several meshes of at most this many vertices, so that 16-bit indices can address all of them.
+// Index 65535 is left unused, since glTF reserves it to restart primitives.
+#define MODEL_MESH_MAX_VERTICES 0xFFFF
+// Number of tile instances that each worker thread job covers when generating models.
+#define MODEL_JOB_INSTANCES 1024
+
+// Each cel stores a 16-bit index into a per-grid palette of distinct tiles, rather than the 16-byte tile itself.
+class TileGrid final : public Grid<PaletteID>
 {
+	friend struct TileGridInspector; // Lets blockeditor-tests look at the draw batches
 public:
 	// Constructs a blank TileGrid with no size
 	TileGrid();
 	// Constructs a TileGrid full of empty tiles.
-	TileGrid(MapMan* mapMan, size_t width, size_t height, size_t length);
+	TileGrid(MapMan* mapMan, size_t width, size_t height, size_t length, GridStorage storage = GridStorage::DENSE);
 	// Constructs a TileGrid filled with the given tile.
-	TileGrid(MapMan* mapMan, size_t width, size_t height, size_t length, float spacing, Tile fill);
+	TileGrid(MapMan* mapMan, size_t width, size_t height, size_t length, float spacing, Tile fill, GridStorage storage = GridStorage::DENSE);
 
 	Tile GetTile(int i, int j, int k) const;
 	Tile GetTile(int flatIndex) const;
@@ -30,8 +45,14 @@ public:
 
 	void UnsetTile(int i, int j, int k);
 
+	// Returns true if the tile at (i, j, k) isn't empty. Cheaper than decoding the tile with GetTile().
+	bool HasTile(int i, int j, int k) const;
+
+	// Calls `remap` on every distinct tile in the grid, instead of on every cel. Tiles must not be remapped to empty tiles.
+	void RemapTiles(const std::function<void(Tile&)>& remap);
+
 	// Returns a smaller TileGrid with a copy of the tile data in the rectangle defined by coordinates (i, j, k) and size (w, h, l).
-	TileGrid Subsection(int i, int j, int k, int w, int h, int l) const;
+	TileGrid Subsection(int i, int j, int k, int w, int h, int l, GridStorage storage = GridStorage::DENSE) const;
 
 	// Draws the tile grid, hiding all layers that are outside of the given y coordinate range.
 	void Draw(Vector3 position, int fromY, int toY);
@@ -48,23 +69,162 @@ public:
 	//Returns the list of texture and model IDs that are actually used in this tile grid
 	std::pair<std::vector<TexID>, std::vector<ModelID>> GetUsedIDs() const;
 
+	// Returns the model drawn in preview mode, regenerating and uploading it when the tiles or the app's meshing settings have changed.
 	const RLModel GetModel();
+
+	// Combines the tiles whose shapes pass `shapeFilter` into a new model. See _GenerateModel() for `culling`, `greedy` and `weld`.
+	// Unlike GetModel(), the model isn't cached or uploaded to the GPU, so it can be made without a graphics context. The caller has to unload it.
+	// If `chunkSize` is positive, the geometry is split into separate meshes for each chunk, and the chunk of each mesh is written to `meshChunks`.
+	// The number of vertices that welding removed is written to `weldedVertices`, if it is set.
+	RLModel GenerateModel(bool culling, bool greedy, bool weld, const std::function<bool(ModelID)>& shapeFilter = nullptr, int chunkSize = 0, std::vector<size_t>* meshChunks = nullptr,
+		size_t* weldedVertices = nullptr);
+
+	// Generated models can be split into cubic chunks of `chunkSize` cels, which are numbered along X, then Z, then Y, like cels.
+	size_t GetModelChunkCount(int chunkSize) const;
+	// Returns the number of chunks along X, Y and Z.
+	std::array<int, 3> GetModelChunkCounts(int chunkSize) const;
+	size_t ModelChunkIndex(const TileInstance& instance, int chunkSize) const;
+
+	// The tiles that share a texture and shape, for exporting them as instances of one mesh.
+	struct TileBatch
+	{
+		TexID texture;
+		ModelID shape;
+		std::vector<TileInstance> instances;
+	};
+	std::vector<TileBatch> GetTileBatches();
+
+	// Returns true if the shape covers every side of its cel with a full square face, like a cube.
+	bool IsCubeShape(ModelID shape) const;
+	// Returns a byte for each cel, in FlatIndex() order, that is 1 if the cel has a tile with a cube shape and 0 otherwise.
+	std::vector<uint8_t> GetCubeCels() const;
+
+	// Returns a grid with one cel for each block of `factor` cels along every side, for levels of detail.
+	// A cel is filled if at least half of its block is, with the most common tile (preferring cubes) and the most common texture.
+	// Blocks at the far edges of the grid are cut short, and only count the cels that they have.
+	// The cels keep the same spacing, so a model of the new grid has to be scaled up by `factor` to cover the same space.
+	TileGrid Downsample(int factor) const;
 protected:
 	MapMan* _mapMan;
 
-	// Calculates lists of transformations for each tile, separated by texture and shape, to be drawn as instances.
-	void _RegenBatches(Vector3 position, int fromY, int toY);
-	// Combines all of the tiles into a single model, for export or for preview. When culling is true, redundant faces between tiles are removed.
-	RLModel* _GenerateModel(bool culling = true);
+	// Returns the palette index of `tile`, adding it to the palette if it isn't there yet.
+	// A full palette is compacted first, which renumbers the entries, so the index has to be stored in a cel before the next call.
+	// If every entry is still in use, then the error is reported and PALETTE_EMPTY is returned.
+	PaletteID _GetPaletteID(const Tile& tile);
+	// Like _GetPaletteID(), but never compacts the palette, so that the indices handed out before stay valid.
+	PaletteID _GetPaletteIDWithoutCompacting(const Tile& tile);
+	// Rebuilds the palette from the entries that the cels still use, renumbering the cels to match.
+	void _CompactPalette();
+	// Returns a byte for each palette entry that is 1 if its tile has a cube shape.
+	std::vector<uint8_t> _GetCubePaletteEntries() const;
+
+	typedef std::tuple<ModelID, TexID, int, int> PaletteKey;
+	static PaletteKey _PaletteKey(const Tile& tile) { return { tile.shape, tile.texture, tile.angle, tile.pitch }; }
 
-	std::map<std::pair<TexID, RLMesh*>, std::vector<Matrix>> _drawBatches;
+	std::vector<Tile> _palette; // Distinct tiles referenced by the cels. Entry 0 is always the empty tile.
+	std::map<PaletteKey, PaletteID> _paletteLookup;
+
+	// Calculates lists of transformations for each tile, separated by texture and shape, to be drawn as instances.
+	// Only the render chunks that have been marked dirty since the last call are recalculated, and only the
+	// layers of the batches that they have instances in are rewritten, unless a batch runs out of room.
+	void _RegenBatches();
+	// Places the instances of every render chunk into `_instances`, leaving room for each batch to grow.
+	void _SortInstances();
+	// Replaces `layers` (in increasing order) of batch `b` with `layerInstances`, moving the layers above them along.
+	// Returns false without changing anything if the batch doesn't have room for its new instances.
+	bool _PatchBatch(int b, const std::vector<int>& layers, const std::vector<std::vector<TileInstance>>& layerInstances);
+	// Flags the render chunks overlapping the rectangular prism with a corner at (i, j, k) and size (w, h, l) for recalculation.
+	void _MarkDirty(int i, int j, int k, int w, int h, int l);
+	void _RegenChunk(int cx, int y, int cz);
+	// Returns the index of the batch for the first mesh of `shape` with `texture`, creating batches for all of its meshes if necessary.
+	int _BatchIndex(TexID texture, ModelID shape);
+	size_t _RenderChunkIndex(int cx, int y, int cz) const;
+	// Combines all of the tiles into a single model in memory, for export or for preview. When culling is true, redundant faces between tiles are removed.
+	// When greedy is true, full square faces that lie in the same plane and look the same are merged into larger quads.
+	// When weld is true, vertices with the same attributes are merged within each mesh.
+	// Only tiles whose shapes pass `shapeFilter` are included, if it is set. See GenerateModel() for `chunkSize`, `meshChunks` and `weldedVertices`.
+	RLModel* _GenerateModel(bool culling = true, bool greedy = false, bool weld = false, const std::function<bool(ModelID)>& shapeFilter = nullptr,
+		int chunkSize = 0, std::vector<size_t>* meshChunks = nullptr, size_t* weldedVertices = nullptr);
+
+	// A triangle that faces one side of its cel, identified by its three vertices (relative to the center of that side).
+	// The coordinates are in units of 1 / BOUNDARY_FACE_PRECISION and the vertices are sorted.
+	typedef std::array<int32_t, 9> BoundaryFace;
+	static constexpr float BOUNDARY_FACE_PRECISION = 4096.0f;
+	struct BoundaryFaceHash { size_t operator()(const BoundaryFace& face) const; };
+
+	// A pair of triangles in one mesh that exactly covers one side of the cel, with texture coordinates that can be
+	// extended across neighboring cels. Faces like this can be merged with their neighbors by greedy meshing.
+	// The side is spanned by the two axes other than its normal's, in increasing order, called u and v here.
+	struct FullFace
+	{
+		int triangles[2] = { -1, -1 }; // Both are -1 if the side isn't covered by a full face
+		Vector2 uv; // Texture coordinates at the corner with the lowest u and v
+		Vector2 uvPerU, uvPerV; // Change in texture coordinates across the face along u and v. Always whole numbers.
+	};
+
+	// The faces that one shape in one orientation has on each side of its cel. A face is hidden when the
+	// neighbor on its side has a face with the same key on the opposite side, or covers the whole opposite side.
+	struct BoundarySignature
+	{
+		std::vector<std::vector<int>> triangleSides; // Side faced by each triangle of each mesh, or -1 if it doesn't face one
+		std::vector<std::vector<BoundaryFace>> triangleKeys; // Key of each triangle of each mesh that faces a side
+		std::vector<std::array<FullFace, 6>> fullFaces; // Full face of each mesh on each side
+		std::array<std::unordered_set<BoundaryFace, BoundaryFaceHash>, 6> sides;
+		std::array<bool, 6> coveredSides = {}; // True if two of the faces make a square over the whole side
+	};
+	BoundarySignature _BuildBoundarySignature(ModelID shape, int orientation) const;
+
+	// A combination of texture and mesh whose instances are drawn with one call.
+	struct DrawBatch
+	{
+		TexID texture;
+		ModelID shape;
+		int mesh; // Index into the shape's meshes
+	};
+	std::vector<DrawBatch> _drawBatches;
+	std::vector<std::vector<int>> _batchTable; // Indexed by texture and then shape. Holds the batch of the shape's first mesh, or -1.
+	std::vector<TileInstance> _instances; // Instances of every batch, grouped by batch and then ordered by layer, with unused room after each batch.
+	std::vector<size_t> _layerStarts; // Index into _instances where each layer of each batch starts, with (height + 1) entries per batch.
+
+	// GPU copy of `_instances`. Only the parts that changed since the last upload are sent again.
+	// Copies of a grid don't share the buffer; they start without one and upload their own when they are drawn.
+	struct InstanceBuffer
+	{
+		unsigned int vboId = 0;
+		size_t capacity = 0; // Size of the buffer in bytes
+		bool outdated = true; // The whole buffer needs to be uploaded
+		std::vector<std::pair<size_t, size_t>> dirtyRanges; // Ranges of instances that changed since the last upload
+
+		// Marks the instances in [begin, end) for the next upload.
+		void Invalidate(size_t begin, size_t end) { if (begin < end) dirtyRanges.emplace_back(begin, end); }
+		bool NeedsUpload() const { return outdated || !dirtyRanges.empty(); }
+
+		InstanceBuffer() = default;
+		InstanceBuffer(const InstanceBuffer&) {}
+		InstanceBuffer& operator=(const InstanceBuffer& other) { if (this != &other) Unload(); return *this; }
+		~InstanceBuffer() { Unload(); }
+
+		// Sends the changed instances to the GPU, only creating a new buffer if they don't fit in the current one.
+		void Upload(const std::vector<TileInstance>& instances);
+		void Unload();
+	};
+	InstanceBuffer _instanceBuffer;
+
+	// Instances for the tiles in a GRID_CHUNK_SIZE x 1 x GRID_CHUNK_SIZE section of one layer of the grid.
+	struct RenderChunk
+	{
+		std::vector<int> batches; // Batch index of each instance
+		std::vector<TileInstance> instances;
+		bool dirty = true;
+	};
+	std::vector<RenderChunk> _renderChunks; // Ordered by Y, then Z, then X. Empty until the first regen.
+	std::vector<size_t> _dirtyChunks; // Indices of the render chunks that were marked dirty since the last regen
 
-	Vector3 _batchPosition;
 	bool _regenBatches;
 	bool _regenModel;
-	int _batchFromY;
-	int _batchToY;
 
 	RLModel* _model;
 	bool _modelCulled;
+	bool _modelGreedy;
+	bool _modelWelded;
 };
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "stdafx.h"
+#include "WorkerPool.h"
+#include "Core.h"
+
+// Set on threads while they are running jobs, so that nested loops don't wait on themselves.
+static thread_local bool _inJob = false;
+
+WorkerPool& WorkerPool::_Get()
+{
+	static WorkerPool instance;
+	return instance;
+}
+
+WorkerPool::WorkerPool()
+	: _job(nullptr), _count(0), _next(0), _busyThreads(0), _generation(0), _quit(false)
+{
+	_StartThreads(Max(1, (int)std::thread::hardware_concurrency()));
+}
+
+WorkerPool::~WorkerPool()
+{
+	_StopThreads();
+}
+
+void WorkerPool::ParallelFor(size_t count, const std::function<void(size_t)>& job)
+{
+	WorkerPool& pool = _Get();
+	if (count <= 1 || _inJob || pool._threads.empty())
+	{
+		for (size_t i = 0; i < count; ++i) job(i);
+		return;
+	}
+
+	std::lock_guard<std::mutex> callLock(pool._callMutex);
+	{
+		std::lock_guard<std::mutex> lock(pool._mutex);
+		pool._job = &job;
+		pool._count = count;
+		pool._next = 0;
+		pool._busyThreads = (int)pool._threads.size();
+		++pool._generation;
+	}
+	pool._wakeCondition.notify_all();
+
+	// The calling thread helps instead of sitting idle
+	pool._RunJobs();
+
+	std::exception_ptr exception;
+	{
+		// The workers may still be running calls that reference the job, even if one has already thrown.
+		std::unique_lock<std::mutex> lock(pool._mutex);
+		pool._doneCondition.wait(lock, [&]() { return pool._busyThreads == 0; });
+		pool._job = nullptr;
+		std::swap(exception, pool._exception);
+	}
+	if (exception) std::rethrow_exception(exception);
+}
+
+int WorkerPool::GetThreadCount()
+{
+	return (int)_Get()._threads.size() + 1;
+}
+
+void WorkerPool::SetThreadCount(int count)
+{
+	WorkerPool& pool = _Get();
+	std::lock_guard<std::mutex> callLock(pool._callMutex);
+	pool._StopThreads();
+	pool._StartThreads(Max(1, count));
+}
+
+void WorkerPool::_StartThreads(int count)
+{
+	_quit = false;
+	for (int t = 0; t < count - 1; ++t)
+	{
+		_threads.emplace_back(&WorkerPool::_WorkerLoop, this, _generation);
+	}
+}
+
+void WorkerPool::_StopThreads()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_wakeCondition.notify_all();
+	for (std::thread& thread : _threads)
+	{
+		thread.join();
+	}
+	_threads.clear();
+}
+
+void WorkerPool::_WorkerLoop(uint64_t seenGeneration)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true)
+	{
+		_wakeCondition.wait(lock, [&]() { return _quit || _generation != seenGeneration; });
+		if (_quit) return;
+		seenGeneration = _generation;
+
+		lock.unlock();
+		_RunJobs();
+		lock.lock();
+
+		if (--_busyThreads == 0) _doneCondition.notify_all();
+	}
+}
+
+void WorkerPool::_RunJobs()
+{
+	_inJob = true;
+	try
+	{
+		for (size_t i = _next.fetch_add(1); i < _count; i = _next.fetch_add(1))
+		{
+			(*_job)(i);
+		}
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_exception) _exception = std::current_exception();
+		// The other threads stop at their next iteration
+		_next = _count;
+	}
+	_inJob = false;
+}
\ No newline at end of file
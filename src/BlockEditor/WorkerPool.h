@@ -0,0 +1,42 @@
+#pragma once
+
+// A set of worker threads that split up loops whose iterations don't depend on each other.
+// It is implemented as a singleton with a static interface, like Assets.
+class WorkerPool
+{
+public:
+	// Calls `job(i)` for every i in [0, count) on the worker threads and the calling thread, and returns once all of the calls have finished.
+	// The calls can happen in any order. Calling this from inside of a job runs the inner loop on the current thread.
+	// If a call throws, the iterations that haven't started yet are skipped, and the first exception is rethrown here once the running ones have finished.
+	static void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+
+	// Returns the number of threads that ParallelFor uses, counting the calling thread.
+	static int GetThreadCount();
+	// Sets the number of threads that ParallelFor uses, counting the calling thread. With 1, everything runs on the calling thread.
+	static void SetThreadCount(int count);
+private:
+	WorkerPool();
+	~WorkerPool();
+	static WorkerPool& _Get();
+
+	void _StartThreads(int count);
+	void _StopThreads();
+	// `seenGeneration` is the generation when the thread was started, so that it doesn't run a loop that started before it.
+	void _WorkerLoop(uint64_t seenGeneration);
+	// Takes and runs iterations of the current loop until there are none left.
+	void _RunJobs();
+
+	std::vector<std::thread> _threads;
+	std::mutex _callMutex; // Held for the whole duration of a ParallelFor call
+
+	std::mutex _mutex; // Guards everything below
+	std::condition_variable _wakeCondition;
+	std::condition_variable _doneCondition;
+	const std::function<void(size_t)>* _job;
+	size_t _count;
+	std::atomic<size_t> _next; // Next iteration to be taken
+	int _busyThreads; // Workers that haven't finished the current loop
+	std::exception_ptr _exception; // First exception thrown by a call of the current loop
+	uint64_t _generation; // Incremented for every loop, so that workers can tell a new one has started
+	bool _quit;
+};
\ No newline at end of file
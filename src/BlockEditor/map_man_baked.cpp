@@ -0,0 +1,211 @@
+#include "stdafx.h"
+#include "MapMan.h"
+#include "RL.h"
+#include "MeshTools.h"
+#include "WorkerPool.h"
+#include "BakedMap.h"
+
+// Rounds a file offset up to the alignment of baked map tables and blobs.
+static uint64_t AlignBakedOffset(uint64_t offset)
+{
+    return (offset + BAKED_MAP_ALIGNMENT - 1) & ~uint64_t(BAKED_MAP_ALIGNMENT - 1);
+}
+
+bool MapMan::ExportBakedMap(std::filesystem::path filePath, const ExportOptions& options)
+{
+    // Only the options that apply to plain geometry are used: meshing, chunking and the vertex cache optimization.
+    const bool chunked = options.chunkSize > 0;
+    std::vector<size_t> meshChunks;
+    RLModel model = _tileGrid.GenerateModel(options.cullFaces, options.greedyMeshing, options.weldVertices, nullptr, options.chunkSize, &meshChunks);
+    meshChunks.resize(model.meshCount, 0);
+
+    bool error = false;
+
+    try
+    {
+        if (options.optimizeVertexCache)
+        {
+            WorkerPool::ParallelFor(model.meshCount, [&](size_t m)
+                {
+                    OptimizeMeshVertexCache(model.meshes[m]);
+                    OptimizeMeshVertexFetch(model.meshes[m]);
+                });
+        }
+
+        BakedMapHeader header = {};
+        header.magic = BAKED_MAP_MAGIC;
+        header.version = BAKED_MAP_VERSION;
+        header.vertexStride = sizeof(BakedVertex);
+        header.indexSize = sizeof(uint16_t);
+        header.spacing = _tileGrid.GetSpacing();
+        header.chunkSize = chunked ? options.chunkSize : 0;
+        const std::array<int, 3> chunkCounts = chunked ? _tileGrid.GetModelChunkCounts(options.chunkSize) : std::array<int, 3>{ 1, 1, 1 };
+        for (int c = 0; c < 3; ++c) header.chunkCounts[c] = chunkCounts[c];
+
+        std::string strings;
+        auto addString = [&](const std::string& string, uint32_t& offset, uint32_t& length)
+            {
+                offset = (uint32_t)strings.size();
+                length = (uint32_t)string.size();
+                strings += string;
+            };
+
+        // There is a material for each texture, named by its path relative to the file like in the glTF export
+        std::vector<BakedMaterial> materials;
+        std::vector<TexID> materialTextures;
+        std::vector<uint32_t> meshMaterials(model.meshCount);
+        for (int m = 0; m < model.meshCount; ++m)
+        {
+            size_t material = std::find(materialTextures.begin(), materialTextures.end(), model.meshMaterial[m]) - materialTextures.begin();
+            if (material == materialTextures.size())
+            {
+                materialTextures.push_back(model.meshMaterial[m]);
+                BakedMaterial bakedMaterial = {};
+                std::filesystem::path texturePath = std::filesystem::relative(
+                    std::filesystem::current_path() / PathFromTexID(model.meshMaterial[m]),
+                    std::filesystem::current_path() / filePath.parent_path());
+                addString(texturePath.generic_string(), bakedMaterial.textureOffset, bakedMaterial.textureLength);
+                materials.push_back(bakedMaterial);
+            }
+            meshMaterials[m] = (uint32_t)material;
+        }
+
+        // Each mesh becomes one range. Generated meshes never have more vertices than 16-bit indices can address.
+        // The ranges of a chunk are next to each other and sorted by material, so that a runtime can draw them in order.
+        std::vector<int> meshOrder(model.meshCount);
+        for (int m = 0; m < model.meshCount; ++m) meshOrder[m] = m;
+        std::stable_sort(meshOrder.begin(), meshOrder.end(), [&](int a, int b)
+            {
+                return std::make_pair(meshChunks[a], meshMaterials[a]) < std::make_pair(meshChunks[b], meshMaterials[b]);
+            });
+        std::erase_if(meshOrder, [&](int m) { return model.meshes[m].vertexCount == 0 || model.meshes[m].indices == NULL; });
+
+        std::vector<BakedChunk> chunks;
+        std::vector<BakedRange> ranges;
+        for (int m : meshOrder)
+        {
+            const RLMesh& mesh = model.meshes[m];
+            if (ranges.empty() || meshChunks[m] != meshChunks[meshOrder[ranges.size() - 1]])
+            {
+                BakedChunk chunk = {};
+                chunk.coords[0] = int32_t(meshChunks[m] % chunkCounts[0]);
+                chunk.coords[1] = int32_t(meshChunks[m] / (size_t(chunkCounts[0]) * chunkCounts[2]));
+                chunk.coords[2] = int32_t((meshChunks[m] / chunkCounts[0]) % chunkCounts[2]);
+                chunk.firstRange = (uint32_t)ranges.size();
+                for (int c = 0; c < 3; ++c)
+                {
+                    chunk.boundsMin[c] = std::numeric_limits<float>::max();
+                    chunk.boundsMax[c] = std::numeric_limits<float>::lowest();
+                }
+                chunks.push_back(chunk);
+            }
+
+            BakedChunk& chunk = chunks.back();
+            ++chunk.rangeCount;
+            for (int v = 0; v < mesh.vertexCount * 3; ++v)
+            {
+                chunk.boundsMin[v % 3] = Minf(mesh.vertices[v], chunk.boundsMin[v % 3]);
+                chunk.boundsMax[v % 3] = Maxf(mesh.vertices[v], chunk.boundsMax[v % 3]);
+            }
+
+            BakedRange range = {};
+            range.material = meshMaterials[m];
+            range.vertexCount = (uint32_t)mesh.vertexCount;
+            range.indexCount = (uint32_t)mesh.triangleCount * 3;
+            ranges.push_back(range);
+        }
+
+        std::vector<BakedEntity> entities;
+        for (const Ent& ent : _entGrid.GetEntList())
+        {
+            BakedEntity entity = {};
+            entity.position[0] = ent.position.x;
+            entity.position[1] = ent.position.y;
+            entity.position[2] = ent.position.z;
+            entity.radius = ent.radius;
+            entity.yaw = (float)ent.yaw;
+            entity.pitch = (float)ent.pitch;
+            entity.color[0] = ent.color.r;
+            entity.color[1] = ent.color.g;
+            entity.color[2] = ent.color.b;
+            entity.color[3] = ent.color.a;
+
+            nlohmann::json properties = ent.properties;
+            if (ent.model != nullptr)
+                properties["modelPath"] = ent.model->GetPath().generic_string();
+            if (ent.texture != nullptr)
+                properties["texturePath"] = ent.texture->GetPath().generic_string();
+            addString(properties.dump(), entity.propertiesOffset, entity.propertiesLength);
+            entities.push_back(entity);
+        }
+
+        // Lay out the tables, then the blobs of each range
+        uint64_t offset = sizeof(BakedMapHeader);
+        auto reserve = [&](uint64_t size)
+            {
+                const uint64_t start = AlignBakedOffset(offset);
+                offset = start + size;
+                return start;
+            };
+        header.chunkCount = (uint32_t)chunks.size();
+        header.chunkTableOffset = reserve(chunks.size() * sizeof(BakedChunk));
+        header.rangeCount = (uint32_t)ranges.size();
+        header.rangeTableOffset = reserve(ranges.size() * sizeof(BakedRange));
+        header.materialCount = (uint32_t)materials.size();
+        header.materialTableOffset = reserve(materials.size() * sizeof(BakedMaterial));
+        header.entityCount = (uint32_t)entities.size();
+        header.entityTableOffset = reserve(entities.size() * sizeof(BakedEntity));
+        header.stringsSize = strings.size();
+        header.stringsOffset = reserve(strings.size());
+        for (BakedRange& range : ranges)
+        {
+            range.vertexOffset = reserve(uint64_t(range.vertexCount) * sizeof(BakedVertex));
+            range.indexOffset = reserve(uint64_t(range.indexCount) * sizeof(uint16_t));
+        }
+
+        std::ofstream file(filePath, std::ios::binary);
+        auto writeAt = [&](uint64_t position, const void* data, size_t size)
+            {
+                static const char ZEROES[BAKED_MAP_ALIGNMENT] = {};
+                file.write(ZEROES, std::streamsize(position - (uint64_t)file.tellp()));
+                file.write((const char*)data, size);
+            };
+        writeAt(0, &header, sizeof(header));
+        writeAt(header.chunkTableOffset, chunks.data(), chunks.size() * sizeof(BakedChunk));
+        writeAt(header.rangeTableOffset, ranges.data(), ranges.size() * sizeof(BakedRange));
+        writeAt(header.materialTableOffset, materials.data(), materials.size() * sizeof(BakedMaterial));
+        writeAt(header.entityTableOffset, entities.data(), entities.size() * sizeof(BakedEntity));
+        writeAt(header.stringsOffset, strings.data(), strings.size());
+
+        // Vertices are interleaved one mesh at a time. Missing normals and texture coordinates are written as zeroes.
+        std::vector<BakedVertex> vertices;
+        for (size_t r = 0; r < ranges.size(); ++r)
+        {
+            const RLMesh& mesh = model.meshes[meshOrder[r]];
+            vertices.assign(mesh.vertexCount, BakedVertex{});
+            for (int v = 0; v < mesh.vertexCount; ++v)
+            {
+                memcpy(vertices[v].position, &mesh.vertices[v * 3], sizeof(float) * 3);
+                if (mesh.normals != NULL) memcpy(vertices[v].normal, &mesh.normals[v * 3], sizeof(float) * 3);
+                if (mesh.texcoords != NULL) memcpy(vertices[v].texcoord, &mesh.texcoords[v * 2], sizeof(float) * 2);
+            }
+            writeAt(ranges[r].vertexOffset, vertices.data(), vertices.size() * sizeof(BakedVertex));
+            writeAt(ranges[r].indexOffset, mesh.indices, ranges[r].indexCount * sizeof(uint16_t));
+        }
+        writeAt(AlignBakedOffset(offset), nullptr, 0);
+
+        if (file.fail()) error = true;
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+        error = true;
+    }
+    catch (...)
+    {
+        error = true;
+    }
+
+    UnloadModel(model);
+    return !error;
+}
\ No newline at end of file
@@ -1,28 +1,347 @@
 #include "stdafx.h"
 #include "MapMan.h"
-#include "EditorApp.h"
 #include "RL.h"
 #include "RLMath.h"
+#include "MeshTools.h"
+#include "WorkerPool.h"
+#include "TextureAtlas.h"
+#include "ChunkVisibility.h"
+#include "BoxColliders.h"
 
 #include "cppcodec/base64_default_rfc4648.hpp"
 
 #define TARGET_ARRAY_BUFFER 34962
 #define TARGET_ELEMENT_BUFFER 34963
+#define COMP_TYPE_BYTE 5120
 #define COMP_TYPE_FLOAT 5126
 #define COMP_TYPE_USHORT 5123
+#define COMP_TYPE_UINT 5125
 #define PRIMITIVE_MODE_TRIANGLES 4
 #define FILTER_NEAREST 9728
 #define FILTER_NEAREST_MIP_NEAREST 9984
 #define WRAP_REPEAT 10497
+#define WRAP_CLAMP_TO_EDGE 33071
 
-bool MapMan::ExportGLTFScene(std::filesystem::path filePath, bool separateGeometry)
+// Largest width and height of texture atlases, and the pixels of repeated edges around each texture in them.
+// Atlases are sampled without mipmaps, so the padding only has to cover rounding at the edges.
+#define ATLAS_MAX_SIZE 4096
+#define ATLAS_PADDING 4
+
+// Smallest share of the screen that the full detail geometry is shown at (see MSFT_lod). Each coarser level covers a quarter as much.
+#define LOD_BASE_SCREEN_COVERAGE 0.25f
+
+// Texture coordinate transform (scale in x and y, offset in z and w) of textures that aren't in an atlas.
+static const Vector4 UV_IDENTITY = { 1.0f, 1.0f, 0.0f, 0.0f };
+
+// Returns the rotation of a matrix without scaling as a quaternion.
+static Quaternion RotationToQuaternion(const Matrix& m)
+{
+    // Raylib matrices are column major, so the first row is m0, m4, m8.
+    Quaternion q;
+    const float trace = m.m0 + m.m5 + m.m10;
+    if (trace > 0.0f)
+    {
+        float s = sqrtf(trace + 1.0f) * 2.0f;
+        q = { (m.m6 - m.m9) / s, (m.m8 - m.m2) / s, (m.m1 - m.m4) / s, 0.25f * s };
+    }
+    else if (m.m0 > m.m5 && m.m0 > m.m10)
+    {
+        float s = sqrtf(1.0f + m.m0 - m.m5 - m.m10) * 2.0f;
+        q = { 0.25f * s, (m.m4 + m.m1) / s, (m.m8 + m.m2) / s, (m.m6 - m.m9) / s };
+    }
+    else if (m.m5 > m.m10)
+    {
+        float s = sqrtf(1.0f + m.m5 - m.m0 - m.m10) * 2.0f;
+        q = { (m.m4 + m.m1) / s, 0.25f * s, (m.m9 + m.m6) / s, (m.m8 - m.m2) / s };
+    }
+    else
+    {
+        float s = sqrtf(1.0f + m.m10 - m.m0 - m.m5) * 2.0f;
+        q = { (m.m8 + m.m2) / s, (m.m9 + m.m6) / s, 0.25f * s, (m.m1 - m.m4) / s };
+    }
+    return q;
+}
+
+// Baked positions are quantized to 16-bit integers, which the transform of the node holding the mesh turns back into `offset + step * value`.
+struct PositionQuantization
+{
+    Vector3 offset;
+    float step;
+};
+
+// Picks the smallest step that is a power of two fraction of the grid spacing, and lets every position within the bounds fit into 16 bits.
+// Because of this, tile corners and other points at simple fractions of a cel are stored exactly.
+static PositionQuantization ChoosePositionQuantization(Vector3 min, Vector3 max, float spacing)
+{
+    const float extent = Maxf(Maxf(max.x - min.x, max.y - min.y), Maxf(max.z - min.z, 0.0f));
+    int exponent = (extent > 0.0f) ? (int)floorf(log2f(65535.0f * spacing / extent)) : 0;
+    while (true)
+    {
+        PositionQuantization quant;
+        quant.step = ldexpf(spacing, -exponent);
+        // The offset is snapped to the step as well, which can push the far end out of range by one step
+        quant.offset = { floorf(min.x / quant.step) * quant.step, floorf(min.y / quant.step) * quant.step, floorf(min.z / quant.step) * quant.step };
+        const float range = Maxf(Maxf(max.x - quant.offset.x, max.y - quant.offset.y), max.z - quant.offset.z) / quant.step;
+        if (range <= 65535.0f) return quant;
+        --exponent;
+    }
+}
+
+// Passes the bytes of the glTF buffer on to the file in order, either as they are or encoded as base64.
+// Only a small staging buffer is kept in memory, so exports take no more memory when the map is large.
+class BufferStream
+{
+public:
+    BufferStream(std::ostream& file, bool base64) : _file(file), _base64(base64), _written(0)
+    {
+        _staging.reserve(STAGING_SIZE);
+    }
+
+    void Write(const void* data, size_t nBytes)
+    {
+        const uint8_t* bytes = (const uint8_t*)data;
+        _written += nBytes;
+        while (nBytes > 0)
+        {
+            size_t n = std::min(nBytes, STAGING_SIZE - _staging.size());
+            _staging.insert(_staging.end(), bytes, bytes + n);
+            bytes += n;
+            nBytes -= n;
+            if (_staging.size() == STAGING_SIZE) _Flush(false);
+        }
+    }
+
+    void WriteZeroes(size_t nBytes)
+    {
+        static const uint8_t ZEROES[256] = {};
+        for (; nBytes > sizeof(ZEROES); nBytes -= sizeof(ZEROES)) Write(ZEROES, sizeof(ZEROES));
+        Write(ZEROES, nBytes);
+    }
+
+    // Writes out whatever is left in the staging buffer, including the padding at the end of base64 data.
+    void Finish() { _Flush(true); }
+
+    // Number of bytes that have been written so far, before encoding.
+    size_t GetSize() const { return _written; }
+private:
+    // A multiple of 3, so that base64 can be encoded in pieces without padding in between
+    static constexpr size_t STAGING_SIZE = 3 * 16384;
+
+    void _Flush(bool final)
+    {
+        if (!_base64)
+        {
+            _file.write((const char*)_staging.data(), _staging.size());
+            _staging.clear();
+            return;
+        }
+
+        // Base64 encodes 3 bytes at a time, so anything that doesn't fill a group waits for the next flush, unless this is the end.
+        size_t nBytes = final ? _staging.size() : _staging.size() / 3 * 3;
+        char encoded[base64::encoded_size(STAGING_SIZE) + 1];
+        size_t nEncoded = base64::encode(encoded, sizeof(encoded), _staging.data(), nBytes);
+        _file.write(encoded, nEncoded);
+        _staging.erase(_staging.begin(), _staging.begin() + nBytes);
+    }
+
+    std::ostream& _file;
+    bool _base64;
+    std::vector<uint8_t> _staging;
+    size_t _written;
+};
+
+// Writes positions as unsigned 16-bit integers, padded to 8 bytes each.
+static void WriteQuantizedPositions(BufferStream& out, const float* positions, int count, const PositionQuantization& quant)
+{
+    const float offset[3] = { quant.offset.x, quant.offset.y, quant.offset.z };
+    for (int v = 0; v < count; ++v)
+    {
+        uint16_t values[4] = {};
+        for (int c = 0; c < 3; ++c)
+        {
+            values[c] = (uint16_t)lroundf(Clamp((positions[v * 3 + c] - offset[c]) / quant.step, 0.0f, 65535.0f));
+        }
+        out.Write(values, sizeof(values));
+    }
+}
+
+// Writes normals as normalized signed bytes, padded to 4 bytes each. Missing normals are written as zeroes.
+static void WriteQuantizedNormals(BufferStream& out, const float* normals, int count)
+{
+    for (int v = 0; v < count; ++v)
+    {
+        int8_t values[4] = {};
+        for (int c = 0; c < 3 && normals != NULL; ++c)
+        {
+            values[c] = (int8_t)lroundf(Clamp(normals[v * 3 + c] * 127.0f, -127.0f, 127.0f));
+        }
+        out.Write(values, sizeof(values));
+    }
+}
+
+// Returns true if the texture coordinates can be stored as normalized unsigned 16-bit integers, which only covers 0 to 1.
+static bool TexCoordsFitUnorm16(const float* texcoords, int count)
+{
+    if (texcoords == NULL) return true;
+    for (int i = 0; i < count * 2; ++i)
+    {
+        if (texcoords[i] < 0.0f || texcoords[i] > 1.0f) return false;
+    }
+    return true;
+}
+
+// Writes texture coordinates moved into a texture's part of an atlas by `transform`, as floats or normalized unsigned 16-bit integers.
+// Missing texture coordinates are treated as zeroes.
+static void WriteTexCoords(BufferStream& out, const float* texcoords, int count, bool quantize, Vector4 transform)
+{
+    const bool identity = transform.x == UV_IDENTITY.x && transform.y == UV_IDENTITY.y && transform.z == UV_IDENTITY.z && transform.w == UV_IDENTITY.w;
+    if (!quantize && identity && texcoords != NULL)
+    {
+        out.Write(texcoords, sizeof(float) * 2 * count);
+        return;
+    }
+
+    const float scale[2] = { transform.x, transform.y };
+    const float offset[2] = { transform.z, transform.w };
+    for (int v = 0; v < count; ++v)
+    {
+        float values[2];
+        for (int c = 0; c < 2; ++c)
+        {
+            values[c] = offset[c] + scale[c] * (texcoords != NULL ? texcoords[v * 2 + c] : 0.0f);
+        }
+
+        if (quantize)
+        {
+            const uint16_t quantized[2] = { (uint16_t)lroundf(Clamp(values[0], 0.0f, 1.0f) * 65535.0f), (uint16_t)lroundf(Clamp(values[1], 0.0f, 1.0f) * 65535.0f) };
+            out.Write(quantized, sizeof(quantized));
+        }
+        else
+        {
+            out.Write(values, sizeof(values));
+        }
+    }
+}
+
+// Sets the "min" and "max" of a float position accessor to the bounds of the mesh's vertices.
+static void SetPositionBounds(nlohmann::json& accessor, const RLMesh& mesh)
+{
+    float minPos[3], maxPos[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        minPos[c] = std::numeric_limits<float>::max();
+        maxPos[c] = std::numeric_limits<float>::lowest();
+    }
+    for (int v = 0; v < mesh.vertexCount * 3; ++v)
+    {
+        minPos[v % 3] = Minf(mesh.vertices[v], minPos[v % 3]);
+        maxPos[v % 3] = Maxf(mesh.vertices[v], maxPos[v % 3]);
+    }
+    accessor["min"] = { minPos[0], minPos[1], minPos[2] };
+    accessor["max"] = { maxPos[0], maxPos[1], maxPos[2] };
+}
+
+// Writes an attribute array as it is, or zeroes if the mesh doesn't have it.
+static void WriteAttribute(BufferStream& out, const float* data, int count, int nComponents)
+{
+    if (data != NULL) out.Write(data, sizeof(float) * nComponents * count);
+    else out.WriteZeroes(sizeof(float) * nComponents * count);
+}
+
+bool MapMan::ExportGLTFScene(std::filesystem::path filePath, const ExportOptions& options)
 {
     using namespace nlohmann;
 
-    const RLModel mapModel = _tileGrid.GetModel();
+    // When instancing, only the tiles that are baked go into the map model.
+    std::vector<TileGrid::TileBatch> instancedBatches;
+    std::set<ModelID> bakedShapes;
+    if (options.gpuInstancing)
+    {
+        for (TileGrid::TileBatch& batch : _tileGrid.GetTileBatches())
+        {
+            if (options.bakeCubeTiles && (bakedShapes.count(batch.shape) || _tileGrid.IsCubeShape(batch.shape)))
+                bakedShapes.insert(batch.shape);
+            else
+                instancedBatches.push_back(std::move(batch));
+        }
+    }
+
+    // The model is generated just for this export instead of reusing the editor's preview, so that it doesn't depend on the GPU or the app's settings.
+    const bool chunked = options.chunkSize > 0;
+    std::vector<size_t> meshChunks; // Chunk of each of the map model's meshes
+    std::function<bool(ModelID)> shapeFilter;
+    if (options.gpuInstancing) shapeFilter = [&](ModelID shape) { return bakedShapes.count(shape) > 0; };
+    size_t weldedVertices = 0;
+    RLModel mapModel = _tileGrid.GenerateModel(options.cullFaces, options.greedyMeshing, options.weldVertices, shapeFilter, options.chunkSize, &meshChunks, &weldedVertices);
+    meshChunks.resize(mapModel.meshCount, 0);
+    if (options.weldVertices)
+    {
+        size_t vertexCount = 0;
+        for (int m = 0; m < mapModel.meshCount; ++m) vertexCount += size_t(mapModel.meshes[m].vertexCount);
+        std::cout << "Vertex welding: " << vertexCount + weldedVertices << " -> " << vertexCount << " vertices" << std::endl;
+    }
+
+    // Collision geometry is made of boxes merged from the cube tiles, plus a model of the tiles with any other shape.
+    std::vector<ColliderBox> colliderBoxes;
+    RLModel colliderModel = {};
+    if (options.colliders)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+        const std::vector<uint8_t> cubeCels = _tileGrid.GetCubeCels();
+        colliderBoxes = MergeColliderBoxes(cubeCels, int(_tileGrid.GetWidth()), int(_tileGrid.GetHeight()), int(_tileGrid.GetLength()));
+
+        std::set<ModelID> cubeShapes;
+        for (ModelID shape : _tileGrid.GetUsedIDs().second)
+        {
+            if (_tileGrid.IsCubeShape(shape)) cubeShapes.insert(shape);
+        }
+        colliderModel = _tileGrid.GenerateModel(options.cullFaces, options.greedyMeshing, options.weldVertices, [&](ModelID shape) { return cubeShapes.count(shape) == 0; });
 
-    bool isGLB = (strcmp(TextToLower(filePath.extension().string().c_str()), ".glb") == 0);
-    uint8_t* bufferData = nullptr;
+        std::cout << "Colliders: " << colliderBoxes.size() << " boxes for " << std::count(cubeCels.begin(), cubeCels.end(), 1) << " cube tiles, "
+            << colliderModel.meshCount << " meshes for other shapes ("
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() << " ms)" << std::endl;
+    }
+
+    // Coarser copies of the map for its levels of detail. Level n is downsampled by 2^n, so its chunks are 2^n times smaller in cels
+    // and line up with the full map's, as long as the chunk size is divisible by 2^n.
+    struct DetailLevel
+    {
+        int factor;
+        RLModel model;
+        std::vector<size_t> meshChunks; // Chunk of each of the model's meshes
+    };
+    std::vector<DetailLevel> detailLevels;
+    for (int level = 1; level <= options.lodLevels; ++level)
+    {
+        const int factor = 1 << level;
+        if (chunked && options.chunkSize % factor != 0)
+        {
+            std::cout << "Only " << level - 1 << " levels of detail were made, since the chunk size isn't divisible by " << factor << "." << std::endl;
+            break;
+        }
+        DetailLevel detail = { factor };
+        detail.model = _tileGrid.Downsample(factor).GenerateModel(options.cullFaces, options.greedyMeshing, options.weldVertices,
+            nullptr, chunked ? options.chunkSize / factor : 0, &detail.meshChunks);
+        detail.meshChunks.resize(detail.model.meshCount, 0);
+        detailLevels.push_back(std::move(detail));
+    }
+    if (!detailLevels.empty())
+    {
+        auto countTriangles = [](const RLModel& model)
+            {
+                size_t triangles = 0;
+                for (int m = 0; m < model.meshCount; ++m) triangles += model.meshes[m].triangleCount;
+                return triangles;
+            };
+        std::cout << "Triangles per level of detail: " << countTriangles(mapModel);
+        for (const DetailLevel& detail : detailLevels) std::cout << ", " << countTriangles(detail.model) << " (1/" << detail.factor << ")";
+        std::cout << std::endl;
+    }
+
+    // Compared without TextToLower(), whose shared buffer would be overwritten when several maps are exported at once.
+    std::string extension = filePath.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+    bool isGLB = (extension == ".glb");
 
     bool error = false;
 
@@ -33,24 +352,33 @@ bool MapMan::ExportGLTFScene(std::filesystem::path filePath, bool separateGeomet
         size_t bufferOffset = 0;
 
         // Automates the addition of bufferViews and accessors for a given vertex attribute
-        auto pushVertexAttrib = [&](size_t elemSize, size_t nElems, std::string elemType, int componentType, int target = TARGET_ARRAY_BUFFER)->size_t
+        auto pushVertexAttrib = [&](size_t elemSize, size_t nElems, std::string elemType, int componentType, int target = TARGET_ARRAY_BUFFER, bool normalized = false)->size_t
             {
+                // Vertex attributes have to start every element on a 4 byte boundary, so smaller ones (like quantized normals) are padded.
+                size_t byteStride = 0;
+                if (target == TARGET_ARRAY_BUFFER && elemSize % 4 != 0)
+                {
+                    byteStride = (elemSize + 3) & ~size_t(3);
+                }
+
                 // Always allocate at least one element's worth of data just to avoid errors
-                size_t nBytes = Max(1, elemSize) * nElems;
+                size_t nBytes = Max(1, byteStride ? byteStride : elemSize) * nElems;
 
-                // Pad the offset so that the total offset of the accessor is divisible by the element size
+                // Pad the offset to a multiple of 4, so that the offset of the accessor is divisible by the size of its components
                 // This is a requirement of the gltf specifications
-                size_t padding = bufferOffset % elemSize;
-                bufferOffset += padding;
+                bufferOffset = (bufferOffset + 3) & ~size_t(3);
 
                 size_t newIndex = bufferViews.size();
 
-                bufferViews.push_back({
+                // Data that isn't a vertex attribute or indices, like instance transforms, has no target.
+                json bufferView = {
                     {"buffer", 0},
                     {"byteLength", nBytes},
-                    {"byteOffset", bufferOffset},
-                    {"target", target}
-                    });
+                    {"byteOffset", bufferOffset}
+                };
+                if (target != 0) bufferView["target"] = target;
+                if (byteStride != 0) bufferView["byteStride"] = byteStride;
+                bufferViews.push_back(bufferView);
 
                 accessors.push_back({
                     {"bufferView", bufferViews.size() - 1},
@@ -58,67 +386,491 @@ bool MapMan::ExportGLTFScene(std::filesystem::path filePath, bool separateGeomet
                     {"count", nElems},
                     {"type", elemType}
                     });
+                if (normalized) accessors.back()["normalized"] = true;
 
                 bufferOffset += nBytes;
 
                 return newIndex;
             };
 
+        // Pack the textures into atlases and save them next to the file.
+        // The texture coordinates of each packed texture are then scaled and offset into its part of the atlas.
+        struct AtlasPlacement
+        {
+            int atlas;
+            Vector4 uvTransform;
+        };
+        std::map<TexID, AtlasPlacement> atlasPlacements;
+        std::vector<std::string> atlasFileNames;
+        if (options.atlasTextures)
+        {
+            // Baked faces that repeat their texture, like merged quads, are split up below. The shapes of instanced tiles are written as they are,
+            // so a texture can't be packed if an instanced shape repeats it.
+            std::map<TexID, bool> texturesFit;
+            for (int i = 0; i < mapModel.meshCount; ++i) texturesFit.emplace(mapModel.meshMaterial[i], true);
+            for (const DetailLevel& detail : detailLevels)
+            {
+                for (int i = 0; i < detail.model.meshCount; ++i) texturesFit.emplace(detail.model.meshMaterial[i], true);
+            }
+            for (const TileGrid::TileBatch& batch : instancedBatches)
+            {
+                const RLModel& shapeModel = ModelFromID(batch.shape);
+                bool& fits = texturesFit.emplace(batch.texture, true).first->second;
+                for (int m = 0; m < shapeModel.meshCount; ++m)
+                {
+                    fits = fits && TexCoordsFitUnorm16(shapeModel.meshes[m].texcoords, shapeModel.meshes[m].vertexCount);
+                }
+            }
+
+            std::vector<TexID> packedTextures;
+            std::vector<RLImage> images;
+            int repeatingTextures = 0;
+            for (const auto& [texture, fits] : texturesFit)
+            {
+                if (!fits)
+                {
+                    ++repeatingTextures;
+                    continue;
+                }
+                RLImage image = LoadImage(PathFromTexID(texture).string().c_str());
+                if (image.data == NULL) continue;
+                packedTextures.push_back(texture);
+                images.push_back(image);
+            }
+            if (repeatingTextures > 0)
+            {
+                std::cout << repeatingTextures << " textures are repeated by the shapes of instanced tiles and were left out of the atlases." << std::endl;
+            }
+
+            std::vector<AtlasEntry> entries;
+            std::vector<RLImage> atlases = PackTextureAtlases(images, ATLAS_MAX_SIZE, ATLAS_PADDING, entries);
+            for (RLImage& image : images) UnloadImage(image);
+            for (size_t t = 0; t < packedTextures.size(); ++t)
+            {
+                const AtlasEntry& entry = entries[t];
+                if (entry.atlas < 0)
+                {
+                    std::cout << "Texture " << PathFromTexID(packedTextures[t]).generic_string() << " is too large for an atlas." << std::endl;
+                    continue;
+                }
+                const RLImage& atlas = atlases[entry.atlas];
+                atlasPlacements[packedTextures[t]] = AtlasPlacement{ entry.atlas, Vector4{
+                    float(entry.width) / atlas.width, float(entry.height) / atlas.height, float(entry.x) / atlas.width, float(entry.y) / atlas.height } };
+            }
+
+            bool saved = true;
+            for (size_t a = 0; a < atlases.size(); ++a)
+            {
+                atlasFileNames.push_back(filePath.stem().string() + "_atlas" + std::to_string(a) + ".png");
+                saved = ExportImage(atlases[a], (filePath.parent_path() / atlasFileNames.back()).string().c_str()) && saved;
+                UnloadImage(atlases[a]);
+            }
+            if (!saved) throw std::runtime_error("Could not save the texture atlases.");
+
+            // The atlases are sampled without repeating, so faces that repeat a packed texture are cut into pieces that each cover it once.
+            // Meshes can't be split in place, so the model's mesh arrays are rebuilt with the pieces instead.
+            size_t splitMeshes = 0;
+            auto wrapPackedTexCoords = [&](RLModel& model, std::vector<size_t>& chunks)
+                {
+                    std::vector<RLMesh> newMeshes;
+                    std::vector<int> newMaterials;
+                    std::vector<size_t> newChunks;
+                    for (int i = 0; i < model.meshCount; ++i)
+                    {
+                        const RLMesh& mesh = model.meshes[i];
+                        if (atlasPlacements.count(model.meshMaterial[i]) == 0 || TexCoordsFitUnorm16(mesh.texcoords, mesh.vertexCount))
+                        {
+                            newMeshes.push_back(mesh);
+                            newMaterials.push_back(model.meshMaterial[i]);
+                            newChunks.push_back(chunks[i]);
+                            continue;
+                        }
+
+                        ++splitMeshes;
+                        for (RLMesh& piece : WrapMeshTexCoords(mesh, MODEL_MESH_MAX_VERTICES))
+                        {
+                            if (options.weldVertices) WeldMeshVertices(piece);
+                            newMeshes.push_back(piece);
+                            newMaterials.push_back(model.meshMaterial[i]);
+                            newChunks.push_back(chunks[i]);
+                        }
+                        UnloadMesh(mesh);
+                    }
+
+                    RL_FREE(model.meshes);
+                    RL_FREE(model.meshMaterial);
+                    model.meshCount = int(newMeshes.size());
+                    model.meshes = SAFE_MALLOC(RLMesh, newMeshes.size());
+                    memcpy(model.meshes, newMeshes.data(), newMeshes.size() * sizeof(RLMesh));
+                    model.meshMaterial = SAFE_MALLOC(int, newMaterials.size());
+                    memcpy(model.meshMaterial, newMaterials.data(), newMaterials.size() * sizeof(int));
+                    chunks = std::move(newChunks);
+                };
+            wrapPackedTexCoords(mapModel, meshChunks);
+            for (DetailLevel& detail : detailLevels) wrapPackedTexCoords(detail.model, detail.meshChunks);
+            if (splitMeshes > 0)
+            {
+                std::cout << splitMeshes << " meshes were cut where their textures repeat, so that they can use the atlases." << std::endl;
+            }
+        }
+        auto uvTransformFor = [&](TexID texture)
+            {
+                auto placement = atlasPlacements.find(texture);
+                return (placement != atlasPlacements.end()) ? placement->second.uvTransform : UV_IDENTITY;
+            };
+
+        // The models were generated just for this export, so their meshes are reordered for the vertex cache in place.
+        if (options.optimizeVertexCache)
+        {
+            MeshCacheStats totalBefore, totalAfter;
+            std::vector<RLModel*> bakedModels = { &mapModel };
+            for (DetailLevel& detail : detailLevels) bakedModels.push_back(&detail.model);
+            for (RLModel* model : bakedModels)
+            {
+                std::vector<MeshCacheStats> statsBefore(model->meshCount), statsAfter(model->meshCount);
+                WorkerPool::ParallelFor(model->meshCount, [&](size_t m)
+                    {
+                        RLMesh& mesh = model->meshes[m];
+                        statsBefore[m] = AnalyzeMeshVertexCache(mesh);
+                        OptimizeMeshVertexCache(mesh);
+                        OptimizeMeshVertexFetch(mesh);
+                        statsAfter[m] = AnalyzeMeshVertexCache(mesh);
+                    });
+                for (int m = 0; m < model->meshCount; ++m)
+                {
+                    totalBefore += statsBefore[m];
+                    totalAfter += statsAfter[m];
+                }
+            }
+            std::cout << "Vertex cache optimization: ACMR " << totalBefore.ACMR() << " -> " << totalAfter.ACMR()
+                << ", ATVR " << totalBefore.ATVR() << " -> " << totalAfter.ATVR() << std::endl;
+        }
+
+        // There is a material for each texture that isn't in an atlas, and one for each atlas.
+        struct ExportMaterial
+        {
+            TexID texture;
+            int atlas;
+        };
+        std::vector<ExportMaterial> exportMaterials;
+        auto materialFor = [&](TexID texture)->int
+            {
+                auto placement = atlasPlacements.find(texture);
+                const int atlas = (placement != atlasPlacements.end()) ? placement->second.atlas : -1;
+                for (size_t m = 0; m < exportMaterials.size(); ++m)
+                {
+                    if (atlas >= 0 ? exportMaterials[m].atlas == atlas : (exportMaterials[m].atlas < 0 && exportMaterials[m].texture == texture)) return int(m);
+                }
+                exportMaterials.push_back(ExportMaterial{ texture, atlas });
+                return int(exportMaterials.size() - 1);
+            };
+
+        // Baked positions are quantized onto one grid per model, so that the primitives of the map (or of one of its levels) line up exactly.
+        auto quantizationFor = [&](const RLModel& model)
+            {
+                PositionQuantization posQuant = { Vector3{ 0.0f, 0.0f, 0.0f }, 1.0f };
+                if (!options.quantize || model.meshCount == 0) return posQuant;
+
+                Vector3 minPos = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+                Vector3 maxPos = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+                for (int i = 0; i < model.meshCount; ++i)
+                {
+                    for (int j = 0; j < model.meshes[i].vertexCount * 3; j += 3)
+                    {
+                        minPos = Vector3Min(minPos, Vector3{ model.meshes[i].vertices[j], model.meshes[i].vertices[j + 1], model.meshes[i].vertices[j + 2] });
+                        maxPos = Vector3Max(maxPos, Vector3{ model.meshes[i].vertices[j], model.meshes[i].vertices[j + 1], model.meshes[i].vertices[j + 2] });
+                    }
+                }
+                return ChoosePositionQuantization(minPos, maxPos, _tileGrid.GetSpacing());
+            };
+        const PositionQuantization posQuant = quantizationFor(mapModel);
+        // Sets the transform that decodes quantized positions on the node that holds baked geometry
+        auto setQuantizationTransform = [&](json& node)
+            {
+                if (!options.quantize) return;
+                node["translation"] = { posQuant.offset.x, posQuant.offset.y, posQuant.offset.z };
+                node["scale"] = { posQuant.step, posQuant.step, posQuant.step };
+            };
+
+        // Baked geometry is written in primitives made of a model's meshes, grouped by chunk and material. Meshes are joined as long as the primitive's indices can reach all of its vertices.
+        // Generated meshes never exceed MODEL_MESH_MAX_VERTICES vertices, so with 32-bit indices the meshes of a material (in a chunk) are joined back into one primitive.
+        struct ExportPrimitive
+        {
+            const RLModel* model;
+            PositionQuantization posQuant;
+            int material;
+            size_t chunk;
+            std::vector<int> meshes;
+            size_t vertexCount, indexCount;
+            size_t posBufferIdx, uvBufferIdx, normBufferIdx, indicesIdx;
+            bool quantizedTexCoords;
+        };
+        const size_t indexSize = options.use32BitIndices ? sizeof(uint32_t) : sizeof(unsigned short);
+        const int indexType = options.use32BitIndices ? COMP_TYPE_UINT : COMP_TYPE_USHORT;
+
+        // Groups the meshes of the model into primitives, and pushes their buffers and accessors. Their JSON objects are added to `primJsons`.
+        auto makePrimitives = [&](const RLModel& model, const std::vector<size_t>& chunks, const PositionQuantization& quant, std::vector<ExportPrimitive>& prims, std::vector<json>& primJsons)
+            {
+                const RLMesh* exportMeshes = model.meshes;
+                std::vector<int> meshMaterials(model.meshCount);
+                std::vector<int> meshOrder;
+                for (int i = 0; i < model.meshCount; ++i)
+                {
+                    meshMaterials[i] = materialFor(model.meshMaterial[i]);
+                    if (exportMeshes[i].indices != NULL && exportMeshes[i].vertices != NULL && exportMeshes[i].vertexCount > 0) meshOrder.push_back(i);
+                }
+                // Textures in the same atlas aren't next to each other in the model
+                std::stable_sort(meshOrder.begin(), meshOrder.end(), [&](int a, int b)
+                    {
+                        return std::make_pair(chunks[a], meshMaterials[a]) < std::make_pair(chunks[b], meshMaterials[b]);
+                    });
+                const size_t firstPrim = prims.size();
+                for (int i : meshOrder)
+                {
+                    if (prims.size() == firstPrim || prims.back().material != meshMaterials[i] || prims.back().chunk != chunks[i]
+                        || (!options.use32BitIndices && prims.back().vertexCount + exportMeshes[i].vertexCount > MODEL_MESH_MAX_VERTICES))
+                    {
+                        prims.push_back(ExportPrimitive{ &model, quant, meshMaterials[i], chunks[i], {}, 0, 0 });
+                    }
+                    prims.back().meshes.push_back(i);
+                    prims.back().vertexCount += exportMeshes[i].vertexCount;
+                    prims.back().indexCount += exportMeshes[i].triangleCount * 3;
+                }
+
+                // Make primitives and buffer related objects for each group of meshes
+                for (size_t p = firstPrim; p < prims.size(); ++p)
+                {
+                    ExportPrimitive& prim = prims[p];
+
+                    // Calculate max and min component values. Required only for position buffer.
+                    float minX, minY, minZ;
+                    minX = minY = minZ = std::numeric_limits<float>::max();
+                    float maxX, maxY, maxZ;
+                    maxX = maxY = maxZ = std::numeric_limits<float>::lowest();
+                    for (int i : prim.meshes)
+                    {
+                        for (int j = 0; j < exportMeshes[i].vertexCount * 3; j += 3)
+                            minX = Minf(exportMeshes[i].vertices[j], minX), maxX = Maxf(exportMeshes[i].vertices[j], maxX);
+                        for (int j = 1; j < exportMeshes[i].vertexCount * 3; j += 3)
+                            minY = Minf(exportMeshes[i].vertices[j], minY), maxY = Maxf(exportMeshes[i].vertices[j], maxY);
+                        for (int j = 2; j < exportMeshes[i].vertexCount * 3; j += 3)
+                            minZ = Minf(exportMeshes[i].vertices[j], minZ), maxZ = Maxf(exportMeshes[i].vertices[j], maxZ);
+                    }
+
+                    // Push buffers, accessors, etc.
+                    if (options.quantize)
+                    {
+                        // The bounds of quantized positions are given in their quantized units
+                        prim.posBufferIdx = pushVertexAttrib(sizeof(uint16_t) * 3, prim.vertexCount, "VEC3", COMP_TYPE_USHORT);
+                        accessors[prim.posBufferIdx]["min"] = { lroundf((minX - quant.offset.x) / quant.step), lroundf((minY - quant.offset.y) / quant.step), lroundf((minZ - quant.offset.z) / quant.step) };
+                        accessors[prim.posBufferIdx]["max"] = { lroundf((maxX - quant.offset.x) / quant.step), lroundf((maxY - quant.offset.y) / quant.step), lroundf((maxZ - quant.offset.z) / quant.step) };
+                    }
+                    else
+                    {
+                        prim.posBufferIdx = pushVertexAttrib(sizeof(float) * 3, prim.vertexCount, "VEC3", COMP_TYPE_FLOAT);
+                        accessors[prim.posBufferIdx]["min"] = { minX, minY, minZ };
+                        accessors[prim.posBufferIdx]["max"] = { maxX, maxY, maxZ };
+                    }
+
+                    prim.quantizedTexCoords = options.quantize;
+                    for (int i : prim.meshes)
+                    {
+                        if (!TexCoordsFitUnorm16(exportMeshes[i].texcoords, exportMeshes[i].vertexCount)) prim.quantizedTexCoords = false;
+                    }
+                    if (prim.quantizedTexCoords)
+                        prim.uvBufferIdx = pushVertexAttrib(sizeof(uint16_t) * 2, prim.vertexCount, "VEC2", COMP_TYPE_USHORT, TARGET_ARRAY_BUFFER, true);
+                    else
+                        prim.uvBufferIdx = pushVertexAttrib(sizeof(float) * 2, prim.vertexCount, "VEC2", COMP_TYPE_FLOAT);
+
+                    if (options.quantize)
+                        prim.normBufferIdx = pushVertexAttrib(sizeof(int8_t) * 3, prim.vertexCount, "VEC3", COMP_TYPE_BYTE, TARGET_ARRAY_BUFFER, true);
+                    else
+                        prim.normBufferIdx = pushVertexAttrib(sizeof(float) * 3, prim.vertexCount, "VEC3", COMP_TYPE_FLOAT);
+                    prim.indicesIdx = pushVertexAttrib(indexSize, prim.indexCount, "SCALAR", indexType, TARGET_ELEMENT_BUFFER);
+
+                    // Push primitive
+                    primJsons.push_back({
+                        {"mode", PRIMITIVE_MODE_TRIANGLES},
+                        {"attributes", {
+                            {"POSITION", prim.posBufferIdx},
+                            {"TEXCOORD_0", prim.uvBufferIdx},
+                            {"NORMAL", prim.normBufferIdx}
+                        }},
+                        {"indices", prim.indicesIdx},
+                        {"material", prim.material}
+                        });
+                }
+            };
+
+        std::vector<ExportPrimitive> exportPrims;
         std::vector<json> mapPrims;
-        mapPrims.reserve(mapModel.meshCount);
-
-        // Make primitives and buffer related objects for each mesh of the map
-        for (int i = 0; i < mapModel.meshCount; ++i)
-        {
-            // Calculate max and min component values. Required only for position buffer.
-            float minX, minY, minZ;
-            minX = minY = minZ = std::numeric_limits<float>::max();
-            float maxX, maxY, maxZ;
-            maxX = maxY = maxZ = std::numeric_limits<float>::min();
-            for (int j = 0; j < mapModel.meshes[i].vertexCount * 3; j += 3)
-                minX = Minf(mapModel.meshes[i].vertices[j], minX), maxX = Maxf(mapModel.meshes[i].vertices[j], maxX);
-            for (int j = 1; j < mapModel.meshes[i].vertexCount * 3; j += 3)
-                minY = Minf(mapModel.meshes[i].vertices[j], minY), maxY = Maxf(mapModel.meshes[i].vertices[j], maxY);
-            for (int j = 2; j < mapModel.meshes[i].vertexCount * 3; j += 3)
-                minZ = Minf(mapModel.meshes[i].vertices[j], minZ), maxZ = Maxf(mapModel.meshes[i].vertices[j], maxZ);
-
-            // Push buffers, accessors, etc.
-            size_t posBufferIdx = pushVertexAttrib(sizeof(float) * 3, mapModel.meshes[i].vertexCount, "VEC3", COMP_TYPE_FLOAT);
-            accessors[posBufferIdx]["min"] = { minX, minY, minZ };
-            accessors[posBufferIdx]["max"] = { maxX, maxY, maxZ };
-
-            size_t uvBufferIdx = pushVertexAttrib(sizeof(float) * 2, mapModel.meshes[i].vertexCount, "VEC2", COMP_TYPE_FLOAT);
-            size_t normBufferIdx = pushVertexAttrib(sizeof(float) * 3, mapModel.meshes[i].vertexCount, "VEC3", COMP_TYPE_FLOAT);
-            size_t indicesIdx = pushVertexAttrib(sizeof(unsigned short), mapModel.meshes[i].triangleCount * 3, "SCALAR", COMP_TYPE_USHORT, TARGET_ELEMENT_BUFFER);
-
-            // Push primitive
-            mapPrims.push_back({
+        makePrimitives(mapModel, meshChunks, posQuant, exportPrims, mapPrims);
+
+        // Instanced tiles get a mesh for each combination of shape and texture, with a primitive for each of the shape's meshes.
+        // The transforms of the tiles are written as the TRANSLATION and ROTATION attributes of EXT_mesh_gpu_instancing.
+        // Their positions are small enough that they are always written as floats, but normals and texture coordinates can be quantized.
+        struct InstancedPrimitive
+        {
+            const RLMesh* mesh;
+            size_t posBufferIdx, uvBufferIdx, normBufferIdx, indicesIdx;
+            bool quantizedTexCoords;
+            Vector4 uvTransform;
+        };
+        // When the map is split into chunks, each chunk gets its own group of instances for every mesh.
+        struct InstanceGroup
+        {
+            size_t chunk;
+            std::vector<float> translations, rotations;
+            size_t translationIdx, rotationIdx;
+        };
+        struct InstancedMesh
+        {
+            std::vector<InstancedPrimitive> prims;
+            std::vector<InstanceGroup> groups;
+        };
+        std::vector<InstancedMesh> instancedMeshes(instancedBatches.size());
+        std::vector<std::pair<size_t, json>> instancedNodes; // Node for each group of instances, with its chunk
+        for (size_t b = 0; b < instancedBatches.size(); ++b)
+        {
+            const TileGrid::TileBatch& batch = instancedBatches[b];
+            InstancedMesh& instancedMesh = instancedMeshes[b];
+            const RLModel& shapeModel = ModelFromID(batch.shape);
+            const int material = materialFor(batch.texture);
+
+            json mesh = { {"primitives", json::array()} };
+            for (int m = 0; m < shapeModel.meshCount; ++m)
+            {
+                const RLMesh& shapeMesh = shapeModel.meshes[m];
+                if (shapeMesh.indices == NULL || shapeMesh.vertices == NULL) continue;
+
+                InstancedPrimitive prim = { &shapeMesh };
+                prim.uvTransform = uvTransformFor(batch.texture);
+                prim.posBufferIdx = pushVertexAttrib(sizeof(float) * 3, shapeMesh.vertexCount, "VEC3", COMP_TYPE_FLOAT);
+                SetPositionBounds(accessors[prim.posBufferIdx], shapeMesh);
+                prim.quantizedTexCoords = options.quantize && TexCoordsFitUnorm16(shapeMesh.texcoords, shapeMesh.vertexCount);
+                if (prim.quantizedTexCoords)
+                    prim.uvBufferIdx = pushVertexAttrib(sizeof(uint16_t) * 2, shapeMesh.vertexCount, "VEC2", COMP_TYPE_USHORT, TARGET_ARRAY_BUFFER, true);
+                else
+                    prim.uvBufferIdx = pushVertexAttrib(sizeof(float) * 2, shapeMesh.vertexCount, "VEC2", COMP_TYPE_FLOAT);
+                if (options.quantize)
+                    prim.normBufferIdx = pushVertexAttrib(sizeof(int8_t) * 3, shapeMesh.vertexCount, "VEC3", COMP_TYPE_BYTE, TARGET_ARRAY_BUFFER, true);
+                else
+                    prim.normBufferIdx = pushVertexAttrib(sizeof(float) * 3, shapeMesh.vertexCount, "VEC3", COMP_TYPE_FLOAT);
+                prim.indicesIdx = pushVertexAttrib(sizeof(unsigned short), shapeMesh.triangleCount * 3, "SCALAR", COMP_TYPE_USHORT, TARGET_ELEMENT_BUFFER);
+                instancedMesh.prims.push_back(prim);
+
+                mesh["primitives"].push_back({
+                    {"mode", PRIMITIVE_MODE_TRIANGLES},
+                    {"attributes", {
+                        {"POSITION", prim.posBufferIdx},
+                        {"TEXCOORD_0", prim.uvBufferIdx},
+                        {"NORMAL", prim.normBufferIdx}
+                    }},
+                    {"indices", prim.indicesIdx},
+                    {"material", material}
+                    });
+            }
+            if (instancedMesh.prims.empty()) continue;
+
+            // Each tile's transform is split into the translation to the center of its cel and the rotation of its orientation
+            std::map<size_t, InstanceGroup> groups;
+            for (const TileInstance& instance : batch.instances)
+            {
+                const size_t chunk = chunked ? _tileGrid.ModelChunkIndex(instance, options.chunkSize) : 0;
+                InstanceGroup& group = groups[chunk];
+                group.chunk = chunk;
+
+                const Matrix transform = UnpackTileInstance(instance, _tileGrid.GetSpacing());
+                const Quaternion rotation = RotationToQuaternion(transform);
+                group.translations.insert(group.translations.end(), { transform.m12, transform.m13, transform.m14 });
+                group.rotations.insert(group.rotations.end(), { rotation.x, rotation.y, rotation.z, rotation.w });
+            }
+
+            const std::string nodeName = PathFromModelID(batch.shape).stem().string() + "_" + PathFromTexID(batch.texture).stem().string();
+            for (auto& [chunk, group] : groups)
+            {
+                group.translationIdx = pushVertexAttrib(sizeof(float) * 3, group.translations.size() / 3, "VEC3", COMP_TYPE_FLOAT, 0);
+                group.rotationIdx = pushVertexAttrib(sizeof(float) * 4, group.rotations.size() / 4, "VEC4", COMP_TYPE_FLOAT, 0);
+                instancedNodes.push_back({ chunk, {
+                    {"name", nodeName},
+                    {"mesh", meshes.size()},
+                    {"extensions", {
+                        {"EXT_mesh_gpu_instancing", {
+                            {"attributes", {
+                                {"TRANSLATION", group.translationIdx},
+                                {"ROTATION", group.rotationIdx}
+                            }}
+                        }}
+                    }}
+                    } });
+                instancedMesh.groups.push_back(std::move(group));
+            }
+            meshes.push_back(mesh);
+        }
+
+        // Collider meshes only have positions and indices. Their primitives have no material, since they aren't meant to be drawn.
+        struct ColliderPrimitive
+        {
+            const RLMesh* mesh;
+            size_t posBufferIdx, indicesIdx;
+        };
+        std::vector<ColliderPrimitive> colliderPrims;
+        json colliderMesh = { {"primitives", json::array()} };
+        for (int m = 0; m < colliderModel.meshCount; ++m)
+        {
+            const RLMesh& mesh = colliderModel.meshes[m];
+            if (mesh.indices == NULL || mesh.vertices == NULL || mesh.vertexCount == 0) continue;
+
+            ColliderPrimitive prim = { &mesh };
+            prim.posBufferIdx = pushVertexAttrib(sizeof(float) * 3, mesh.vertexCount, "VEC3", COMP_TYPE_FLOAT);
+            SetPositionBounds(accessors[prim.posBufferIdx], mesh);
+            prim.indicesIdx = pushVertexAttrib(sizeof(unsigned short), mesh.triangleCount * 3, "SCALAR", COMP_TYPE_USHORT, TARGET_ELEMENT_BUFFER);
+            colliderPrims.push_back(prim);
+
+            colliderMesh["primitives"].push_back({
                 {"mode", PRIMITIVE_MODE_TRIANGLES},
-                {"attributes", {
-                    {"POSITION", posBufferIdx},
-                    {"TEXCOORD_0", uvBufferIdx},
-                    {"NORMAL", normBufferIdx}
-                }},
-                {"indices", indicesIdx},
-                {"material", i}
+                {"attributes", { {"POSITION", prim.posBufferIdx} }},
+                {"indices", prim.indicesIdx}
                 });
         }
 
+        // The levels of detail are written like the map, each with its own quantization grid since coarse cels can reach past the bounds of the map.
+        std::vector<PositionQuantization> detailQuants(detailLevels.size());
+        std::vector<std::vector<ExportPrimitive>> detailPrims(detailLevels.size());
+        std::vector<std::map<size_t, std::vector<json>>> detailChunkPrims(detailLevels.size()); // Primitives of each chunk, for each level
+        for (size_t l = 0; l < detailLevels.size(); ++l)
+        {
+            detailQuants[l] = quantizationFor(detailLevels[l].model);
+            std::vector<json> levelPrims;
+            makePrimitives(detailLevels[l].model, detailLevels[l].meshChunks, detailQuants[l], detailPrims[l], levelPrims);
+            for (size_t p = 0; p < levelPrims.size(); ++p) detailChunkPrims[l][detailPrims[l][p].chunk].push_back(std::move(levelPrims[p]));
+        }
+
         // Indices for child nodes of the root map node
         std::vector<int> mapNodeChildren;
 
         // Encode materials and textures
-        for (int m = 0; m < mapModel.meshCount; ++m)
+        for (int m = 0; m < exportMaterials.size(); ++m)
         {
-            // RLImage paths in the GLTF are relative to the file.
-            std::filesystem::path imagePath = PathFromTexID(mapModel.meshMaterial[m]);
-            std::filesystem::path imagePathFromGLTF = std::filesystem::relative(
-                std::filesystem::current_path() / imagePath,
-                std::filesystem::current_path() / filePath.parent_path());
+            // RLImage paths in the GLTF are relative to the file. Atlases are saved right next to it.
+            std::filesystem::path imagePath = PathFromTexID(exportMaterials[m].texture);
+            std::string imageUri, materialName;
+            if (exportMaterials[m].atlas >= 0)
+            {
+                imageUri = atlasFileNames[exportMaterials[m].atlas];
+                materialName = "atlas_" + std::to_string(exportMaterials[m].atlas);
+            }
+            else
+            {
+                std::filesystem::path imagePathFromGLTF = std::filesystem::relative(
+                    std::filesystem::current_path() / imagePath,
+                    std::filesystem::current_path() / filePath.parent_path());
+                imageUri = materialName = imagePathFromGLTF.generic_string();
+            }
 
             // Push material
             materials.push_back({
-                {"name", imagePathFromGLTF.generic_string()},
+                {"name", materialName},
                 {"pbrMetallicRoughness", {
                     {"baseColorTexture", {
                         {"index", textures.size()},
@@ -132,18 +884,19 @@ bool MapMan::ExportGLTFScene(std::filesystem::path filePath, bool separateGeomet
             // Push texture
             textures.push_back({
                 {"source", textures.size()},
-                {"sampler", 0}
+                {"sampler", (exportMaterials[m].atlas >= 0) ? 1 : 0}
                 });
 
             // Push image
             images.push_back({
-                {"uri", imagePathFromGLTF.generic_string()}
+                {"uri", imageUri}
                 });
 
-            if (separateGeometry)
+            if (options.separateGeometry && !chunked)
             {
                 // When separate geometry is enabled, each material gets its own node containing its portion of the map geometry
-                std::string nodeName = std::filesystem::relative(std::filesystem::current_path() / imagePath, std::filesystem::current_path() / GetApp()->GetTexturesDir()).generic_string();
+                std::string nodeName = (exportMaterials[m].atlas >= 0) ? materialName
+                    : std::filesystem::relative(std::filesystem::current_path() / imagePath, std::filesystem::current_path() / options.texturesDir).generic_string();
 
                 // The compiler thinks this is necessary, apparently... 9_9
                 char* nodeNameBuffer = (char*)_alloca((nodeName.length() + 1) * sizeof(char));
@@ -157,11 +910,16 @@ bool MapMan::ExportGLTFScene(std::filesystem::path filePath, bool separateGeomet
                 free(newNodeName);
                 free(finalNodeName);
 
-                json mesh = {
-                    {"primitives", {mapPrims[m]}}
-                };
+                json mesh = { {"primitives", json::array()} };
+                for (size_t p = 0; p < exportPrims.size(); ++p)
+                {
+                    if (exportPrims[p].material == m) mesh["primitives"].push_back(mapPrims[p]);
+                }
+                // Textures that are only used by instanced tiles have no baked geometry
+                if (mesh["primitives"].empty()) continue;
 
                 materialNode["mesh"] = meshes.size();
+                setQuantizationTransform(materialNode);
                 meshes.push_back(mesh);
 
                 mapNodeChildren.push_back(nodes.size());
@@ -175,51 +933,142 @@ bool MapMan::ExportGLTFScene(std::filesystem::path filePath, bool separateGeomet
             {"wrapS", WRAP_REPEAT},
             {"wrapT", WRAP_REPEAT},
             });
+        // Atlases have their own sampler: mipmaps would blend neighboring textures once they got smaller than the padding between them,
+        // and the texture coordinates of their faces never leave their part of the atlas, so there is nothing to repeat.
+        if (!atlasFileNames.empty())
+        {
+            samplers.push_back({
+                {"magFilter", FILTER_NEAREST},
+                {"minFilter", FILTER_NEAREST},
+                {"wrapS", WRAP_CLAMP_TO_EDGE},
+                {"wrapT", WRAP_CLAMP_TO_EDGE},
+                });
+        }
 
         // Everything is stored in one buffer, to make it compatible with .GLB
         size_t bufferSize = bufferOffset;
         json buffer = { {"byteLength", bufferSize} };
 
-        bufferData = SAFE_MALLOC(uint8_t, bufferSize);
+        // The contents of the buffer aren't put together in memory. Instead, each buffer view gets a function that writes
+        // its data straight from the meshes to the file, once the JSON has been written.
+        std::vector<std::function<void(BufferStream&)>> viewWriters(bufferViews.size());
+        auto setPrimitiveWriters = [&](const ExportPrimitive& prim)
+            {
+                viewWriters[prim.posBufferIdx] = [&](BufferStream& out)
+                    {
+                        for (int i : prim.meshes)
+                        {
+                            const RLMesh& mesh = prim.model->meshes[i];
+                            if (options.quantize) WriteQuantizedPositions(out, mesh.vertices, mesh.vertexCount, prim.posQuant);
+                            else WriteAttribute(out, mesh.vertices, mesh.vertexCount, 3);
+                        }
+                    };
+                viewWriters[prim.uvBufferIdx] = [&](BufferStream& out)
+                    {
+                        for (int i : prim.meshes)
+                        {
+                            const RLMesh& mesh = prim.model->meshes[i];
+                            WriteTexCoords(out, mesh.texcoords, mesh.vertexCount, prim.quantizedTexCoords, uvTransformFor(prim.model->meshMaterial[i]));
+                        }
+                    };
+                viewWriters[prim.normBufferIdx] = [&](BufferStream& out)
+                    {
+                        for (int i : prim.meshes)
+                        {
+                            const RLMesh& mesh = prim.model->meshes[i];
+                            if (options.quantize) WriteQuantizedNormals(out, mesh.normals, mesh.vertexCount);
+                            else WriteAttribute(out, mesh.normals, mesh.vertexCount, 3);
+                        }
+                    };
+                viewWriters[prim.indicesIdx] = [&](BufferStream& out)
+                    {
+                        // Index of the first vertex of each mesh within the primitive
+                        uint32_t vertexBase = 0;
+                        for (int i : prim.meshes)
+                        {
+                            const RLMesh& mesh = prim.model->meshes[i];
+                            const size_t indexCount = mesh.triangleCount * 3;
+                            if (options.use32BitIndices)
+                            {
+                                for (size_t j = 0; j < indexCount; ++j)
+                                {
+                                    uint32_t index = vertexBase + mesh.indices[j];
+                                    out.Write(&index, sizeof(uint32_t));
+                                }
+                            }
+                            else if (vertexBase == 0)
+                            {
+                                out.Write(mesh.indices, indexCount * sizeof(unsigned short));
+                            }
+                            else
+                            {
+                                for (size_t j = 0; j < indexCount; ++j)
+                                {
+                                    unsigned short index = (unsigned short)(vertexBase + mesh.indices[j]);
+                                    out.Write(&index, sizeof(unsigned short));
+                                }
+                            }
+                            vertexBase += mesh.vertexCount;
+                        }
+                    };
+            };
+        for (const ExportPrimitive& prim : exportPrims) setPrimitiveWriters(prim);
+        for (const std::vector<ExportPrimitive>& prims : detailPrims)
+        {
+            for (const ExportPrimitive& prim : prims) setPrimitiveWriters(prim);
+        }
 
-        // Fill the buffer with the mesh data, now that we know all of the counts and offsets.
-        for (int i = 0; i < mapModel.meshCount; ++i)
+        // Shapes without normals or texture coordinates get zeroes, like they do in the baked geometry
+        for (const InstancedMesh& instancedMesh : instancedMeshes)
         {
-            // Position
-            {
-                const json& bufferView = bufferViews[i * 4 + 0];
-                size_t byteOffset = (size_t)bufferView["byteOffset"];
-                size_t byteLength = (size_t)bufferView["byteLength"];
-                memcpy(&bufferData[byteOffset], mapModel.meshes[i].vertices, byteLength);
-            }
-            // Tex coord
+            for (const InstancedPrimitive& prim : instancedMesh.prims)
             {
-                const json& bufferView = bufferViews[i * 4 + 1];
-                size_t byteOffset = (size_t)bufferView["byteOffset"];
-                size_t byteLength = (size_t)bufferView["byteLength"];
-                memcpy(&bufferData[byteOffset], mapModel.meshes[i].texcoords, byteLength);
+                const RLMesh& mesh = *prim.mesh;
+                viewWriters[prim.posBufferIdx] = [&](BufferStream& out) { WriteAttribute(out, mesh.vertices, mesh.vertexCount, 3); };
+                viewWriters[prim.uvBufferIdx] = [&](BufferStream& out) { WriteTexCoords(out, mesh.texcoords, mesh.vertexCount, prim.quantizedTexCoords, prim.uvTransform); };
+                viewWriters[prim.normBufferIdx] = [&](BufferStream& out)
+                    {
+                        if (options.quantize) WriteQuantizedNormals(out, mesh.normals, mesh.vertexCount);
+                        else WriteAttribute(out, mesh.normals, mesh.vertexCount, 3);
+                    };
+                viewWriters[prim.indicesIdx] = [&](BufferStream& out) { out.Write(mesh.indices, mesh.triangleCount * 3 * sizeof(unsigned short)); };
             }
-            // Normals
+            for (const InstanceGroup& group : instancedMesh.groups)
             {
-                const json& bufferView = bufferViews[i * 4 + 2];
-                size_t byteOffset = (size_t)bufferView["byteOffset"];
-                size_t byteLength = (size_t)bufferView["byteLength"];
-                memcpy(&bufferData[byteOffset], mapModel.meshes[i].normals, byteLength);
-            }
-            // Indices
-            {
-                const json& bufferView = bufferViews[i * 4 + 3];
-                size_t byteOffset = (size_t)bufferView["byteOffset"];
-                size_t byteLength = (size_t)bufferView["byteLength"];
-                memcpy(&bufferData[byteOffset], mapModel.meshes[i].indices, byteLength);
+                viewWriters[group.translationIdx] = [&](BufferStream& out) { out.Write(group.translations.data(), group.translations.size() * sizeof(float)); };
+                viewWriters[group.rotationIdx] = [&](BufferStream& out) { out.Write(group.rotations.data(), group.rotations.size() * sizeof(float)); };
             }
         }
 
+        for (const ColliderPrimitive& prim : colliderPrims)
+        {
+            const RLMesh& mesh = *prim.mesh;
+            viewWriters[prim.posBufferIdx] = [&](BufferStream& out) { out.Write(mesh.vertices, mesh.vertexCount * 3 * sizeof(float)); };
+            viewWriters[prim.indicesIdx] = [&](BufferStream& out) { out.Write(mesh.indices, mesh.triangleCount * 3 * sizeof(unsigned short)); };
+        }
+
+        // Writes the whole buffer in order, with zeroes for the padding between the buffer views
+        auto writeBuffer = [&](BufferStream& out)
+            {
+                for (size_t v = 0; v < bufferViews.size(); ++v)
+                {
+                    const size_t viewOffset = (size_t)bufferViews[v]["byteOffset"];
+                    out.WriteZeroes(viewOffset - out.GetSize());
+                    if (viewWriters[v]) viewWriters[v](out);
+                    // Empty views still take up one element
+                    out.WriteZeroes(viewOffset + (size_t)bufferViews[v]["byteLength"] - out.GetSize());
+                }
+                out.WriteZeroes(bufferSize - out.GetSize());
+                out.Finish();
+            };
+
+        // For plain .gltf files, the buffer is encoded into a base64 data string in the JSON.
+        // The string is streamed into the file in place of this placeholder, so that it is never held in memory.
+        // For .glb, the buffer will be written to the end of the binary file later.
+        static const std::string URI_PLACEHOLDER = "@BUFFER_DATA@";
         if (!isGLB)
         {
-            // For plain .gltf files, simply encode the buffer into a base64 data string.
-            // For .glb, the buffer will be written to the end of the binary file later.
-            buffer["uri"] = std::string("data:application/octet-stream;base64,") + base64::encode(bufferData, bufferSize);
+            buffer["uri"] = URI_PLACEHOLDER;
         }
 
         buffers.push_back(buffer);
@@ -229,22 +1078,167 @@ bool MapMan::ExportGLTFScene(std::filesystem::path filePath, bool separateGeomet
         // Indices for each root node, because the scene object requires a list of them.
         std::vector<int> rootNodes;
 
-        if (!separateGeometry)
+        // Gives a node the baked primitives and the instanced tiles that belong to it. The instances become its children, after any existing ones.
+        // The instances can't be children of a node with the quantization transform, so in that case the geometry gets its own node.
+        auto fillNode = [&](json& node, std::vector<int>& children, const std::vector<json>& prims, std::vector<json>& instanceNodes)
+            {
+                if (!prims.empty())
+                {
+                    json geometryMesh = { {"primitives", prims} };
+                    if (options.quantize && !instanceNodes.empty())
+                    {
+                        json geometryNode = { {"name", node["name"].get<std::string>() + "_geometry"}, {"mesh", meshes.size()} };
+                        setQuantizationTransform(geometryNode);
+                        children.push_back(nodes.size());
+                        nodes.push_back(geometryNode);
+                    }
+                    else
+                    {
+                        node["mesh"] = meshes.size();
+                        setQuantizationTransform(node);
+                    }
+                    meshes.push_back(geometryMesh);
+                }
+
+                for (json& instanceNode : instanceNodes)
+                {
+                    children.push_back(nodes.size());
+                    nodes.push_back(std::move(instanceNode));
+                }
+                if (!children.empty()) node["children"] = children;
+            };
+
+        // Gives a node the MSFT_lod extension, with a node for each coarser level of the chunk. The level nodes aren't part of the scene.
+        // Levels are scaled up by their factor, since the downsampled grids keep the map's cel spacing, on top of decoding their quantized positions.
+        // The coarsest level is never culled.
+        auto addDetailLevels = [&](json& node, size_t chunk)
+            {
+                if (detailLevels.empty()) return;
+                std::vector<size_t> levelNodes;
+                std::vector<float> screenCoverages = { LOD_BASE_SCREEN_COVERAGE };
+                for (size_t l = 0; l < detailLevels.size(); ++l)
+                {
+                    const float factor = float(detailLevels[l].factor);
+                    const PositionQuantization& quant = detailQuants[l];
+                    json levelNode = {
+                        {"name", node["name"].get<std::string>() + "_lod" + std::to_string(l + 1)},
+                        {"scale", { factor * quant.step, factor * quant.step, factor * quant.step }}
+                    };
+                    if (options.quantize) levelNode["translation"] = { factor * quant.offset.x, factor * quant.offset.y, factor * quant.offset.z };
+                    // A level can be empty where the downsampled tiles didn't reach a majority
+                    auto prims = detailChunkPrims[l].find(chunk);
+                    if (prims != detailChunkPrims[l].end())
+                    {
+                        levelNode["mesh"] = meshes.size();
+                        meshes.push_back({ {"primitives", prims->second} });
+                    }
+                    levelNodes.push_back(nodes.size());
+                    nodes.push_back(levelNode);
+                    screenCoverages.push_back((l + 1 < detailLevels.size()) ? LOD_BASE_SCREEN_COVERAGE / (factor * factor) : 0.0f);
+                }
+                node["extensions"]["MSFT_lod"] = { {"ids", levelNodes} };
+                node["extras"]["MSFT_screencoverage"] = screenCoverages;
+            };
+
+        // Sort the geometry and instances into their chunks. Without chunks, everything is in chunk 0.
+        std::map<size_t, std::pair<std::vector<json>, std::vector<json>>> chunkContents;
+        for (size_t p = 0; p < exportPrims.size(); ++p)
         {
-            // Assign all whole map geometry to the map node
-            mapNode["mesh"] = meshes.size();
-            meshes.push_back({
-                {"primitives", mapPrims}
-                });
+            chunkContents[exportPrims[p].chunk].first.push_back(mapPrims[p]);
         }
-        else
+        for (auto& [chunk, instancedNode] : instancedNodes)
         {
+            chunkContents[chunk].second.push_back(std::move(instancedNode));
+        }
+
+        if (chunked)
+        {
+            // Each chunk with any tiles in it gets its own node, so that it can be culled and streamed separately.
+            // The bounds of its primitives only cover the chunk.
+            const std::array<int, 3> chunkCounts = _tileGrid.GetModelChunkCounts(options.chunkSize);
+            for (auto& [chunk, contents] : chunkContents)
+            {
+                const int chunkX = int(chunk % chunkCounts[0]);
+                const int chunkY = int(chunk / (size_t(chunkCounts[0]) * chunkCounts[2]));
+                const int chunkZ = int((chunk / chunkCounts[0]) % chunkCounts[2]);
+                json chunkNode = {
+                    {"name", "chunk_" + std::to_string(chunkX) + "_" + std::to_string(chunkY) + "_" + std::to_string(chunkZ)},
+                    {"extras", { {"chunk", { chunkX, chunkY, chunkZ }}, {"chunkSize", options.chunkSize} }}
+                };
+                std::vector<int> chunkChildren;
+                fillNode(chunkNode, chunkChildren, contents.first, contents.second);
+                addDetailLevels(chunkNode, chunk);
+
+                mapNodeChildren.push_back(nodes.size());
+                nodes.push_back(chunkNode);
+            }
             mapNode["children"] = mapNodeChildren;
+
+            // The visible sets cover every chunk, including empty ones without nodes, since the camera can be anywhere
+            if (options.chunkVisibility)
+            {
+                const ChunkVisibility visibility = ComputeChunkVisibility(_tileGrid, options.chunkSize);
+                json sets = json::array();
+                size_t visibleCount = 0;
+                for (size_t c = 0; c < visibility.chunkCount; ++c)
+                {
+                    sets.push_back(base64::encode(visibility.GetRow(c), visibility.rowSize));
+                    for (size_t other = 0; other < visibility.chunkCount; ++other) visibleCount += visibility.IsVisible(c, other);
+                }
+                mapNode["extras"]["pvs"] = {
+                    {"chunkSize", options.chunkSize},
+                    {"chunkCounts", { chunkCounts[0], chunkCounts[1], chunkCounts[2] }},
+                    {"sets", sets}
+                };
+                std::cout << "Chunk visibility: " << float(visibleCount) / float(Max(1, int(visibility.chunkCount))) << " of "
+                    << visibility.chunkCount << " chunks visible on average" << std::endl;
+            }
+        }
+        else
+        {
+            // The map node gets all of the geometry, unless it was already given to the material nodes
+            auto& [prims, instanceNodes] = chunkContents[0];
+            fillNode(mapNode, mapNodeChildren, options.separateGeometry ? std::vector<json>() : prims, instanceNodes);
+            addDetailLevels(mapNode, 0);
         }
 
         rootNodes.push_back(nodes.size());
         nodes.push_back(mapNode);
 
+        // Colliders go under their own root node. Their "collider" extra tells what kind of shape they are.
+        // Box nodes have no mesh: they stand for a cube with sides of 1 centered on the node, which their scale stretches over the box's cels.
+        if (options.colliders)
+        {
+            json collisionNode = { {"name", "collision"} };
+            std::vector<int> collisionChildren;
+            const float spacing = _tileGrid.GetSpacing();
+            for (size_t b = 0; b < colliderBoxes.size(); ++b)
+            {
+                const ColliderBox& box = colliderBoxes[b];
+                collisionChildren.push_back(nodes.size());
+                nodes.push_back({
+                    {"name", "box_" + std::to_string(b)},
+                    {"translation", { (box.x + box.width * 0.5f) * spacing, (box.y + box.height * 0.5f) * spacing, (box.z + box.length * 0.5f) * spacing }},
+                    {"scale", { box.width * spacing, box.height * spacing, box.length * spacing }},
+                    {"extras", { {"collider", "box"} }}
+                    });
+            }
+            if (!colliderPrims.empty())
+            {
+                collisionChildren.push_back(nodes.size());
+                nodes.push_back({
+                    {"name", "collision_mesh"},
+                    {"mesh", meshes.size()},
+                    {"extras", { {"collider", "mesh"} }}
+                    });
+                meshes.push_back(colliderMesh);
+            }
+            if (!collisionChildren.empty()) collisionNode["children"] = collisionChildren;
+
+            rootNodes.push_back(nodes.size());
+            nodes.push_back(collisionNode);
+        }
+
         // Add entities as nodes
         for (const Ent& ent : _entGrid.GetEntList())
         {
@@ -295,6 +1289,22 @@ bool MapMan::ExportGLTFScene(std::filesystem::path filePath, bool separateGeomet
             {"images", images},
             {"samplers", samplers}
         };
+        std::vector<std::string> extensionsUsed;
+        if (!instancedNodes.empty())
+        {
+            extensionsUsed.push_back("EXT_mesh_gpu_instancing");
+        }
+        if (!detailLevels.empty())
+        {
+            extensionsUsed.push_back("MSFT_lod");
+        }
+        if (options.quantize)
+        {
+            // Readers that don't support quantized attributes can't load the geometry at all, so this one is required.
+            extensionsUsed.push_back("KHR_mesh_quantization");
+            jsonData["extensionsRequired"] = { "KHR_mesh_quantization" };
+        }
+        if (!extensionsUsed.empty()) jsonData["extensionsUsed"] = extensionsUsed;
 
         // Write JSON to file
         std::ofstream file(filePath, isGLB ? std::ios::binary : std::ios::out);
@@ -302,11 +1312,12 @@ bool MapMan::ExportGLTFScene(std::filesystem::path filePath, bool separateGeomet
         uint32_t jsonLength = jsonString.size();
 
         // Number of bytes of padding needed for the JSON chunk
-        int jsonPadding = (int)(ceilf((float)(jsonLength) / 4.0f) * 4.0f) - (int)jsonLength;
+        // (Computed with integers, since floats can't represent the sizes of large buffers exactly.)
+        int jsonPadding = int((4 - jsonLength % 4) % 4);
         uint32_t jsonChunkSize = jsonLength + jsonPadding + 8;
 
         // Number of bytes of padding needed for the BIN chunk
-        int binPadding = (int)(ceilf((bufferSize) / 4.0f) * 4.0f) - (int)bufferSize;
+        int binPadding = int((4 - bufferSize % 4) % 4);
         uint32_t binChunkSize = (uint32_t)(bufferSize + binPadding + 8);
 
 #define WRITE_BIN(data) file.write(reinterpret_cast<const char*>(&data), sizeof(data))
@@ -333,7 +1344,20 @@ bool MapMan::ExportGLTFScene(std::filesystem::path filePath, bool separateGeomet
             WRITE_BIN(GLB_JSON);
         }
 
-        file.write(jsonString.c_str(), jsonLength);
+        if (isGLB)
+        {
+            file.write(jsonString.c_str(), jsonLength);
+        }
+        else
+        {
+            // Stream the buffer's base64 data into the JSON where its placeholder is
+            size_t placeholderPos = jsonString.find(URI_PLACEHOLDER);
+            file.write(jsonString.c_str(), placeholderPos);
+            file << "data:application/octet-stream;base64,";
+            BufferStream stream(file, true);
+            writeBuffer(stream);
+            file.write(jsonString.c_str() + placeholderPos + URI_PLACEHOLDER.size(), jsonString.size() - placeholderPos - URI_PLACEHOLDER.size());
+        }
 
         if (isGLB)
         {
@@ -347,7 +1371,8 @@ bool MapMan::ExportGLTFScene(std::filesystem::path filePath, bool separateGeomet
             WRITE_BIN(GLB_BIN);
 
             // Write data
-            file.write(reinterpret_cast<char*>(bufferData), bufferSize);
+            BufferStream stream(file, false);
+            writeBuffer(stream);
 
             // Pad with zeroes to align with 4 byte boundary
             for (int p = 0; p < binPadding; ++p)
@@ -366,6 +1391,8 @@ bool MapMan::ExportGLTFScene(std::filesystem::path filePath, bool separateGeomet
         error = true;
     }
 
-    if (bufferData != nullptr) free(bufferData);
+    UnloadModel(mapModel);
+    if (options.colliders) UnloadModel(colliderModel);
+    for (DetailLevel& detail : detailLevels) UnloadModel(detail.model);
     return !error;
 }
\ No newline at end of file
@@ -1,10 +1,9 @@
 #include "stdafx.h"
 #include "MapMan.h"
-#include "EditorApp.h"
 
 #define TE2_FORMAT_ERR "ERROR: This is not a properly formatted .ti file."
 
-bool MapMan::LoadTE2Map(std::filesystem::path filePath)
+bool MapMan::LoadTE2Map(std::filesystem::path filePath, std::filesystem::path texturesDir, std::filesystem::path shapesDir)
 {
     _undoHistory.clear();
     _redoHistory.clear();
@@ -16,9 +15,9 @@ bool MapMan::LoadTE2Map(std::filesystem::path filePath)
         _textureList.clear();
 
         _modelList.clear();
-        ModelID cubeID = GetOrAddModelID(std::filesystem::path(GetApp()->GetShapesDir()) / "cube.obj");
-        ModelID panelID = GetOrAddModelID(std::filesystem::path(GetApp()->GetShapesDir()) / "panel.obj");
-        ModelID barsID = GetOrAddModelID(std::filesystem::path(GetApp()->GetShapesDir()) / "bars.obj");
+        ModelID cubeID = GetOrAddModelID(shapesDir / "cube.obj");
+        ModelID panelID = GetOrAddModelID(shapesDir / "panel.obj");
+        ModelID barsID = GetOrAddModelID(shapesDir / "bars.obj");
 
         // Since the .ti format has no specific grid size (or origin), we must keep track of the map's extents manually.
         int minX, minZ, maxX, maxZ;
@@ -59,7 +58,7 @@ bool MapMan::LoadTE2Map(std::filesystem::path filePath)
             Tile tile(NO_MODEL, 0, NO_TEX, 0);
 
             std::string textureName = tokens[3] + ".png";
-            std::filesystem::path texturePath = std::filesystem::path(GetApp()->GetTexturesDir()) / textureName;
+            std::filesystem::path texturePath = texturesDir / textureName;
 
             int flag = atoi(tokens[4].c_str());
             int link = atoi(tokens[5].c_str());
@@ -200,7 +199,7 @@ bool MapMan::LoadTE2Map(std::filesystem::path filePath)
 
             std::string textureName = tokens[5];
             textureName.append(".png");
-            tile.texture = GetOrAddTexID(std::filesystem::path(GetApp()->GetTexturesDir()) / textureName);
+            tile.texture = GetOrAddTexID(texturesDir / textureName);
 
             bool isCeiling = (bool)atoi(tokens[4].c_str());
 
@@ -212,7 +211,7 @@ bool MapMan::LoadTE2Map(std::filesystem::path filePath)
         size_t length = (maxZ - minZ) + 1;
 
         // Fill tile grid
-        _tileGrid = TileGrid(this, width, 3, length, TILE_SPACING_DEFAULT, Tile());
+        _tileGrid = TileGrid(this, width, 3, length, TILE_SPACING_DEFAULT, Tile(), GridStorage::CHUNKED);
         for (const auto [i, j, k, tile] : tilesToAdd)
         {
             // Add the tiles to the grid, offset from the top left corner
@@ -387,7 +386,7 @@ bool MapMan::LoadTE2Map(std::filesystem::path filePath)
                 break;
             }
 
-            if (ent.display == Ent::DisplayMode::SPRITE && ent.texture->GetTexture().id == Assets::GetMissingTexture().id)
+            if (ent.display == Ent::DisplayMode::SPRITE && ent.texture->IsMissing())
             {
                 // Default to sphere if the sprite didn't load
                 ent.display = Ent::DisplayMode::SPHERE;
@@ -39,6 +39,46 @@ void main()
 
 )SHADER";
 
+// Instanced variant that takes each tile's grid coordinates and orientation index instead of a matrix.
+const char* MAP_SHADER_PACKED_V_SRC = R"SHADER(
+
+#version 330
+
+// Input vertex attributes
+in vec3 vertexPosition;
+in vec2 vertexTexCoord;
+in vec3 vertexNormal;
+in vec4 vertexColor;
+
+in vec4 instanceData; // Grid coordinates in xyz, orientation index in w
+
+// Input uniform values
+uniform mat4 mvp;
+uniform float celSpacing;
+uniform vec3 orientationAxes[72]; // The transformed x, y, and z axes of each of the 24 orientations
+
+// Output vertex attributes (to fragment shader)
+out vec2 fragTexCoord;
+out vec4 fragColor;
+out vec3 fragNormal;
+
+void main()
+{
+    int o = int(instanceData.w) * 3;
+    mat3 orientation = mat3(orientationAxes[o], orientationAxes[o + 1], orientationAxes[o + 2]);
+
+    // Send vertex attributes to fragment shader
+    fragTexCoord = vertexTexCoord;
+    fragColor = vertexColor;
+    fragNormal = normalize(orientation*vertexNormal);
+
+    // Rotate the vertex, then move it to the center of the instance's grid cel
+    vec3 position = (orientation*vertexPosition) + ((instanceData.xyz + 0.5)*celSpacing);
+    gl_Position = mvp*vec4(position, 1.0);
+}
+
+)SHADER";
+
 const char* MAP_SHADER_V_SRC = R"SHADER(
 
 #version 330
@@ -23,17 +23,25 @@
 
 #include <iomanip>
 #include <numbers>
+#include <numeric>
 #include <atomic>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <exception>
 #include <array>
 #include <fstream>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <span>
 #include <stack>
 #include <iostream>
 #include <string_view>
 #include <filesystem>
+#include <random>
+#include <chrono>
 
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
@@ -0,0 +1,209 @@
+#include "stdafx.h"
+#include "Core.h"
+#include "MapMan.h"
+#include "Assets.h"
+#include "WorkerPool.h"
+//-----------------------------------------------------------------------------
+#if defined(_MSC_VER)
+#	pragma comment( lib, "Engine.lib" )
+#endif
+//-----------------------------------------------------------------------------
+// Converts .te3 and .ti maps into .glb files (or .gltf or .temap) without a window or a graphics context,
+// so that a build pipeline can export all of its levels at once. The maps are converted in parallel, one per thread.
+// Paths inside of the maps are relative to the working directory, so this should run from the same directory as the editor.
+//-----------------------------------------------------------------------------
+struct CliOptions final
+{
+	std::filesystem::path inputPath;
+	std::filesystem::path outputDir;
+	std::string format = ".glb";
+	std::filesystem::path texturesDir = "../Data/Textures/Tiles/"; // For .ti maps
+	std::filesystem::path shapesDir = "../Data/Models/Shapes/";    // For .ti maps
+	int threads = 0; // 0 uses every core
+	MapMan::ExportOptions exportOptions;
+};
+//-----------------------------------------------------------------------------
+static void printUsage()
+{
+	std::cout
+		<< "Usage: blockeditor-cli [options] <map file or directory> <output directory>\n"
+		<< "Converts every .te3 and .ti map in the directory and its subdirectories.\n"
+		<< "\n"
+		<< "  --format <glb|gltf|temap>  Output format (default: glb)\n"
+		<< "  --threads <n>              Number of maps converted at once (default: one per core)\n"
+		<< "  --textures <dir>           Texture directory for .ti maps (default: ../Data/Textures/Tiles/)\n"
+		<< "  --shapes <dir>             Shape directory for .ti maps (default: ../Data/Models/Shapes/)\n"
+		<< "  --no-cull                  Keep the faces hidden between tiles\n"
+		<< "  --greedy                   Merge coplanar faces into larger quads\n"
+		<< "  --no-weld                  Don't merge duplicate vertices\n"
+		<< "  --separate                 Put each texture's geometry in its own node\n"
+		<< "  --indices32                Write 32-bit indices\n"
+		<< "  --optimize                 Reorder meshes for the vertex cache\n"
+		<< "  --instancing               Place non-cube tiles with EXT_mesh_gpu_instancing\n"
+		<< "  --instance-cubes           Also instance cube tiles instead of baking them\n"
+		<< "  --quantize                 Quantize vertex attributes with KHR_mesh_quantization\n"
+		<< "  --atlas                    Pack tile textures into atlases\n"
+		<< "  --chunk-size <n>           Split the map into chunks of n cels\n"
+		<< "  --pvs                      Write potentially visible sets of chunks\n"
+		<< "  --colliders                Add box and mesh colliders\n"
+		<< "  --lod <n>                  Number of coarser levels of detail\n";
+}
+//-----------------------------------------------------------------------------
+// Fills in `options` from the command line arguments, returning false if they are invalid.
+static bool parseArguments(int argc, char* argv[], CliOptions& options)
+{
+	std::vector<std::filesystem::path> positional;
+	for (int a = 1; a < argc; ++a)
+	{
+		const std::string arg = argv[a];
+		// Returns the argument after the current one, or null if there isn't one.
+		auto value = [&]() -> const char* { return (a + 1 < argc) ? argv[++a] : nullptr; };
+		MapMan::ExportOptions& exp = options.exportOptions;
+
+		if (arg == "--format" || arg == "--threads" || arg == "--textures" || arg == "--shapes" || arg == "--chunk-size" || arg == "--lod")
+		{
+			const char* v = value();
+			if (!v)
+			{
+				std::cerr << "ERROR: " << arg << " needs a value." << std::endl;
+				return false;
+			}
+			if (arg == "--format") options.format = std::string(".") + v;
+			else if (arg == "--threads") options.threads = atoi(v);
+			else if (arg == "--textures") options.texturesDir = v;
+			else if (arg == "--shapes") options.shapesDir = v;
+			else if (arg == "--chunk-size") exp.chunkSize = Max(0, atoi(v));
+			else if (arg == "--lod") exp.lodLevels = Max(0, atoi(v));
+		}
+		else if (arg == "--no-cull") exp.cullFaces = false;
+		else if (arg == "--greedy") exp.greedyMeshing = true;
+		else if (arg == "--no-weld") exp.weldVertices = false;
+		else if (arg == "--separate") exp.separateGeometry = true;
+		else if (arg == "--indices32") exp.use32BitIndices = true;
+		else if (arg == "--optimize") exp.optimizeVertexCache = true;
+		else if (arg == "--instancing") exp.gpuInstancing = true;
+		else if (arg == "--instance-cubes") exp.bakeCubeTiles = false;
+		else if (arg == "--quantize") exp.quantize = true;
+		else if (arg == "--atlas") exp.atlasTextures = true;
+		else if (arg == "--pvs") exp.chunkVisibility = true;
+		else if (arg == "--colliders") exp.colliders = true;
+		else if (arg.starts_with("--"))
+		{
+			std::cerr << "ERROR: Unknown option " << arg << "." << std::endl;
+			return false;
+		}
+		else positional.push_back(arg);
+	}
+
+	if (positional.size() != 2)
+	{
+		return false;
+	}
+	if (options.format != ".glb" && options.format != ".gltf" && options.format != ".temap")
+	{
+		std::cerr << "ERROR: Unknown format " << options.format.substr(1) << "." << std::endl;
+		return false;
+	}
+	options.inputPath = positional[0];
+	options.outputDir = positional[1];
+	options.exportOptions.texturesDir = options.texturesDir;
+	return true;
+}
+//-----------------------------------------------------------------------------
+// Loads the map at `input` and exports it to `output`, returning false on error. Safe to call from several threads at once.
+static bool convertMap(const std::filesystem::path& input, const std::filesystem::path& output, const CliOptions& options)
+{
+	// Each map has its own manager, and its assets come from the shared cache.
+	auto map = std::make_unique<MapMan>();
+	const bool loaded = (input.extension() == ".te3") ? map->LoadTE3Map(input) : map->LoadTE2Map(input, options.texturesDir, options.shapesDir);
+	if (!loaded)
+	{
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(output.parent_path(), error);
+	if (error)
+	{
+		return false;
+	}
+
+	return (options.format == ".temap") ? map->ExportBakedMap(output, options.exportOptions) : map->ExportGLTFScene(output, options.exportOptions);
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	CliOptions options;
+	if (!parseArguments(argc, argv, options))
+	{
+		printUsage();
+		return 2;
+	}
+
+	// Nothing is drawn, so no window or GPU is needed.
+	Assets::SetHeadless(true);
+	if (options.threads > 0) WorkerPool::SetThreadCount(options.threads);
+
+	// Find the maps. Each output keeps the map's path relative to the input directory.
+	auto isMap = [](const std::filesystem::path& path) { return path.extension() == ".te3" || path.extension() == ".ti"; };
+	std::vector<std::pair<std::filesystem::path, std::filesystem::path>> jobs;
+	std::error_code error;
+	if (std::filesystem::is_directory(options.inputPath, error))
+	{
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(options.inputPath, error))
+		{
+			const std::filesystem::path& path = entry.path();
+			if (!entry.is_regular_file() || !isMap(path)) continue;
+			std::filesystem::path output = options.outputDir / std::filesystem::relative(path, options.inputPath);
+			jobs.emplace_back(path, output.replace_extension(options.format));
+		}
+		std::sort(jobs.begin(), jobs.end());
+	}
+	else if (std::filesystem::is_regular_file(options.inputPath, error) && isMap(options.inputPath))
+	{
+		jobs.emplace_back(options.inputPath, (options.outputDir / options.inputPath.filename()).replace_extension(options.format));
+	}
+	if (error || jobs.empty())
+	{
+		std::cerr << "ERROR: No .te3 or .ti maps found at " << options.inputPath << "." << std::endl;
+		return 1;
+	}
+
+	// The maps are spread across the worker threads. Loops inside of the exporter run on the thread of their map.
+	std::cout << "Converting " << jobs.size() << " maps on " << WorkerPool::GetThreadCount() << " threads." << std::endl;
+	const auto startTime = std::chrono::steady_clock::now();
+	std::mutex outputMutex;
+	std::atomic<size_t> failures = 0;
+	WorkerPool::ParallelFor(jobs.size(), [&](size_t j)
+		{
+			const auto& [input, output] = jobs[j];
+			const auto mapStartTime = std::chrono::steady_clock::now();
+			bool converted = false;
+			try
+			{
+				converted = convertMap(input, output, options);
+			}
+			catch (const std::exception& e)
+			{
+				std::lock_guard<std::mutex> lock(outputMutex);
+				std::cerr << e.what() << std::endl;
+			}
+			if (!converted) ++failures;
+
+			std::lock_guard<std::mutex> lock(outputMutex);
+			if (converted)
+			{
+				std::cout << "Converted " << input.generic_string() << " -> " << output.generic_string() << " ("
+					<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mapStartTime).count() << " ms)" << std::endl;
+			}
+			else
+			{
+				std::cerr << "ERROR: Failed to convert " << input.generic_string() << "." << std::endl;
+			}
+		});
+
+	std::cout << "Converted " << jobs.size() - failures << " of " << jobs.size() << " maps in "
+		<< std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() << " s." << std::endl;
+	return (failures > 0) ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
\ No newline at end of file
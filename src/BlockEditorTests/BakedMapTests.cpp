@@ -0,0 +1,240 @@
+#include "stdafx.h"
+#include "TestMaps.h"
+#include "TestGLTF.h"
+#include "Test.h"
+#include "BakedMap.h"
+
+// A baked map file read into memory that is aligned for BakedMapView.
+struct TestBakedFile final
+{
+	std::vector<uint64_t> words;
+	size_t size = 0;
+
+	const void* GetData() const { return words.data(); }
+	uint8_t* GetBytes() { return reinterpret_cast<uint8_t*>(words.data()); }
+	template<class T>
+	T& At(uint64_t offset) { return *reinterpret_cast<T*>(GetBytes() + offset); }
+};
+
+static bool ReadTestBakedFile(const std::filesystem::path& path, TestBakedFile& baked)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return false;
+	baked.size = size_t(std::filesystem::file_size(path));
+	baked.words.assign((baked.size + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+	return bool(file.read(reinterpret_cast<char*>(baked.words.data()), baked.size));
+}
+
+// Fills a small map with tiles and a couple of entities, and exports it as a baked map.
+static void ExportTestBakedMap(MapMan& map, const TestAssets& assets, const std::filesystem::path& path, int chunkSize)
+{
+	FillTestMapMan(map, assets, 40, 6, 40, 24, 0.25f);
+	Ent sphere(1.5f);
+	sphere.color = Color{ 10, 20, 30, 255 };
+	sphere.yaw = 90;
+	sphere.properties["name"] = "sphere";
+	MapManInspector::Ents(map).AddEnt(3, 2, 4, sphere);
+	Ent other(0.5f);
+	other.pitch = 45;
+	MapManInspector::Ents(map).AddEnt(30, 1, 20, other);
+
+	MapMan::ExportOptions options;
+	options.chunkSize = chunkSize;
+	options.weldVertices = true;
+	options.optimizeVertexCache = true;
+	REQUIRE(map.ExportBakedMap(path, options));
+}
+
+TEST_CASE(BakedMapRoundTrips)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	const std::filesystem::path dir = MakeTestOutputDir("BakedMapRoundTrips");
+
+	for (int chunkSize : { 0, 16 })
+	{
+		const std::filesystem::path path = dir / ("map" + std::to_string(chunkSize) + ".temap");
+		ExportTestBakedMap(*mapMan, assets, path, chunkSize);
+		TestBakedFile file;
+		REQUIRE(ReadTestBakedFile(path, file));
+		BakedMapView view;
+		REQUIRE(view.Open(file.GetData(), file.size));
+
+		TileGrid& tiles = MapManInspector::Tiles(*mapMan);
+		const BakedMapHeader& header = view.GetHeader();
+		CHECK(header.spacing == tiles.GetSpacing());
+		CHECK(header.chunkSize == chunkSize);
+		const std::array<int, 3> counts = (chunkSize > 0) ? tiles.GetModelChunkCounts(chunkSize) : std::array<int, 3>{ 1, 1, 1 };
+		for (int c = 0; c < 3; ++c) CHECK(header.chunkCounts[c] == counts[c]);
+
+		// The triangles of each texture come back as they were generated
+		std::map<std::filesystem::path, std::vector<TriangleKey>> bakedTriangles;
+		std::set<std::array<int32_t, 3>> chunkCoords;
+		for (const BakedChunk& chunk : view.GetChunks())
+		{
+			CHECK(chunkCoords.insert({ chunk.coords[0], chunk.coords[1], chunk.coords[2] }).second);
+			for (int c = 0; c < 3; ++c) CHECK(chunk.coords[c] >= 0 && chunk.coords[c] < counts[c]);
+
+			uint32_t previousMaterial = 0;
+			for (const BakedRange& range : view.GetRanges(chunk))
+			{
+				CHECK(range.material >= previousMaterial);
+				previousMaterial = range.material;
+
+				const std::span<const BakedVertex> vertices = view.GetVertices(range);
+				const std::span<const uint16_t> indices = view.GetIndices(range);
+				REQUIRE(indices.size() % 3 == 0);
+				for (const BakedVertex& vertex : vertices)
+				{
+					for (int c = 0; c < 3; ++c) CHECK(vertex.position[c] >= chunk.boundsMin[c] && vertex.position[c] <= chunk.boundsMax[c]);
+				}
+
+				const std::filesystem::path texture = std::filesystem::weakly_canonical(path.parent_path() / std::string(view.GetTexturePath(view.GetMaterials()[range.material])));
+				std::vector<TriangleKey>& list = bakedTriangles[texture];
+				for (size_t i = 0; i < indices.size(); i += 3)
+				{
+					Vector3 corners[3];
+					for (int c = 0; c < 3; ++c)
+					{
+						REQUIRE(indices[i + c] < vertices.size());
+						const float* position = vertices[indices[i + c]].position;
+						corners[c] = Vector3{ position[0], position[1], position[2] };
+					}
+					list.push_back(MakeTriangleKey(corners));
+				}
+			}
+		}
+		for (auto& [texture, list] : bakedTriangles) std::sort(list.begin(), list.end());
+
+		RLModel model = tiles.GenerateModel(true, false, true, nullptr, chunkSize);
+		std::map<std::filesystem::path, std::vector<TriangleKey>> modelTriangles;
+		for (auto& [texture, list] : TrianglesByTexture(model)) modelTriangles[std::filesystem::weakly_canonical(mapMan->PathFromTexID(texture))] = std::move(list);
+		UnloadModel(model);
+		CHECK(bakedTriangles == modelTriangles);
+		CHECK(view.GetMaterials().size() == modelTriangles.size());
+
+		// Entities keep their placement, looks and properties
+		REQUIRE(view.GetEntities().size() == 2);
+		bool foundSphere = false;
+		for (const BakedEntity& entity : view.GetEntities())
+		{
+			const nlohmann::json properties = nlohmann::json::parse(view.GetProperties(entity));
+			if (entity.radius != 1.5f) continue;
+			foundSphere = true;
+			const Vector3 position = MapManInspector::Ents(*mapMan).GridToWorldPos(Vector3{ 3.0f, 2.0f, 4.0f }, true);
+			CHECK(entity.position[0] == position.x && entity.position[1] == position.y && entity.position[2] == position.z);
+			CHECK(entity.yaw == 90.0f && entity.pitch == 0.0f);
+			CHECK(entity.color[0] == 10 && entity.color[1] == 20 && entity.color[2] == 30 && entity.color[3] == 255);
+			CHECK(properties.value("name", "") == "sphere");
+		}
+		CHECK(foundSphere);
+	}
+}
+
+TEST_CASE(BakedMapRejectsDamagedFiles)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	const std::filesystem::path dir = MakeTestOutputDir("BakedMapRejectsDamagedFiles");
+	const std::filesystem::path path = dir / "map.temap";
+	ExportTestBakedMap(*mapMan, assets, path, 16);
+	TestBakedFile original;
+	REQUIRE(ReadTestBakedFile(path, original));
+
+	BakedMapView view;
+	REQUIRE(view.Open(original.GetData(), original.size));
+	const BakedMapHeader header = view.GetHeader();
+	REQUIRE(header.chunkCount > 0 && header.rangeCount > 0 && header.materialCount > 0 && header.entityCount > 0);
+
+	// Cutting the file off anywhere before the end of its last table or blob loses part of it
+	uint64_t end = header.stringsOffset + header.stringsSize;
+	for (const BakedChunk& chunk : view.GetChunks())
+	{
+		for (const BakedRange& range : view.GetRanges(chunk))
+		{
+			end = std::max({ end, range.vertexOffset + range.vertexCount * sizeof(BakedVertex), range.indexOffset + range.indexCount * sizeof(uint16_t) });
+		}
+	}
+	for (uint64_t size : { uint64_t(0), uint64_t(sizeof(BakedMapHeader) - 1), header.chunkTableOffset + 1, header.rangeTableOffset + 1,
+		header.materialTableOffset + 1, header.entityTableOffset + 1, header.stringsOffset + 1, end - 1 })
+	{
+		CHECK(!view.Open(original.GetData(), size_t(size)));
+	}
+	CHECK(view.Open(original.GetData(), size_t(end)));
+
+	// Each change is made to a fresh copy of the file
+	const uint64_t firstRange = header.rangeTableOffset, firstMaterial = header.materialTableOffset, firstEntity = header.entityTableOffset;
+	const std::vector<std::pair<const char*, std::function<void(TestBakedFile&)>>> damages = {
+		{ "magic", [](TestBakedFile& file) { file.At<BakedMapHeader>(0).magic ^= 1; } },
+		{ "version", [](TestBakedFile& file) { file.At<BakedMapHeader>(0).version = BAKED_MAP_VERSION + 1; } },
+		{ "vertex stride", [](TestBakedFile& file) { file.At<BakedMapHeader>(0).vertexStride = 24; } },
+		{ "index size", [](TestBakedFile& file) { file.At<BakedMapHeader>(0).indexSize = 4; } },
+		{ "chunk table past the end", [&](TestBakedFile& file) { file.At<BakedMapHeader>(0).chunkTableOffset = (file.size + BAKED_MAP_ALIGNMENT - 1) / BAKED_MAP_ALIGNMENT * BAKED_MAP_ALIGNMENT; } },
+		{ "unaligned range table", [](TestBakedFile& file) { file.At<BakedMapHeader>(0).rangeTableOffset += 4; } },
+		{ "huge entity count", [](TestBakedFile& file) { file.At<BakedMapHeader>(0).entityCount = UINT32_MAX; } },
+		{ "strings past the end", [&](TestBakedFile& file) { file.At<BakedMapHeader>(0).stringsSize = file.size; } },
+		{ "chunk ranges past the table", [&](TestBakedFile& file) { file.At<BakedChunk>(header.chunkTableOffset).firstRange = header.rangeCount; } },
+		{ "missing material", [&](TestBakedFile& file) { file.At<BakedRange>(firstRange).material = header.materialCount; } },
+		{ "vertices past the end", [&](TestBakedFile& file) { file.At<BakedRange>(firstRange).vertexCount = UINT32_MAX; } },
+		{ "unaligned indices", [&](TestBakedFile& file) { file.At<BakedRange>(firstRange).indexOffset += 2; } },
+		{ "indices past the end", [&](TestBakedFile& file) { file.At<BakedRange>(firstRange).indexOffset = UINT64_MAX - (BAKED_MAP_ALIGNMENT - 1); } },
+		{ "texture path past the strings", [&](TestBakedFile& file) { file.At<BakedMaterial>(firstMaterial).textureLength = uint32_t(header.stringsSize) + 1; } },
+		{ "properties past the strings", [&](TestBakedFile& file) { file.At<BakedEntity>(firstEntity).propertiesOffset = uint32_t(header.stringsSize); file.At<BakedEntity>(firstEntity).propertiesLength = 1; } },
+	};
+	for (const auto& [name, damage] : damages)
+	{
+		TestBakedFile file = original;
+		damage(file);
+		const bool opened = view.Open(file.GetData(), file.size);
+		if (opened) std::cout << "    Opened a file with a bad " << name << std::endl;
+		CHECK(!opened);
+	}
+
+	// The data has to be aligned for the tables to be read in place
+	std::vector<uint64_t> shifted(original.words.size() + 1, 0);
+	memcpy(reinterpret_cast<uint8_t*>(shifted.data()) + 4, original.GetData(), original.size);
+	CHECK(!view.Open(reinterpret_cast<uint8_t*>(shifted.data()) + 4, original.size));
+	CHECK(!view.Open(nullptr, original.size));
+}
+
+BENCHMARK(BakedMapLoadTime)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	FillTestMapMan(*mapMan, assets, 128, 8, 128, 9, 0.1f);
+	const std::filesystem::path dir = MakeTestOutputDir("BakedMapLoadTime");
+
+	for (int chunkSize : { 0, 16 })
+	{
+		MapMan::ExportOptions options;
+		options.chunkSize = chunkSize;
+		const std::filesystem::path glbPath = dir / ("map" + std::to_string(chunkSize) + ".glb"), bakedPath = dir / ("map" + std::to_string(chunkSize) + ".temap");
+		REQUIRE(mapMan->ExportGLTFScene(glbPath, options));
+		REQUIRE(mapMan->ExportBakedMap(bakedPath, options));
+
+		// Both are read from disk. The GLB is then parsed and its accessors decoded, while the baked map only has to be checked.
+		size_t glbValues = 0;
+		const double glbSeconds = MeasureSeconds([&]() { glbValues = LoadAllAccessors(glbPath); }, 5);
+		CHECK(glbValues > 0);
+		size_t bakedVertices = 0;
+		const double bakedSeconds = MeasureSeconds([&]()
+			{
+				TestBakedFile file;
+				BakedMapView view;
+				bakedVertices = 0;
+				if (!ReadTestBakedFile(bakedPath, file) || !view.Open(file.GetData(), file.size)) return;
+				for (const BakedChunk& chunk : view.GetChunks())
+				{
+					for (const BakedRange& range : view.GetRanges(chunk)) bakedVertices += view.GetVertices(range).size();
+				}
+			}, 5);
+		CHECK(bakedVertices > 0);
+
+		const std::string label = std::string("128x8x128") + (chunkSize > 0 ? ", chunks of 16" : "");
+		ReportResult(label + ", glb size", double(std::filesystem::file_size(glbPath)) / (1024.0 * 1024.0), "MiB");
+		ReportResult(label + ", baked size", double(std::filesystem::file_size(bakedPath)) / (1024.0 * 1024.0), "MiB");
+		ReportResult(label + ", glb load", glbSeconds * 1e3, "ms");
+		ReportResult(label + ", baked load", bakedSeconds * 1e3, "ms");
+		ReportResult(label + ", speedup", glbSeconds / bakedSeconds, "x");
+	}
+}
@@ -0,0 +1,88 @@
+#include "stdafx.h"
+#include "TestMaps.h"
+#include "Test.h"
+#include "BoxColliders.h"
+
+// Returns how many of the boxes cover each cel.
+static std::vector<int> CountBoxCover(const std::vector<ColliderBox>& boxes, int width, int height, int length)
+{
+	std::vector<int> cover(size_t(width) * height * length, 0);
+	for (const ColliderBox& box : boxes)
+	{
+		for (int j = box.y; j < box.y + box.height; ++j)
+		{
+			for (int k = box.z; k < box.z + box.length; ++k)
+			{
+				for (int i = box.x; i < box.x + box.width; ++i) ++cover[size_t(i) + (size_t(k) * width) + (size_t(j) * width * length)];
+			}
+		}
+	}
+	return cover;
+}
+
+TEST_CASE(ColliderBoxesCoverCubesExactly)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	TileGrid grid(mapMan.get(), 48, 10, 40, GridStorage::CHUNKED);
+	FillTestMap(grid, assets, 31, 0.4f);
+	grid.SetTileRect(5, 3, 7, 20, 5, 11, Tile(assets.cube, 0, assets.textures[2], 0));
+
+	const int width = int(grid.GetWidth()), height = int(grid.GetHeight()), length = int(grid.GetLength());
+	const std::vector<uint8_t> cubeCels = grid.GetCubeCels();
+	const std::vector<ColliderBox> boxes = MergeColliderBoxes(cubeCels, width, height, length);
+	for (const ColliderBox& box : boxes)
+	{
+		REQUIRE(box.x >= 0 && box.y >= 0 && box.z >= 0 && box.width > 0 && box.height > 0 && box.length > 0);
+		REQUIRE(box.x + box.width <= width && box.y + box.height <= height && box.z + box.length <= length);
+	}
+
+	const std::vector<int> cover = CountBoxCover(boxes, width, height, length);
+	for (size_t c = 0; c < cover.size(); ++c) CHECK(cover[c] == (cubeCels[c] ? 1 : 0));
+
+	// A solid block is a single box
+	const std::vector<ColliderBox> block = MergeColliderBoxes(std::vector<uint8_t>(7 * 5 * 6, 1), 7, 5, 6);
+	REQUIRE(block.size() == 1);
+	CHECK(block[0].width == 7 && block[0].height == 5 && block[0].length == 6);
+}
+
+BENCHMARK(ColliderMergingOneMillionCels)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	const Tile cube(assets.cube, 0, assets.textures[0], 0);
+
+	// A solid block, a sparse map like FillTestMap() makes, and noise where every other cel is a cube
+	TileGrid solid(mapMan.get(), 100, 100, 100, GridStorage::CHUNKED);
+	solid.SetTileRect(0, 0, 0, 100, 100, 100, cube);
+	TileGrid sparse(mapMan.get(), 250, 16, 250, GridStorage::CHUNKED);
+	FillTestMap(sparse, assets, 32, 0.3f);
+	TileGrid noise(mapMan.get(), 100, 100, 100, GridStorage::CHUNKED);
+	std::mt19937 random(33);
+	for (int y = 0; y < 100; ++y)
+	{
+		for (int z = 0; z < 100; ++z)
+		{
+			for (int x = 0; x < 100; ++x)
+			{
+				if (random() % 2) noise.SetTile(x, y, z, cube);
+			}
+		}
+	}
+
+	for (const auto& [name, grid] : { std::pair<std::string, const TileGrid*>{ "100x100x100 solid", &solid }, { "250x16x250 test map", &sparse }, { "100x100x100 noise", &noise } })
+	{
+		std::vector<uint8_t> cubeCels;
+		std::vector<ColliderBox> boxes;
+		const double seconds = MeasureSeconds([&]()
+			{
+				cubeCels = grid->GetCubeCels();
+				boxes = MergeColliderBoxes(cubeCels, int(grid->GetWidth()), int(grid->GetHeight()), int(grid->GetLength()));
+			}, 3);
+		const size_t cubeCount = std::count(cubeCels.begin(), cubeCels.end(), 1);
+		ReportResult(name + ", time", seconds * 1e3, "ms");
+		ReportResult(name + ", cube tiles", double(cubeCount), "tiles");
+		ReportResult(name + ", boxes", double(boxes.size()), "boxes");
+		ReportResult(name + ", cubes per box", double(cubeCount) / double(Max(int(boxes.size()), 1)), "x");
+	}
+}
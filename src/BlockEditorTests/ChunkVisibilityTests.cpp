@@ -0,0 +1,128 @@
+#include "stdafx.h"
+#include "TestMaps.h"
+#include "Test.h"
+#include "ChunkVisibility.h"
+
+// Follows the line from `from` to `to` (in cels), and returns true if it reaches the cel that `to` is in without entering a solid cel first.
+static bool TraceTestRay(const std::vector<uint8_t>& solid, const int size[3], const float from[3], const float to[3])
+{
+	int cel[3], target[3], step[3];
+	float tMax[3], tDelta[3];
+	int steps = 0;
+	for (int c = 0; c < 3; ++c)
+	{
+		cel[c] = int(floorf(from[c]));
+		target[c] = int(floorf(to[c]));
+		steps += abs(target[c] - cel[c]);
+
+		const float delta = to[c] - from[c];
+		step[c] = (delta > 0.0f) ? 1 : ((delta < 0.0f) ? -1 : 0);
+		tDelta[c] = (step[c] != 0) ? fabsf(1.0f / delta) : std::numeric_limits<float>::infinity();
+		if (step[c] > 0) tMax[c] = (float(cel[c] + 1) - from[c]) / delta;
+		else if (step[c] < 0) tMax[c] = (float(cel[c]) - from[c]) / delta;
+		else tMax[c] = std::numeric_limits<float>::infinity();
+	}
+
+	for (int n = 0; n < steps; ++n)
+	{
+		const int axis = (tMax[0] < tMax[1]) ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+		cel[axis] += step[axis];
+		tMax[axis] += tDelta[axis];
+		if (cel[axis] < 0 || cel[axis] >= size[axis]) return false;
+
+		if (cel[0] == target[0] && cel[1] == target[1] && cel[2] == target[2]) return true;
+		if (solid[cel[0] + (size_t(cel[2]) * size[0]) + (size_t(cel[1]) * size[0] * size[2])]) return false;
+	}
+	return cel[0] == target[0] && cel[1] == target[1] && cel[2] == target[2];
+}
+
+TEST_CASE(ChunkVisibilityKeepsEverySightLine)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	TileGrid grid(mapMan.get(), 24, 12, 24, GridStorage::CHUNKED);
+	FillTestMap(grid, assets, 21, 0.35f);
+
+	const int chunkSize = 4;
+	const ChunkVisibility visibility = ComputeChunkVisibility(grid, chunkSize);
+	const std::array<int, 3> counts = grid.GetModelChunkCounts(chunkSize);
+	auto chunkOf = [&](int i, int j, int k) { return (size_t(j / chunkSize) * counts[2] + (k / chunkSize)) * counts[0] + (i / chunkSize); };
+
+	const int size[3] = { int(grid.GetWidth()), int(grid.GetHeight()), int(grid.GetLength()) };
+	const std::vector<uint8_t> solid = grid.GetCubeCels();
+	std::vector<std::array<int, 3>> openCels, tileCels;
+	for (int j = 0; j < size[1]; ++j)
+	{
+		for (int k = 0; k < size[2]; ++k)
+		{
+			for (int i = 0; i < size[0]; ++i)
+			{
+				if (!solid[grid.FlatIndex(i, j, k)]) openCels.push_back({ i, j, k });
+				if (grid.HasTile(i, j, k)) tileCels.push_back({ i, j, k });
+			}
+		}
+	}
+
+	// Any line from a point in an open cel to a point in a tile's cel that makes it through must be in the sets
+	std::mt19937 random(22);
+	std::uniform_real_distribution<float> offset(0.001f, 0.999f);
+	int reached = 0;
+	for (int r = 0; r < 200000; ++r)
+	{
+		const std::array<int, 3>& a = openCels[random() % openCels.size()];
+		const std::array<int, 3>& b = tileCels[random() % tileCels.size()];
+		const float from[3] = { a[0] + offset(random), a[1] + offset(random), a[2] + offset(random) };
+		const float to[3] = { b[0] + offset(random), b[1] + offset(random), b[2] + offset(random) };
+		if (!TraceTestRay(solid, size, from, to)) continue;
+
+		++reached;
+		CHECK(visibility.IsVisible(chunkOf(a[0], a[1], a[2]), chunkOf(b[0], b[1], b[2])));
+	}
+	CHECK(reached > 1000);
+}
+
+TEST_CASE(ChunkVisibilityStopsAtWalls)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	TileGrid grid(mapMan.get(), 16, 4, 8, GridStorage::CHUNKED);
+
+	// A solid wall across the whole map at x = 8, with a slab on each side of it. The chunks are 4 cels, so there are 4x1x2 of them.
+	const Tile cube(assets.cube, 0, assets.textures[0], 0), slab(assets.slab, 0, assets.textures[1], 0);
+	grid.SetTileRect(8, 0, 0, 1, 4, 8, cube);
+	grid.SetTile(2, 0, 2, slab);
+	grid.SetTile(13, 0, 2, slab);
+
+	ChunkVisibility visibility = ComputeChunkVisibility(grid, 4);
+	REQUIRE(visibility.chunkCount == 8);
+	CHECK(visibility.IsVisible(0, 0));
+	CHECK(visibility.IsVisible(0, 2)); // The wall itself
+	CHECK(visibility.IsVisible(3, 2));
+	CHECK(!visibility.IsVisible(0, 3));
+	CHECK(!visibility.IsVisible(3, 0));
+	CHECK(!visibility.IsVisible(7, 0));
+	CHECK(!visibility.IsVisible(0, 1)); // Nothing to see there
+
+	// A single missing cube lets sight through
+	grid.UnsetTile(8, 1, 3);
+	visibility = ComputeChunkVisibility(grid, 4);
+	CHECK(visibility.IsVisible(0, 3));
+	CHECK(visibility.IsVisible(3, 0));
+	CHECK(visibility.IsVisible(7, 0));
+}
+
+BENCHMARK(ChunkVisibilityTime)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	for (int size : { 64, 128, 256 })
+	{
+		TileGrid grid(mapMan.get(), size, 16, size, GridStorage::CHUNKED);
+		FillTestMap(grid, assets, 23, 0.2f);
+		for (int chunkSize : { 8, 16 })
+		{
+			double seconds = MeasureSeconds([&]() { ComputeChunkVisibility(grid, chunkSize); });
+			ReportResult(std::to_string(size) + "x16x" + std::to_string(size) + ", " + std::to_string(grid.GetModelChunkCount(chunkSize)) + " chunks", seconds * 1e3, "ms");
+		}
+	}
+}
@@ -0,0 +1,513 @@
+#include "stdafx.h"
+#include "TestMaps.h"
+#include "TestGLTF.h"
+#include "Test.h"
+
+// Returns the triangles of every primitive in the file, sorted. The meshes of the map aren't moved by their nodes.
+static std::vector<TriangleKey> PrimitiveTriangles(const TestGLB& glb)
+{
+	std::vector<TriangleKey> triangles;
+	for (const nlohmann::json& mesh : glb.json["meshes"])
+	{
+		for (const nlohmann::json& primitive : mesh["primitives"])
+		{
+			const std::vector<double> positions = ReadAccessor(glb, primitive["attributes"]["POSITION"]);
+			const std::vector<double> indices = ReadAccessor(glb, primitive["indices"]);
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				Vector3 corners[3];
+				for (int c = 0; c < 3; ++c)
+				{
+					const size_t v = size_t(indices[i + c]) * 3;
+					corners[c] = Vector3{ float(positions[v]), float(positions[v + 1]), float(positions[v + 2]) };
+				}
+				triangles.push_back(MakeTriangleKey(corners));
+			}
+		}
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+TEST_CASE(ExportedIndicesDontWrap)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	// The floor's texture alone has more vertices than 16-bit indices can reach, even with its hidden faces culled.
+	FillTestMapMan(*mapMan, assets, 128, 3, 128, 17, 0.2f);
+	const std::filesystem::path dir = MakeTestOutputDir("ExportedIndicesDontWrap");
+
+	TileGrid tiles = mapMan->Tiles();
+	RLModel model = tiles.GenerateModel(true, false, false);
+	std::vector<TriangleKey> modelTriangles;
+	for (const auto& [texture, triangles] : TrianglesByTexture(model)) modelTriangles.insert(modelTriangles.end(), triangles.begin(), triangles.end());
+	std::sort(modelTriangles.begin(), modelTriangles.end());
+	UnloadModel(model);
+
+	for (bool use32BitIndices : { false, true })
+	{
+		MapMan::ExportOptions options;
+		options.weldVertices = false;
+		options.use32BitIndices = use32BitIndices;
+		const std::filesystem::path path = dir / (use32BitIndices ? "indices32.glb" : "indices16.glb");
+		REQUIRE(mapMan->ExportGLTFScene(path, options));
+
+		TestGLB glb;
+		REQUIRE(LoadTestGLB(path, glb));
+
+		std::map<int, int> primitivesPerMaterial;
+		double largestIndex = 0.0;
+		for (const nlohmann::json& mesh : glb.json["meshes"])
+		{
+			for (const nlohmann::json& primitive : mesh["primitives"])
+			{
+				const nlohmann::json& indices = glb.json["accessors"][primitive["indices"].get<int>()];
+				const size_t vertexCount = glb.json["accessors"][primitive["attributes"]["POSITION"].get<int>()]["count"];
+				CHECK(indices["componentType"] == (use32BitIndices ? 5125 : 5123));
+				if (!use32BitIndices) CHECK(vertexCount <= MODEL_MESH_MAX_VERTICES);
+
+				const std::vector<double> values = ReadAccessor(glb, primitive["indices"]);
+				const double largest = *std::max_element(values.begin(), values.end());
+				CHECK(largest < double(vertexCount));
+				if (!use32BitIndices) CHECK(std::find(values.begin(), values.end(), 65535.0) == values.end()); // Restarts the primitive in glTF
+				largestIndex = std::max(largestIndex, largest);
+				++primitivesPerMaterial[primitive["material"]];
+			}
+		}
+
+		// With 32-bit indices, each texture's split meshes are joined back into one primitive that goes past the 16-bit range.
+		// Either way, every triangle of the model has to come out in the same place.
+		if (use32BitIndices)
+		{
+			CHECK(largestIndex > 65535.0);
+			for (const auto& [material, count] : primitivesPerMaterial) CHECK(count == 1);
+		}
+		else
+		{
+			CHECK(primitivesPerMaterial.size() < size_t(std::accumulate(primitivesPerMaterial.begin(), primitivesPerMaterial.end(), 0, [](int sum, const auto& p) { return sum + p.second; })));
+		}
+		CHECK(PrimitiveTriangles(glb) == modelTriangles);
+	}
+}
+
+// Returns the translation and uniform scale of the node that holds the mesh, which is how quantized positions are decoded.
+static std::pair<Vector3, double> MeshNodeTransform(const TestGLB& glb, size_t mesh)
+{
+	for (const nlohmann::json& node : glb.json["nodes"])
+	{
+		if (node.value("mesh", -1) != int(mesh)) continue;
+		const std::vector<double> t = node.value("translation", std::vector<double>{ 0.0, 0.0, 0.0 });
+		const std::vector<double> s = node.value("scale", std::vector<double>{ 1.0, 1.0, 1.0 });
+		return { Vector3{ float(t[0]), float(t[1]), float(t[2]) }, s[0] };
+	}
+	return { Vector3Zero(), 1.0 };
+}
+
+TEST_CASE(QuantizedExportRoundTrips)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	FillTestMapMan(*mapMan, assets, 48, 4, 48, 19, 0.3f);
+	const std::filesystem::path dir = MakeTestOutputDir("QuantizedExportRoundTrips");
+
+	// Merged faces repeat their textures, so their texture coordinates can't be quantized and have to stay as floats.
+	for (bool greedy : { false, true })
+	{
+		MapMan::ExportOptions options;
+		options.greedyMeshing = greedy;
+		TestGLB plain, quantized;
+		REQUIRE(mapMan->ExportGLTFScene(dir / "plain.glb", options));
+		options.quantize = true;
+		REQUIRE(mapMan->ExportGLTFScene(dir / "quantized.glb", options));
+		REQUIRE(LoadTestGLB(dir / "plain.glb", plain));
+		REQUIRE(LoadTestGLB(dir / "quantized.glb", quantized));
+
+		CHECK(quantized.json["extensionsRequired"] == nlohmann::json::array({ "KHR_mesh_quantization" }));
+		REQUIRE(plain.json["meshes"].size() == quantized.json["meshes"].size());
+
+		double positionError = 0.0, normalAngle = 0.0, texCoordError = 0.0, largestStep = 0.0;
+		size_t floatTexCoords = 0;
+		for (size_t m = 0; m < plain.json["meshes"].size(); ++m)
+		{
+			const nlohmann::json& plainPrims = plain.json["meshes"][m]["primitives"];
+			const nlohmann::json& quantizedPrims = quantized.json["meshes"][m]["primitives"];
+			REQUIRE(plainPrims.size() == quantizedPrims.size());
+			const auto [offset, step] = MeshNodeTransform(quantized, m);
+			largestStep = std::max(largestStep, step);
+
+			for (size_t p = 0; p < plainPrims.size(); ++p)
+			{
+				const nlohmann::json& attributes = quantizedPrims[p]["attributes"];
+				const nlohmann::json& positionInfo = quantized.json["accessors"][attributes["POSITION"].get<int>()];
+				const nlohmann::json& normalInfo = quantized.json["accessors"][attributes["NORMAL"].get<int>()];
+				const nlohmann::json& texCoordInfo = quantized.json["accessors"][attributes["TEXCOORD_0"].get<int>()];
+				CHECK(positionInfo["componentType"] == 5123 && !positionInfo.value("normalized", false));
+				CHECK(normalInfo["componentType"] == 5120 && normalInfo.value("normalized", false));
+				CHECK((texCoordInfo["componentType"] == 5123 && texCoordInfo.value("normalized", false)) || texCoordInfo["componentType"] == 5126);
+
+				const std::vector<double> positions = ReadAccessor(plain, plainPrims[p]["attributes"]["POSITION"]);
+				const std::vector<double> normals = ReadAccessor(plain, plainPrims[p]["attributes"]["NORMAL"]);
+				const std::vector<double> texCoords = ReadAccessor(plain, plainPrims[p]["attributes"]["TEXCOORD_0"]);
+				const std::vector<double> qPositions = ReadAccessor(quantized, attributes["POSITION"]);
+				const std::vector<double> qNormals = ReadAccessor(quantized, attributes["NORMAL"]);
+				const std::vector<double> qTexCoords = ReadAccessor(quantized, attributes["TEXCOORD_0"]);
+				REQUIRE(positions.size() == qPositions.size() && normals.size() == qNormals.size() && texCoords.size() == qTexCoords.size());
+
+				for (size_t v = 0; v < positions.size() / 3; ++v)
+				{
+					const double decoded[3] = { offset.x + step * qPositions[v * 3], offset.y + step * qPositions[v * 3 + 1], offset.z + step * qPositions[v * 3 + 2] };
+					double dot = 0.0, length = 0.0;
+					for (int c = 0; c < 3; ++c)
+					{
+						positionError = std::max(positionError, fabs(decoded[c] - positions[v * 3 + c]));
+						dot += qNormals[v * 3 + c] * normals[v * 3 + c];
+						length += qNormals[v * 3 + c] * qNormals[v * 3 + c];
+					}
+					normalAngle = std::max(normalAngle, acos(std::min(1.0, dot / sqrt(length))));
+				}
+
+				if (texCoordInfo["componentType"] == 5126)
+				{
+					// Only texture coordinates outside of 0 to 1 are a reason to keep floats
+					++floatTexCoords;
+					CHECK(std::any_of(qTexCoords.begin(), qTexCoords.end(), [](double uv) { return uv < 0.0 || uv > 1.0; }));
+				}
+				for (size_t i = 0; i < texCoords.size(); ++i) texCoordError = std::max(texCoordError, fabs(qTexCoords[i] - texCoords[i]));
+			}
+		}
+
+		// Positions are rounded to the nearest step, normals to 1/127 on each axis and texture coordinates to 1/65535.
+		// The corners of the test shapes lie on simple fractions of a cel, which the steps hit exactly.
+		CHECK(largestStep <= double(mapMan->Tiles().GetSpacing()) / 64.0);
+		CHECK(positionError == 0.0);
+		CHECK(normalAngle <= sqrt(3.0) * 0.5 / 127.0);
+		CHECK(texCoordError <= 0.5 / 65535.0 + 1e-7);
+		CHECK(greedy == (floatTexCoords > 0));
+	}
+}
+
+// Returns the area of each of the file's triangles, added up by the direction that they face.
+static std::map<std::array<int, 3>, double> AreaByDirection(const TestGLB& glb)
+{
+	std::map<std::array<int, 3>, double> areas;
+	for (const nlohmann::json& mesh : glb.json["meshes"])
+	{
+		for (const nlohmann::json& primitive : mesh["primitives"])
+		{
+			const std::vector<double> positions = ReadAccessor(glb, primitive["attributes"]["POSITION"]);
+			const std::vector<double> indices = ReadAccessor(glb, primitive["indices"]);
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				Vector3 corners[3];
+				for (int c = 0; c < 3; ++c)
+				{
+					const size_t v = size_t(indices[i + c]) * 3;
+					corners[c] = Vector3{ float(positions[v]), float(positions[v + 1]), float(positions[v + 2]) };
+				}
+				const Vector3 cross = Vector3CrossProduct(Vector3Subtract(corners[1], corners[0]), Vector3Subtract(corners[2], corners[0]));
+				const float length = sqrtf(Vector3DotProduct(cross, cross));
+				if (length <= 0.0f) continue;
+				const std::array<int, 3> direction = { int(lroundf(cross.x / length * 100.0f)), int(lroundf(cross.y / length * 100.0f)), int(lroundf(cross.z / length * 100.0f)) };
+				areas[direction] += length * 0.5;
+			}
+		}
+	}
+	return areas;
+}
+
+TEST_CASE(AtlasExportCutsRepeatingFaces)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	FillTestMapMan(*mapMan, assets, 32, 3, 32, 21, 0.3f);
+	const std::filesystem::path dir = MakeTestOutputDir("AtlasExportCutsRepeatingFaces");
+
+	// Each texture is one solid color, so the atlas shows which texture a face is drawing from
+	const Color COLORS[] = { { 255, 0, 0, 255 }, { 0, 255, 0, 255 }, { 0, 0, 255, 255 }, { 255, 255, 0, 255 } };
+	for (size_t t = 0; t < assets.textures.size(); ++t)
+	{
+		std::vector<Color> pixels(16 * 16, COLORS[t]);
+		RLImage image = { pixels.data(), 16, 16, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+		REQUIRE(ExportImage(image, (assets.dir / ("texture" + std::to_string(t) + ".png")).string().c_str()));
+	}
+
+	// Merged faces repeat their textures across many cels
+	MapMan::ExportOptions options;
+	options.greedyMeshing = true;
+	TestGLB plain, packed;
+	REQUIRE(mapMan->ExportGLTFScene(dir / "plain.glb", options));
+	options.atlasTextures = true;
+	REQUIRE(mapMan->ExportGLTFScene(dir / "packed.glb", options));
+	REQUIRE(LoadTestGLB(dir / "plain.glb", plain));
+	REQUIRE(LoadTestGLB(dir / "packed.glb", packed));
+
+	// Every texture fits into one atlas, which is sampled without mipmaps or repeating
+	REQUIRE(packed.json["materials"].size() == 1);
+	const nlohmann::json& texture = packed.json["textures"][0];
+	const nlohmann::json& sampler = packed.json["samplers"][texture["sampler"].get<int>()];
+	CHECK(sampler["minFilter"] == 9728 && sampler["wrapS"] == 33071 && sampler["wrapT"] == 33071);
+	RLImage atlas = LoadImage((dir / packed.json["images"][texture["source"].get<int>()]["uri"].get<std::string>()).string().c_str());
+	REQUIRE(atlas.data != NULL);
+	Color* atlasPixels = LoadImageColors(atlas);
+
+	// Cutting the faces keeps their surface, but makes more triangles
+	CHECK(PrimitiveTriangles(packed).size() > PrimitiveTriangles(plain).size());
+	const auto plainAreas = AreaByDirection(plain), packedAreas = AreaByDirection(packed);
+	REQUIRE(plainAreas.size() == packedAreas.size());
+	for (const auto& [direction, area] : plainAreas) CHECK(fabs(packedAreas.at(direction) - area) < 1e-3 * area);
+
+	// All of a triangle has to draw from one texture: its corners, pulled in a little, sample the same color as its center
+	size_t mixedTriangles = 0;
+	for (const nlohmann::json& mesh : packed.json["meshes"])
+	{
+		for (const nlohmann::json& primitive : mesh["primitives"])
+		{
+			const std::vector<double> texCoords = ReadAccessor(packed, primitive["attributes"]["TEXCOORD_0"]);
+			const std::vector<double> indices = ReadAccessor(packed, primitive["indices"]);
+			auto sample = [&](double u, double v)
+				{
+					const int x = std::clamp(int(u * atlas.width), 0, atlas.width - 1), y = std::clamp(int(v * atlas.height), 0, atlas.height - 1);
+					const Color color = atlasPixels[y * atlas.width + x];
+					return std::array<int, 4>{ color.r, color.g, color.b, color.a };
+				};
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				double center[2] = { 0.0, 0.0 };
+				for (int c = 0; c < 3; ++c)
+				{
+					for (int k = 0; k < 2; ++k) center[k] += texCoords[size_t(indices[i + c]) * 2 + k] / 3.0;
+				}
+				const std::array<int, 4> color = sample(center[0], center[1]);
+				bool same = color[3] == 255;
+				for (int c = 0; c < 3; ++c)
+				{
+					const double* corner = &texCoords[size_t(indices[i + c]) * 2];
+					same = same && sample(corner[0] * 0.9 + center[0] * 0.1, corner[1] * 0.9 + center[1] * 0.1) == color;
+				}
+				if (!same) ++mixedTriangles;
+			}
+		}
+	}
+	CHECK(mixedTriangles == 0);
+	UnloadImageColors(atlasPixels);
+	UnloadImage(atlas);
+
+	// The other tests expect the textures not to exist
+	for (size_t t = 0; t < assets.textures.size(); ++t) std::filesystem::remove(assets.dir / ("texture" + std::to_string(t) + ".png"));
+}
+
+TEST_CASE(ChunkedExportSplitsTheMap)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	// The chunks along the far sides are cut short by the edge of the map
+	FillTestMapMan(*mapMan, assets, 40, 6, 36, 35, 0.3f);
+	const std::filesystem::path dir = MakeTestOutputDir("ChunkedExportSplitsTheMap");
+
+	MapMan::ExportOptions options;
+	TestGLB whole, chunked;
+	REQUIRE(mapMan->ExportGLTFScene(dir / "whole.glb", options));
+	options.chunkSize = 16;
+	REQUIRE(mapMan->ExportGLTFScene(dir / "chunked.glb", options));
+	REQUIRE(LoadTestGLB(dir / "whole.glb", whole));
+	REQUIRE(LoadTestGLB(dir / "chunked.glb", chunked));
+
+	const TileGrid& tiles = mapMan->Tiles();
+	const int size[3] = { int(tiles.GetWidth()), int(tiles.GetHeight()), int(tiles.GetLength()) };
+	std::set<std::array<int, 3>> filledChunks;
+	for (int j = 0; j < size[1]; ++j)
+	{
+		for (int k = 0; k < size[2]; ++k)
+		{
+			for (int i = 0; i < size[0]; ++i)
+			{
+				if (tiles.HasTile(i, j, k)) filledChunks.insert({ i / options.chunkSize, j / options.chunkSize, k / options.chunkSize });
+			}
+		}
+	}
+
+	// Every chunk with tiles in it has a node, and the geometry in that node stays within the chunk's cels
+	std::set<std::array<int, 3>> chunkNodes;
+	for (const nlohmann::json& node : chunked.json["nodes"])
+	{
+		if (!node.contains("extras") || !node["extras"].contains("chunk")) continue;
+		const std::array<int, 3> chunk = node["extras"]["chunk"];
+		CHECK(node["extras"]["chunkSize"] == options.chunkSize);
+		CHECK(chunkNodes.insert(chunk).second);
+		REQUIRE(node.contains("mesh"));
+
+		for (const nlohmann::json& primitive : chunked.json["meshes"][node["mesh"].get<int>()]["primitives"])
+		{
+			const nlohmann::json& accessor = chunked.json["accessors"][primitive["attributes"]["POSITION"].get<int>()];
+			for (int c = 0; c < 3; ++c)
+			{
+				const double low = chunk[c] * options.chunkSize * tiles.GetSpacing();
+				const double high = std::min((chunk[c] + 1) * options.chunkSize, size[c]) * tiles.GetSpacing();
+				CHECK(accessor["min"][c].get<double>() >= low - 1e-4);
+				CHECK(accessor["max"][c].get<double>() <= high + 1e-4);
+			}
+		}
+	}
+	CHECK(chunkNodes == filledChunks);
+
+	// Splitting the map doesn't add, lose or move any triangles
+	const std::vector<TriangleKey> wholeTriangles = PrimitiveTriangles(whole), chunkedTriangles = PrimitiveTriangles(chunked);
+	CHECK(chunkedTriangles.size() == wholeTriangles.size());
+	CHECK(chunkedTriangles == wholeTriangles);
+}
+
+TEST_CASE(DetailLevelsFollowTheExportOptions)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	FillTestMapMan(*mapMan, assets, 32, 4, 32, 36, 0.4f);
+	const std::filesystem::path dir = MakeTestOutputDir("DetailLevelsFollowTheExportOptions");
+
+	MapMan::ExportOptions options;
+	options.lodLevels = 2;
+	options.quantize = true;
+	options.use32BitIndices = true;
+	options.optimizeVertexCache = true;
+	TestGLB glb;
+	REQUIRE(mapMan->ExportGLTFScene(dir / "lod.glb", options));
+	REQUIRE(LoadTestGLB(dir / "lod.glb", glb));
+
+	const TileGrid& tiles = mapMan->Tiles();
+	const double mapSize[3] = { tiles.GetWidth() * tiles.GetSpacing(), tiles.GetHeight() * tiles.GetSpacing(), tiles.GetLength() * tiles.GetSpacing() };
+	const nlohmann::json* mapNode = nullptr;
+	for (const nlohmann::json& node : glb.json["nodes"])
+	{
+		if (node["name"] == "map") mapNode = &node;
+	}
+	REQUIRE(mapNode != nullptr);
+	const nlohmann::json& levelIds = (*mapNode)["extensions"]["MSFT_lod"]["ids"];
+	REQUIRE(levelIds.size() == 2);
+
+	for (size_t l = 0; l < levelIds.size(); ++l)
+	{
+		// Levels are quantized like the map, and their nodes decode the positions back into the map's space
+		const nlohmann::json& levelNode = glb.json["nodes"][levelIds[l].get<int>()];
+		REQUIRE(levelNode.contains("mesh"));
+		const double scale = levelNode["scale"][0], translation[3] = { levelNode["translation"][0], levelNode["translation"][1], levelNode["translation"][2] };
+		size_t triangles = 0;
+		std::set<int> materials;
+		for (const nlohmann::json& primitive : glb.json["meshes"][levelNode["mesh"].get<int>()]["primitives"])
+		{
+			CHECK(materials.insert(primitive["material"].get<int>()).second);
+			CHECK(glb.json["accessors"][primitive["attributes"]["POSITION"].get<int>()]["componentType"] == 5123);
+			CHECK(glb.json["accessors"][primitive["attributes"]["NORMAL"].get<int>()]["componentType"] == 5120);
+			CHECK(glb.json["accessors"][primitive["indices"].get<int>()]["componentType"] == 5125);
+
+			const std::vector<double> positions = ReadAccessor(glb, primitive["attributes"]["POSITION"]);
+			for (size_t v = 0; v < positions.size(); ++v)
+			{
+				const double position = translation[v % 3] + scale * positions[v];
+				CHECK(position >= -1e-3 && position <= mapSize[v % 3] + 1e-3);
+			}
+			triangles += ReadAccessor(glb, primitive["indices"]).size() / 3;
+		}
+
+		// Every material of a level is one primitive with 32-bit indices, holding all of the level's triangles
+		RLModel model = tiles.Downsample(2 << l).GenerateModel(options.cullFaces, options.greedyMeshing, options.weldVertices);
+		size_t modelTriangles = 0;
+		for (int m = 0; m < model.meshCount; ++m) modelTriangles += size_t(model.meshes[m].triangleCount);
+		UnloadModel(model);
+		CHECK(triangles == modelTriangles);
+	}
+}
+
+BENCHMARK(InstancedExportSizeAndLoadTime)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	FillTestMapMan(*mapMan, assets, 128, 8, 128, 9, 0.1f);
+	const std::filesystem::path dir = MakeTestOutputDir("InstancedExportSizeAndLoadTime");
+
+	struct Mode
+	{
+		const char* name;
+		bool gpuInstancing, bakeCubeTiles;
+	};
+	uintmax_t bakedSize = 0;
+	for (const Mode& mode : { Mode{ "baked", false, false }, Mode{ "instanced, cubes baked", true, true }, Mode{ "instanced", true, false } })
+	{
+		MapMan::ExportOptions options;
+		options.gpuInstancing = mode.gpuInstancing;
+		options.bakeCubeTiles = mode.bakeCubeTiles;
+		const std::filesystem::path path = dir / (std::string(mode.name) + ".glb");
+
+		bool exported = false;
+		const double exportSeconds = MeasureSeconds([&]() { exported = mapMan->ExportGLTFScene(path, options); });
+		REQUIRE(exported);
+		size_t values = 0;
+		const double loadSeconds = MeasureSeconds([&]() { values = LoadAllAccessors(path); }, 3);
+		CHECK(values > 0);
+
+		const uintmax_t size = std::filesystem::file_size(path);
+		if (!mode.gpuInstancing) bakedSize = size;
+		const std::string label = std::string("128x8x128, ") + mode.name;
+		ReportResult(label + ", file size", double(size) / (1024.0 * 1024.0), "MiB");
+		ReportResult(label + ", export", exportSeconds * 1e3, "ms");
+		ReportResult(label + ", load", loadSeconds * 1e3, "ms");
+
+		// Every prop is written once, so with the cubes instanced as well the file has to come out smaller than the baked one.
+		if (mode.gpuInstancing && !mode.bakeCubeTiles) CHECK(size < bakedSize);
+	}
+}
+
+BENCHMARK(LargeExportMemory)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	// With no faces culled or welded, an 800x800 floor of cubes makes about 540 MB of geometry.
+	FillTestMapMan(*mapMan, assets, 800, 1, 800, 20, 0.0f);
+	const std::filesystem::path dir = MakeTestOutputDir("LargeExportMemory");
+
+	MapMan::ExportOptions options;
+	options.cullFaces = false;
+	options.weldVertices = false;
+
+	// Making the model that gets exported takes memory of its own, which the export can't do without
+	RLModel model{};
+	const size_t modelMemory = MeasurePeakMemory([&]() { model = MapManInspector::Tiles(*mapMan).GenerateModel(false, false, false); });
+	UnloadModel(model);
+	ReportResult("800x1x800 cubes, peak memory added by GenerateModel", double(modelMemory) / (1024.0 * 1024.0), "MiB");
+
+	uintmax_t bufferSize = 0;
+	for (const char* extension : { ".glb", ".gltf" })
+	{
+		const std::filesystem::path path = dir / (std::string("map") + extension);
+		bool exported = false;
+		size_t peakMemory = 0;
+		const double seconds = MeasureSeconds([&]() { peakMemory = MeasurePeakMemory([&]() { exported = mapMan->ExportGLTFScene(path, options); }); });
+		REQUIRE(exported);
+
+		const uintmax_t size = std::filesystem::file_size(path);
+		const std::string label = std::string("800x1x800 cubes, ") + extension;
+		ReportResult(label + ", file size", double(size) / (1024.0 * 1024.0), "MiB");
+		ReportResult(label + ", export", seconds, "s");
+		ReportResult(label + ", peak memory added", double(peakMemory) / (1024.0 * 1024.0), "MiB");
+
+		if (path.extension() == ".glb")
+		{
+			// The binary chunk has to hold exactly the buffer that the JSON describes
+			TestGLB glb;
+			REQUIRE(LoadTestGLB(path, glb));
+			bufferSize = glb.json["buffers"][0]["byteLength"];
+			CHECK(glb.bin.size() == bufferSize);
+			size_t triangles = 0;
+			for (const nlohmann::json& mesh : glb.json["meshes"])
+			{
+				for (const nlohmann::json& primitive : mesh["primitives"]) triangles += glb.json["accessors"][primitive["indices"].get<int>()]["count"].get<size_t>() / 3;
+			}
+			CHECK(triangles == size_t(800 * 800 * 12));
+		}
+		else
+		{
+			CHECK(size > bufferSize / 3 * 4);
+		}
+
+		// The writer only adds a small staging buffer to what the model needs. Building the buffer in memory first added its whole size, or more for .gltf.
+		CHECK(peakMemory < modelMemory + 64 * 1024 * 1024);
+	}
+}
@@ -0,0 +1,251 @@
+#include "stdafx.h"
+#include "Grid.h"
+#include "TestMaps.h"
+#include "Test.h"
+
+// Exposes the grid's protected cel accessors to the tests.
+class TestGrid : public Grid<int>
+{
+public:
+	using Grid<int>::Grid;
+	using Grid<int>::getCel;
+	using Grid<int>::setCel;
+	using Grid<int>::fillCels;
+	using Grid<int>::forEachCel;
+};
+
+// Returns every non-fill cel of the grid as (flat index, cel) pairs, in the order that forEachCel visits them.
+static std::vector<std::pair<size_t, int>> VisitedCels(const TestGrid& grid)
+{
+	std::vector<std::pair<size_t, int>> cels;
+	grid.forEachCel(0, int(grid.GetHeight()) - 1, [&](size_t idx, const int& cel) { cels.emplace_back(idx, cel); });
+	return cels;
+}
+
+static bool SameCels(const TestGrid& a, const TestGrid& b)
+{
+	for (int y = 0; y < int(a.GetHeight()); ++y)
+	{
+		for (int z = 0; z < int(a.GetLength()); ++z)
+		{
+			for (int x = 0; x < int(a.GetWidth()); ++x)
+			{
+				if (a.getCel(x, y, z) != b.getCel(x, y, z)) return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Sizes that aren't multiples of GRID_CHUNK_SIZE, so that the edge bricks are partly outside of the grid.
+static const int EDGE_WIDTH = 40, EDGE_HEIGHT = 20, EDGE_LENGTH = 37;
+
+TEST_CASE(ChunkedGridMatchesDenseGrid)
+{
+	TestGrid dense(EDGE_WIDTH, EDGE_HEIGHT, EDGE_LENGTH, 1.0f, 0, GridStorage::DENSE);
+	TestGrid chunked(EDGE_WIDTH, EDGE_HEIGHT, EDGE_LENGTH, 1.0f, 0, GridStorage::CHUNKED);
+
+	std::mt19937 random(1);
+	for (int round = 0; round < 50; ++round)
+	{
+		// A few values only, so that bricks keep becoming uniform and mixed again.
+		const int value = int(random() % 3);
+		if (round % 2 == 0)
+		{
+			const int x = int(random() % EDGE_WIDTH), y = int(random() % EDGE_HEIGHT), z = int(random() % EDGE_LENGTH);
+			const int w = 1 + int(random() % (EDGE_WIDTH - x)), h = 1 + int(random() % (EDGE_HEIGHT - y)), l = 1 + int(random() % (EDGE_LENGTH - z));
+			dense.fillCels(x, y, z, w, h, l, value);
+			chunked.fillCels(x, y, z, w, h, l, value);
+		}
+		else
+		{
+			for (int c = 0; c < 500; ++c)
+			{
+				const size_t idx = random() % (EDGE_WIDTH * EDGE_HEIGHT * EDGE_LENGTH);
+				dense.setCel(idx, value);
+				chunked.setCel(idx, value);
+			}
+		}
+
+		CHECK(SameCels(dense, chunked));
+		CHECK(VisitedCels(dense) == VisitedCels(chunked));
+	}
+}
+
+TEST_CASE(ChunkedGridReleasesUniformBricks)
+{
+	TestGrid grid(EDGE_WIDTH, EDGE_HEIGHT, EDGE_LENGTH, 1.0f, 0, GridStorage::CHUNKED);
+	const size_t emptyBytes = grid.GetMemoryUsage();
+	const size_t celCount = size_t(EDGE_WIDTH) * EDGE_HEIGHT * EDGE_LENGTH;
+
+	// Painting over everything with another value leaves uniform bricks, which need no memory of their own.
+	grid.fillCels(0, 0, 0, EDGE_WIDTH, EDGE_HEIGHT, EDGE_LENGTH, 7);
+	CHECK(grid.GetMemoryUsage() == emptyBytes);
+	CHECK(grid.getCel(EDGE_WIDTH - 1, EDGE_HEIGHT - 1, EDGE_LENGTH - 1) == 7);
+	CHECK(VisitedCels(grid).size() == celCount);
+
+	grid.setCel(3, 17, 35, 2);
+	CHECK(grid.GetMemoryUsage() > emptyBytes);
+	CHECK(grid.getCel(3, 17, 35) == 2);
+	grid.setCel(3, 17, 35, 7);
+	CHECK(grid.GetMemoryUsage() == emptyBytes);
+
+	// A brick holding several values collapses as soon as the last of them is painted over.
+	for (int x = 0; x < EDGE_WIDTH; ++x)
+	{
+		for (int z = 0; z < EDGE_LENGTH; ++z)
+		{
+			for (int y = 0; y < EDGE_HEIGHT; ++y)
+			{
+				grid.setCel(x, y, z, (x + y + z) % 2 ? 9 : 4);
+			}
+		}
+	}
+	CHECK(grid.GetMemoryUsage() > emptyBytes);
+	for (int y = EDGE_HEIGHT - 1; y >= 0; --y)
+	{
+		for (int z = 0; z < EDGE_LENGTH; ++z)
+		{
+			for (int x = EDGE_WIDTH - 1; x >= 0; --x)
+			{
+				grid.setCel(x, y, z, 9);
+			}
+		}
+	}
+	CHECK(grid.GetMemoryUsage() == emptyBytes);
+	CHECK(grid.getCel(0, 0, 0) == 9);
+
+	grid.fillCels(0, 0, 0, EDGE_WIDTH, EDGE_HEIGHT, EDGE_LENGTH, 0);
+	CHECK(grid.GetMemoryUsage() == emptyBytes);
+	CHECK(VisitedCels(grid).empty());
+}
+
+// Map contents used by the grid benchmarks, drawn into a 256x32x256 grid of both kinds.
+enum class GridScene { EMPTY, FLOOR, SCATTERED, HALF_SOLID };
+
+static const int BENCH_WIDTH = 256, BENCH_HEIGHT = 32, BENCH_LENGTH = 256;
+
+// Draws the scene with `fill(i, j, k, w, h, l, value)` and `set(i, j, k, value)`, where the values are small non-zero numbers.
+template<class Fill, class Set>
+static void DrawScene(GridScene scene, Fill fill, Set set)
+{
+	std::mt19937 random(2);
+	switch (scene)
+	{
+	case GridScene::EMPTY: break;
+	case GridScene::FLOOR: fill(0, 0, 0, BENCH_WIDTH, 1, BENCH_LENGTH, 1); break;
+	case GridScene::SCATTERED:
+		fill(0, 0, 0, BENCH_WIDTH, 1, BENCH_LENGTH, 1);
+		for (int c = 0; c < BENCH_WIDTH * BENCH_HEIGHT * BENCH_LENGTH / 100; ++c)
+		{
+			set(int(random() % BENCH_WIDTH), int(random() % BENCH_HEIGHT), int(random() % BENCH_LENGTH), 2);
+		}
+		break;
+	case GridScene::HALF_SOLID: fill(0, 0, 0, BENCH_WIDTH, BENCH_HEIGHT / 2, BENCH_LENGTH, 3); break;
+	}
+}
+
+static void DrawScene(TestGrid& grid, GridScene scene)
+{
+	DrawScene(scene, [&](int i, int j, int k, int w, int h, int l, int value) { grid.fillCels(i, j, k, w, h, l, value); },
+		[&](int i, int j, int k, int value) { grid.setCel(i, j, k, value); });
+}
+
+static const char* SceneName(GridScene scene)
+{
+	switch (scene)
+	{
+	case GridScene::EMPTY: return "empty";
+	case GridScene::FLOOR: return "floor";
+	case GridScene::SCATTERED: return "floor + 1% scattered";
+	case GridScene::HALF_SOLID: return "half solid";
+	}
+	return "";
+}
+
+static const GridScene GRID_SCENES[] = { GridScene::EMPTY, GridScene::FLOOR, GridScene::SCATTERED, GridScene::HALF_SOLID };
+
+BENCHMARK(GridMemoryUsage)
+{
+	for (GridScene scene : GRID_SCENES)
+	{
+		for (GridStorage storage : { GridStorage::DENSE, GridStorage::CHUNKED })
+		{
+			TestGrid grid(BENCH_WIDTH, BENCH_HEIGHT, BENCH_LENGTH, 1.0f, 0, storage);
+			DrawScene(grid, scene);
+			ReportResult(std::string(SceneName(scene)) + (storage == GridStorage::DENSE ? ", dense" : ", chunked"), grid.GetMemoryUsage() / 1024.0, "KiB");
+		}
+	}
+
+	// Tile grids used to store a whole 16-byte Tile in every cel of a dense grid, no matter what was in it.
+	// Now each cel is a 16-bit palette index, and the palette only holds the distinct tiles.
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	const Grid<Tile> tileCels(BENCH_WIDTH, BENCH_HEIGHT, BENCH_LENGTH, 1.0f);
+	for (GridScene scene : GRID_SCENES)
+	{
+		const std::string label = std::string(SceneName(scene)) + ", tiles";
+		ReportResult(label + ", 16-byte cels, dense", tileCels.GetMemoryUsage() / 1024.0, "KiB");
+		for (GridStorage storage : { GridStorage::DENSE, GridStorage::CHUNKED })
+		{
+			TileGrid grid(mapMan.get(), BENCH_WIDTH, BENCH_HEIGHT, BENCH_LENGTH, storage);
+			DrawScene(scene, [&](int i, int j, int k, int w, int h, int l, int value) { grid.SetTileRect(i, j, k, w, h, l, Tile(assets.cube, 0, assets.textures[value], 0)); },
+				[&](int i, int j, int k, int value) { grid.SetTile(i, j, k, Tile(assets.cube, 0, assets.textures[value], 0)); });
+			const size_t bytes = grid.GetMemoryUsage() + TileGridInspector::PaletteSize(grid) * sizeof(Tile);
+			ReportResult(label + (storage == GridStorage::DENSE ? ", palette, dense" : ", palette, chunked"), bytes / 1024.0, "KiB");
+			CHECK(bytes * 4 <= tileCels.GetMemoryUsage());
+		}
+	}
+}
+
+BENCHMARK(GridAccessTime)
+{
+	const size_t accesses = 10'000'000;
+	for (GridScene scene : { GridScene::FLOOR, GridScene::SCATTERED })
+	{
+		for (GridStorage storage : { GridStorage::DENSE, GridStorage::CHUNKED })
+		{
+			TestGrid grid(BENCH_WIDTH, BENCH_HEIGHT, BENCH_LENGTH, 1.0f, 0, storage);
+			DrawScene(grid, scene);
+			const std::string label = std::string(SceneName(scene)) + (storage == GridStorage::DENSE ? ", dense" : ", chunked");
+
+			// The coordinates are generated up front so that the random number generator isn't measured.
+			std::mt19937 random(3);
+			std::vector<std::array<int, 3>> coords(4096);
+			for (auto& c : coords) c = { int(random() % BENCH_WIDTH), int(random() % BENCH_HEIGHT), int(random() % BENCH_LENGTH) };
+
+			int sum = 0;
+			const double readSeconds = MeasureSeconds([&]()
+				{
+					for (size_t a = 0; a < accesses; ++a)
+					{
+						const auto& c = coords[a % coords.size()];
+						sum += grid.getCel(c[0], c[1], c[2]);
+					}
+				}, 3);
+			ReportResult(label + ", random read", readSeconds * 1e9 / accesses, "ns");
+
+			// Writing back the value that's already there keeps the grid's contents (and its bricks) the same between runs.
+			const double writeSeconds = MeasureSeconds([&]()
+				{
+					for (size_t a = 0; a < accesses; ++a)
+					{
+						const auto& c = coords[a % coords.size()];
+						grid.setCel(c[0], c[1], c[2], grid.getCel(c[0], c[1], c[2]));
+					}
+				}, 3);
+			ReportResult(label + ", random read + write", writeSeconds * 1e9 / accesses, "ns");
+
+			size_t visited = 0;
+			const double visitSeconds = MeasureSeconds([&]()
+				{
+					grid.forEachCel(0, BENCH_HEIGHT - 1, [&](size_t, const int& cel) { visited += cel; });
+				}, 3);
+			ReportResult(label + ", forEachCel", visitSeconds * 1e3, "ms");
+
+			// Uses the results, so that the loops aren't optimized away.
+			CHECK(sum >= 0);
+			CHECK(visited > 0);
+		}
+	}
+}
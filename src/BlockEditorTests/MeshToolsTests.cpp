@@ -0,0 +1,98 @@
+#include "stdafx.h"
+#include "TestMaps.h"
+#include "Test.h"
+#include "MeshTools.h"
+
+// The position, texture coordinates and normal of a vertex.
+typedef std::array<float, 8> MeshVertex;
+
+// Returns the sorted triangles of the mesh, each given by the attributes of its corners.
+// The corners are rotated to start with the smallest one, which keeps the triangle's winding.
+static std::vector<std::array<MeshVertex, 3>> MeshTriangles(const RLMesh& mesh)
+{
+	std::vector<std::array<MeshVertex, 3>> triangles;
+	for (int t = 0; t < mesh.triangleCount; ++t)
+	{
+		std::array<MeshVertex, 3> triangle;
+		for (int c = 0; c < 3; ++c)
+		{
+			const int v = mesh.indices[t * 3 + c];
+			triangle[c] = { mesh.vertices[v * 3], mesh.vertices[v * 3 + 1], mesh.vertices[v * 3 + 2], mesh.texcoords[v * 2], mesh.texcoords[v * 2 + 1],
+				mesh.normals[v * 3], mesh.normals[v * 3 + 1], mesh.normals[v * 3 + 2] };
+		}
+		std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+		triangles.push_back(triangle);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+TEST_CASE(VertexCacheAnalysisCountsMisses)
+{
+	// A strip of 10 triangles, each sharing two vertices with the one before it
+	std::vector<unsigned short> indices;
+	for (unsigned short t = 0; t < 10; ++t) indices.insert(indices.end(), { t, (unsigned short)(t + 1), (unsigned short)(t + 2) });
+	RLMesh strip = {};
+	strip.vertexCount = 12;
+	strip.triangleCount = 10;
+	strip.indices = indices.data();
+
+	// Any cache that holds a triangle only transforms each vertex once
+	MeshCacheStats stats = AnalyzeMeshVertexCache(strip);
+	CHECK(stats.transforms == 12 && stats.triangles == 10 && stats.vertices == 12);
+	CHECK(FloatEquals(stats.ACMR(), 1.2f));
+	CHECK(FloatEquals(stats.ATVR(), 1.0f));
+	CHECK(AnalyzeMeshVertexCache(strip, 3).transforms == 12);
+
+	// A cache of one vertex misses every time, which is the worst possible
+	stats = AnalyzeMeshVertexCache(strip, 1);
+	CHECK(stats.transforms == 30);
+	CHECK(FloatEquals(stats.ACMR(), 3.0f));
+
+	// Drawing the same triangle again is free
+	indices = { 0, 1, 2, 0, 1, 2 };
+	strip.vertexCount = 3;
+	strip.triangleCount = 2;
+	strip.indices = indices.data();
+	CHECK(FloatEquals(AnalyzeMeshVertexCache(strip).ACMR(), 1.5f));
+}
+
+TEST_CASE(VertexCacheOptimizationKeepsTriangles)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	TileGrid grid(mapMan.get(), 32, 6, 32, GridStorage::CHUNKED);
+	FillTestMap(grid, assets, 34, 0.4f);
+
+	// Welded, so that neighboring tiles share vertices that the cache can reuse
+	RLModel model = grid.GenerateModel(true, false, true);
+	REQUIRE(model.meshCount > 0);
+	for (int m = 0; m < model.meshCount; ++m)
+	{
+		RLMesh& mesh = model.meshes[m];
+		const std::vector<std::array<MeshVertex, 3>> triangles = MeshTriangles(mesh);
+		const int vertexCount = mesh.vertexCount;
+		const MeshCacheStats before = AnalyzeMeshVertexCache(mesh);
+
+		OptimizeMeshVertexCache(mesh);
+		const MeshCacheStats after = AnalyzeMeshVertexCache(mesh);
+		CHECK(after.ACMR() <= before.ACMR());
+		CHECK(MeshTriangles(mesh) == triangles);
+
+		// Reordering the vertices moves every attribute along with them, and doesn't change what the cache sees
+		OptimizeMeshVertexFetch(mesh);
+		CHECK(mesh.vertexCount == vertexCount);
+		CHECK(AnalyzeMeshVertexCache(mesh).transforms == after.transforms);
+		CHECK(MeshTriangles(mesh) == triangles);
+
+		// The indices use the vertices in order the first time they reach them
+		int nextVertex = 0;
+		for (int i = 0; i < mesh.triangleCount * 3; ++i)
+		{
+			CHECK(mesh.indices[i] <= nextVertex);
+			if (mesh.indices[i] == nextVertex) ++nextVertex;
+		}
+		CHECK(nextVertex == vertexCount);
+	}
+	UnloadModel(model);
+}
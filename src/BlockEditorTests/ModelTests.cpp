@@ -0,0 +1,441 @@
+#include "stdafx.h"
+#include "TestMaps.h"
+#include "Test.h"
+
+// Geometry of one texture, as the model generation used to collect it.
+struct LegacyMesh final
+{
+	std::vector<float> positions, texCoords, normals;
+	std::vector<unsigned int> indices;
+};
+
+// Returns the rotation of the tile, either made from its angles like the old model generation did, or taken from
+// TileOrientationMatrices(), whose elements are exact. Rotations made from angles are a little off, which is enough to throw
+// the old culling's exact comparisons off far from the origin.
+static Matrix LegacyRotation(const Tile& tile, bool exactRotations)
+{
+	return exactRotations ? TileOrientationMatrices()[TileOrientation(tile)] : TileRotationMatrix(tile);
+}
+
+// Returns true if the neighbor of cel (x, y, z) that the triangle faces has a triangle in the same place, facing the other way,
+// or if the neighbor's triangles in that plane add up to the area of the whole side.
+// This is how culling used to work: every triangle of the neighbor is transformed and compared with the culled one.
+static bool LegacyIsCulled(const TileGrid& grid, const MapMan& mapMan, bool exactRotations, int x, int y, int z, Vector3 v0, Vector3 v1, Vector3 v2)
+{
+	const Vector3 planeNormal = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(v1, v0), Vector3Subtract(v2, v0)));
+	const float planeDistance = -Vector3DotProduct(planeNormal, v0);
+
+	int neighborX = x, neighborY = y, neighborZ = z;
+	if (Vector3Equals(planeNormal, Vector3{ +1.0f, 0.0f, 0.0f })) neighborX += 1;
+	else if (Vector3Equals(planeNormal, Vector3{ -1.0f, 0.0f, 0.0f })) neighborX -= 1;
+	else if (Vector3Equals(planeNormal, Vector3{ 0.0f, 0.0f, -1.0f })) neighborZ -= 1;
+	else if (Vector3Equals(planeNormal, Vector3{ 0.0f, 0.0f, +1.0f })) neighborZ += 1;
+	else if (Vector3Equals(planeNormal, Vector3{ 0.0f, +1.0f, 0.0f })) neighborY += 1;
+	else if (Vector3Equals(planeNormal, Vector3{ 0.0f, -1.0f, 0.0f })) neighborY -= 1;
+	else return false;
+
+	if (neighborX < 0 || neighborY < 0 || neighborZ < 0 || neighborX >= int(grid.GetWidth()) || neighborY >= int(grid.GetHeight()) || neighborZ >= int(grid.GetLength()))
+		return false;
+
+	const Tile neighborTile = grid.GetTile(neighborX, neighborY, neighborZ);
+	if (!neighborTile) return false;
+
+	const Vector3 nWorldPos = grid.GridToWorldPos(Vector3{ float(neighborX), float(neighborY), float(neighborZ) }, true);
+	const Matrix nMatrix = MatrixMultiply(LegacyRotation(neighborTile, exactRotations), MatrixTranslate(nWorldPos.x, nWorldPos.y, nWorldPos.z));
+	const RLModel neighborModel = mapMan.ModelFromID(neighborTile.shape);
+	float coveredArea = 0.0f;
+	for (int nm = 0; nm < neighborModel.meshCount; ++nm)
+	{
+		const RLMesh& neighborMesh = neighborModel.meshes[nm];
+		for (int nt = 0; nt < neighborMesh.triangleCount; ++nt)
+		{
+			Vector3 n[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				const float* vertex = &neighborMesh.vertices[neighborMesh.indices[nt * 3 + c] * 3];
+				n[c] = Vector3Transform(Vector3{ vertex[0], vertex[1], vertex[2] }, nMatrix);
+			}
+			const Vector3 nPlaneNormal = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(n[1], n[0]), Vector3Subtract(n[2], n[0])));
+			const float nPlaneDistance = -Vector3DotProduct(nPlaneNormal, n[0]);
+
+			if (FloatEquals(fabsf(nPlaneDistance), fabsf(planeDistance)) && FloatEquals(Vector3DotProduct(nPlaneNormal, planeNormal), -1.0f))
+			{
+				auto isCorner = [&](Vector3 v) { return Vector3Equals(v, n[0]) || Vector3Equals(v, n[1]) || Vector3Equals(v, n[2]); };
+				if (isCorner(v0) && isCorner(v1) && isCorner(v2)) return true;
+				const Vector3 cross = Vector3CrossProduct(Vector3Subtract(n[1], n[0]), Vector3Subtract(n[2], n[0]));
+				coveredArea += sqrtf(Vector3DotProduct(cross, cross)) / 2.0f;
+			}
+		}
+	}
+	return FloatEquals(coveredArea, grid.GetSpacing() * grid.GetSpacing());
+}
+
+// Builds the geometry of the grid the way _GenerateModel did before shapes were cached in every orientation:
+// every vertex and normal of every tile is transformed with a matrix made from the tile's angles. Returns one mesh per texture.
+// See LegacyRotation() for `exactRotations`.
+static std::vector<LegacyMesh> GenerateLegacyModel(const TileGrid& grid, const MapMan& mapMan, bool culling, bool exactRotations = false)
+{
+	std::vector<LegacyMesh> meshes(mapMan.GetNumTextures());
+	for (int y = 0; y < int(grid.GetHeight()); ++y)
+	{
+		for (int z = 0; z < int(grid.GetLength()); ++z)
+		{
+			for (int x = 0; x < int(grid.GetWidth()); ++x)
+			{
+				const Tile tile = grid.GetTile(x, y, z);
+				if (!tile) continue;
+
+				const Vector3 worldPos = grid.GridToWorldPos(Vector3{ float(x), float(y), float(z) }, true);
+				const Matrix rotation = LegacyRotation(tile, exactRotations);
+				const Matrix matrix = MatrixMultiply(rotation, MatrixTranslate(worldPos.x, worldPos.y, worldPos.z));
+				const RLModel model = mapMan.ModelFromID(tile.shape);
+				LegacyMesh& mesh = meshes[tile.texture];
+				for (int m = 0; m < model.meshCount; ++m)
+				{
+					const RLMesh& shape = model.meshes[m];
+					const unsigned int vBase = unsigned(mesh.positions.size() / 3);
+					for (int v = 0; v < shape.vertexCount; ++v)
+					{
+						const Vector3 position = Vector3Transform(Vector3{ shape.vertices[v * 3], shape.vertices[v * 3 + 1], shape.vertices[v * 3 + 2] }, matrix);
+						mesh.positions.insert(mesh.positions.end(), { position.x, position.y, position.z });
+						const Vector3 normal = Vector3Transform(Vector3{ shape.normals[v * 3], shape.normals[v * 3 + 1], shape.normals[v * 3 + 2] }, rotation);
+						mesh.normals.insert(mesh.normals.end(), { normal.x, normal.y, normal.z });
+						mesh.texCoords.insert(mesh.texCoords.end(), { shape.texcoords[v * 2], shape.texcoords[v * 2 + 1] });
+					}
+					for (int tri = 0; tri < shape.triangleCount; ++tri)
+					{
+						const unsigned int i0 = vBase + shape.indices[tri * 3], i1 = vBase + shape.indices[tri * 3 + 1], i2 = vBase + shape.indices[tri * 3 + 2];
+						auto position = [&](unsigned int i) { return Vector3{ mesh.positions[i * 3], mesh.positions[i * 3 + 1], mesh.positions[i * 3 + 2] }; };
+						if (culling && LegacyIsCulled(grid, mapMan, exactRotations, x, y, z, position(i0), position(i1), position(i2))) continue;
+						mesh.indices.insert(mesh.indices.end(), { i0, i1, i2 });
+					}
+				}
+			}
+		}
+	}
+	return meshes;
+}
+
+// Copies the geometry into arrays of its own and frees them again, which the old model generation
+// also had to do to turn its meshes into a model. Only used to make the benchmarks fair.
+static void CopyLegacyMeshes(const std::vector<LegacyMesh>& meshes)
+{
+	for (const LegacyMesh& mesh : meshes)
+	{
+		float* positions = SAFE_MALLOC(float, mesh.positions.size());
+		float* normals = SAFE_MALLOC(float, mesh.normals.size());
+		float* texCoords = SAFE_MALLOC(float, mesh.texCoords.size());
+		unsigned short* indices = SAFE_MALLOC(unsigned short, mesh.indices.size());
+		memcpy(positions, mesh.positions.data(), mesh.positions.size() * sizeof(float));
+		memcpy(normals, mesh.normals.data(), mesh.normals.size() * sizeof(float));
+		memcpy(texCoords, mesh.texCoords.data(), mesh.texCoords.size() * sizeof(float));
+		std::copy(mesh.indices.begin(), mesh.indices.end(), indices);
+		free(positions);
+		free(normals);
+		free(texCoords);
+		free(indices);
+	}
+}
+
+// Returns the sorted triangles of each texture of the old model generation's meshes.
+static std::map<int, std::vector<TriangleKey>> TrianglesByTexture(const std::vector<LegacyMesh>& meshes)
+{
+	std::map<int, std::vector<TriangleKey>> triangles;
+	for (size_t t = 0; t < meshes.size(); ++t)
+	{
+		const LegacyMesh& mesh = meshes[t];
+		if (mesh.indices.empty()) continue;
+
+		std::vector<TriangleKey>& list = triangles[int(t)];
+		for (size_t i = 0; i < mesh.indices.size(); i += 3)
+		{
+			Vector3 corners[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				const float* vertex = &mesh.positions[mesh.indices[i + c] * 3];
+				corners[c] = Vector3{ vertex[0], vertex[1], vertex[2] };
+			}
+			list.push_back(MakeTriangleKey(corners));
+		}
+		std::sort(list.begin(), list.end());
+	}
+	return triangles;
+}
+
+TEST_CASE(BoundarySignaturesMatchBruteForceCulling)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+
+	// The denser maps have more neighbors of every shape and orientation touching each other.
+	for (const auto& [seed, density] : { std::pair<unsigned, float>{ 11, 0.2f }, { 12, 0.5f }, { 13, 0.8f }, { 14, 1.0f } })
+	{
+		TileGrid grid(mapMan.get(), 64, 6, 64, GridStorage::CHUNKED);
+		FillTestMap(grid, assets, seed, density);
+
+		RLModel model = grid.GenerateModel(true, false, false);
+		CHECK(TrianglesByTexture(model) == TrianglesByTexture(GenerateLegacyModel(grid, *mapMan, true, true)));
+		UnloadModel(model);
+	}
+
+	// The test cube splits opposite sides along different diagonals, so only the outside of a solid block is left if whole sides hide each other.
+	TileGrid block(mapMan.get(), 4, 4, 4, GridStorage::CHUNKED);
+	block.SetTileRect(0, 0, 0, 4, 4, 4, Tile(assets.cube, 0, assets.textures[0], 0));
+	RLModel model = block.GenerateModel(true, false, false);
+	int triangleCount = 0;
+	for (int m = 0; m < model.meshCount; ++m) triangleCount += model.meshes[m].triangleCount;
+	CHECK(triangleCount == 6 * 4 * 4 * 2);
+	UnloadModel(model);
+}
+
+TEST_CASE(BoundarySignaturesCullWhatBruteForceCulls)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	TileGrid grid(mapMan.get(), 96, 6, 96, GridStorage::CHUNKED);
+	FillTestMap(grid, assets, 15, 0.5f);
+
+	// With rotations made from angles, the brute force misses some of the faces that the signatures cull, but it never culls one that they keep.
+	RLModel model = grid.GenerateModel(true, false, false);
+	auto triangles = TrianglesByTexture(model);
+	for (auto& [texture, legacyTriangles] : TrianglesByTexture(GenerateLegacyModel(grid, *mapMan, true)))
+	{
+		CHECK(std::includes(legacyTriangles.begin(), legacyTriangles.end(), triangles[texture].begin(), triangles[texture].end()));
+	}
+	UnloadModel(model);
+}
+
+TEST_CASE(LargeMeshesAreSplitWithoutWrapping)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	// The floor alone has 128 * 128 cubes with the first texture, which have far more vertices than 16-bit indices can reach, even with their hidden faces culled.
+	TileGrid grid(mapMan.get(), 128, 3, 128, GridStorage::CHUNKED);
+	FillTestMap(grid, assets, 16, 0.2f);
+
+	for (const auto& [culling, weld] : { std::pair{ false, false }, { true, false }, { true, true } })
+	{
+		RLModel model = grid.GenerateModel(culling, false, weld);
+		int firstTextureMeshes = 0;
+		for (int m = 0; m < model.meshCount; ++m)
+		{
+			const RLMesh& mesh = model.meshes[m];
+			CHECK(mesh.vertexCount <= MODEL_MESH_MAX_VERTICES);
+			CHECK(*std::max_element(mesh.indices, mesh.indices + mesh.triangleCount * 3) < mesh.vertexCount);
+			CHECK(std::find(mesh.indices, mesh.indices + mesh.triangleCount * 3, 65535) == mesh.indices + mesh.triangleCount * 3); // Reserved by glTF
+			if (model.meshMaterial[m] == assets.textures[0]) ++firstTextureMeshes;
+		}
+		CHECK(firstTextureMeshes > 1);
+
+		// Indices that wrapped around would point at the wrong vertices, so the triangles wouldn't match the old generation's 32-bit ones.
+		CHECK(TrianglesByTexture(model) == TrianglesByTexture(GenerateLegacyModel(grid, *mapMan, culling, true)));
+		UnloadModel(model);
+	}
+}
+
+// The surface of one texture in one axis-aligned plane: its doubled area, and how many triangles cover each of a grid of sample points.
+// Every other triangle is kept as it is.
+struct TextureSurface final
+{
+	std::map<std::tuple<int, int, int32_t>, int64_t> planeAreas; // Keyed by axis, facing direction and position along the axis
+	std::map<std::tuple<int, int, int32_t, int64_t, int64_t>, int> sampleCoverage; // Plane, then the sample's position in it
+	std::vector<TriangleKey> slanted;
+
+	bool operator==(const TextureSurface& other) const = default;
+};
+
+// Returns the surface of each texture of the model, in the units of TriangleKey.
+static std::map<int, TextureSurface> SurfaceByTexture(const RLModel& model)
+{
+	// Vertices lie on multiples of a quarter of a cel, so samples a quarter of a cel apart, offset by odd fractions, never land on an edge.
+	const double step = TILE_SPACING_DEFAULT * 1024.0 / 4.0, offsetU = 0.3183, offsetV = 0.7071;
+	std::map<int, TextureSurface> surfaces;
+	for (const auto& [texture, triangles] : TrianglesByTexture(model))
+	{
+		TextureSurface& surface = surfaces[texture];
+		for (const TriangleKey& triangle : triangles)
+		{
+			int64_t edges[2][3], normal[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				edges[0][c] = int64_t(triangle[1][c]) - triangle[0][c];
+				edges[1][c] = int64_t(triangle[2][c]) - triangle[0][c];
+			}
+			for (int c = 0; c < 3; ++c) normal[c] = edges[0][(c + 1) % 3] * edges[1][(c + 2) % 3] - edges[0][(c + 2) % 3] * edges[1][(c + 1) % 3];
+			const int axis = (normal[1] == 0 && normal[2] == 0) ? 0 : (normal[0] == 0 && normal[2] == 0) ? 1 : (normal[0] == 0 && normal[1] == 0) ? 2 : -1;
+			if (axis < 0 || normal[axis] == 0)
+			{
+				surface.slanted.push_back(triangle);
+				continue;
+			}
+
+			const auto plane = std::make_tuple(axis, normal[axis] > 0 ? 1 : -1, triangle[0][axis]);
+			surface.planeAreas[plane] += std::abs(normal[axis]);
+
+			// Count the samples strictly inside of the triangle, projected onto the plane
+			const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+			double corners[3][2];
+			for (int c = 0; c < 3; ++c) corners[c][0] = triangle[c][u], corners[c][1] = triangle[c][v];
+			const double minU = std::min({ corners[0][0], corners[1][0], corners[2][0] }), maxU = std::max({ corners[0][0], corners[1][0], corners[2][0] });
+			const double minV = std::min({ corners[0][1], corners[1][1], corners[2][1] }), maxV = std::max({ corners[0][1], corners[1][1], corners[2][1] });
+			for (int64_t i = int64_t(floor(minU / step - offsetU)); (double(i) + offsetU) * step < maxU; ++i)
+			{
+				for (int64_t j = int64_t(floor(minV / step - offsetV)); (double(j) + offsetV) * step < maxV; ++j)
+				{
+					const double pu = (double(i) + offsetU) * step, pv = (double(j) + offsetV) * step;
+					int positive = 0, negative = 0;
+					for (int c = 0; c < 3; ++c)
+					{
+						const double* a = corners[c];
+						const double* b = corners[(c + 1) % 3];
+						const double side = (b[0] - a[0]) * (pv - a[1]) - (b[1] - a[1]) * (pu - a[0]);
+						if (side > 0.0) ++positive;
+						if (side < 0.0) ++negative;
+					}
+					if (positive == 3 || negative == 3) ++surface.sampleCoverage[std::tuple_cat(plane, std::make_tuple(i, j))];
+				}
+			}
+		}
+		std::sort(surface.slanted.begin(), surface.slanted.end());
+	}
+	return surfaces;
+}
+
+TEST_CASE(GreedyMeshesCoverTheCulledSurface)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	for (const auto& [seed, density] : { std::pair<unsigned, float>{ 25, 0.2f }, { 26, 0.6f } })
+	{
+		TileGrid grid(mapMan.get(), 24, 5, 24, GridStorage::CHUNKED);
+		FillTestMap(grid, assets, seed, density);
+
+		RLModel culled = grid.GenerateModel(true, false, false);
+		RLModel greedy = grid.GenerateModel(true, true, false);
+		const std::map<int, TextureSurface> culledSurfaces = SurfaceByTexture(culled), greedySurfaces = SurfaceByTexture(greedy);
+		CHECK(greedy.meshes[0].triangleCount < culled.meshes[0].triangleCount);
+		UnloadModel(culled);
+		UnloadModel(greedy);
+
+		// Each texture has the same area in every plane, and each sample is covered as many times, so the quads neither leave gaps nor overlap
+		REQUIRE(culledSurfaces.size() == greedySurfaces.size());
+		for (const auto& [texture, surface] : culledSurfaces)
+		{
+			const TextureSurface& greedySurface = greedySurfaces.at(texture);
+			CHECK(surface.planeAreas == greedySurface.planeAreas);
+			CHECK(surface.sampleCoverage == greedySurface.sampleCoverage);
+			CHECK(surface.slanted == greedySurface.slanted);
+			bool overlaps = false;
+			for (const auto& [sample, count] : greedySurface.sampleCoverage) overlaps = overlaps || count > 1;
+			CHECK(!overlaps);
+		}
+	}
+}
+
+// Returns the fastest of a few runs of GenerateModel, without counting the time taken to free the models.
+static double MeasureGenerateModel(TileGrid& grid, bool culling, bool greedy, bool weld, int repeats)
+{
+	double best = DBL_MAX;
+	for (int r = 0; r < repeats; ++r)
+	{
+		RLModel model{};
+		best = std::min(best, MeasureSeconds([&]() { model = grid.GenerateModel(culling, greedy, weld); }));
+		UnloadModel(model);
+	}
+	return best;
+}
+
+BENCHMARK(ModelGeneration)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	TileGrid grid(mapMan.get(), 128, 8, 128, GridStorage::CHUNKED);
+	FillTestMap(grid, assets, 9, 0.1f);
+	TileGridInspector::RegenBatches(grid);
+
+	for (bool culling : { false, true })
+	{
+		const std::string label = std::string("128x8x128, ") + (culling ? "culled" : "not culled");
+
+		std::vector<LegacyMesh> legacy;
+		const double legacySeconds = MeasureSeconds([&]()
+			{
+				legacy = GenerateLegacyModel(grid, *mapMan, culling);
+				CopyLegacyMeshes(legacy);
+			}, 3);
+		ReportResult(label + ", transformed per tile (before)", legacySeconds * 1e3, "ms");
+		ReportResult(label + ", cached orientations (after)", MeasureGenerateModel(grid, culling, false, false, 3) * 1e3, "ms");
+
+		RLModel model = grid.GenerateModel(culling, false, false);
+		size_t triangles = 0, legacyTriangles = 0;
+		for (int m = 0; m < model.meshCount; ++m) triangles += size_t(model.meshes[m].triangleCount);
+		for (const LegacyMesh& mesh : legacy) legacyTriangles += mesh.indices.size() / 3;
+		ReportResult(label + ", triangles (before)", double(legacyTriangles), "");
+		ReportResult(label + ", triangles (after)", double(triangles), "");
+		UnloadModel(model);
+
+		// Far from the origin, the vertices transformed by the old path are too far off for its exact comparisons,
+		// so it leaves some hidden faces in. Only the counts without culling have to match.
+		if (!culling) CHECK(triangles == legacyTriangles);
+	}
+}
+
+BENCHMARK(GreedyMeshingReduction)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	for (const auto& [name, density] : { std::pair<std::string, float>{ "128x8x128, 10% filled", 0.1f }, { "128x8x128, 60% filled", 0.6f }, { "128x8x128, solid cubes", -1.0f } })
+	{
+		TileGrid grid(mapMan.get(), 128, 8, 128, GridStorage::CHUNKED);
+		if (density >= 0.0f) FillTestMap(grid, assets, 27, density);
+		else grid.SetTileRect(0, 0, 0, 128, 8, 128, Tile(assets.cube, 0, assets.textures[0], 0));
+
+		size_t counts[2][2] = {}; // Triangles and vertices, without and with greedy meshing
+		size_t welded[2] = {};
+		for (bool greedy : { false, true })
+		{
+			RLModel model = grid.GenerateModel(true, greedy, true, nullptr, 0, nullptr, &welded[greedy]);
+			for (int m = 0; m < model.meshCount; ++m)
+			{
+				counts[greedy][0] += size_t(model.meshes[m].triangleCount);
+				counts[greedy][1] += size_t(model.meshes[m].vertexCount);
+			}
+			UnloadModel(model);
+		}
+		ReportResult(name + ", triangles, culled", double(counts[0][0]), "");
+		ReportResult(name + ", triangles, greedy", double(counts[1][0]), "");
+		ReportResult(name + ", vertices, culled and welded", double(counts[0][1]), "");
+		ReportResult(name + ", vertices, greedy and welded", double(counts[1][1]), "");
+		ReportResult(name + ", vertices removed by welding, culled", double(welded[0]), "");
+		ReportResult(name + ", vertices removed by welding, greedy", double(welded[1]), "");
+		ReportResult(name + ", triangle reduction", double(counts[0][0]) / double(counts[1][0]), "x");
+		CHECK(counts[1][0] < counts[0][0]);
+	}
+}
+
+BENCHMARK(DetailLevelTriangles)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	for (const auto& [name, density] : { std::pair<std::string, float>{ "128x16x128, 10% filled", 0.1f }, { "128x16x128, 40% filled", 0.4f } })
+	{
+		TileGrid grid(mapMan.get(), 128, 16, 128, GridStorage::CHUNKED);
+		FillTestMap(grid, assets, 37, density);
+
+		// Level 0 is the map itself, and level n is downsampled by 2^n
+		for (int level = 0; level <= 3; ++level)
+		{
+			const int factor = 1 << level;
+			TileGrid coarse;
+			const double seconds = (level > 0) ? MeasureSeconds([&]() { coarse = grid.Downsample(factor); }) : 0.0;
+			RLModel model = ((level > 0) ? coarse : grid).GenerateModel(true, false, false);
+			size_t triangles = 0;
+			for (int m = 0; m < model.meshCount; ++m) triangles += size_t(model.meshes[m].triangleCount);
+			UnloadModel(model);
+
+			const std::string label = name + ", level " + std::to_string(level) + " (1/" + std::to_string(factor) + ")";
+			ReportResult(label + ", triangles", double(triangles), "");
+			if (level > 0) ReportResult(label + ", downsampling", seconds * 1e3, "ms");
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cfloat>
+
+// A small test and benchmark harness for blockeditor-tests.
+// Tests are registered with TEST_CASE and run by default. Benchmarks are registered with BENCHMARK and only run with --bench,
+// since they build large maps and take a while. Both are plain functions that report problems through CHECK and REQUIRE.
+
+struct TestCase final
+{
+	const char* name;
+	void (*function)();
+	bool benchmark;
+};
+
+std::vector<TestCase>& GetTestCases();
+
+struct TestRegistrar final
+{
+	TestRegistrar(const char* name, void (*function)(), bool benchmark)
+	{
+		GetTestCases().push_back({ name, function, benchmark });
+	}
+};
+
+// Prints a failed check and marks the current test as failed.
+void ReportFailure(const char* file, int line, const char* expression);
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static TestRegistrar name##Registrar(#name, name, false); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static TestRegistrar name##Registrar(#name, name, true); \
+	static void name()
+
+// Reports a failure and keeps going.
+#define CHECK(expression) do { if (!(expression)) ReportFailure(__FILE__, __LINE__, #expression); } while (false)
+
+// Reports a failure and leaves the test.
+#define REQUIRE(expression) do { if (!(expression)) { ReportFailure(__FILE__, __LINE__, #expression); return; } } while (false)
+
+// Runs `function` `repeats` times and returns the fastest run in seconds.
+template<class Function>
+double MeasureSeconds(Function function, int repeats = 1)
+{
+	double best = DBL_MAX;
+	for (int r = 0; r < repeats; ++r)
+	{
+		const auto startTime = std::chrono::steady_clock::now();
+		function();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+	}
+	return best;
+}
+
+// Returns the memory that the process is using right now, in bytes.
+size_t GetMemoryUsage();
+
+// Runs `function` while another thread samples the memory usage, and returns the most that the usage went up by, in bytes.
+template<class Function>
+size_t MeasurePeakMemory(Function function)
+{
+	const size_t before = GetMemoryUsage();
+	std::atomic<size_t> peak = before;
+	std::atomic<bool> done = false;
+	std::thread sampler([&]()
+		{
+			while (!done)
+			{
+				peak = std::max(peak.load(), GetMemoryUsage());
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	function();
+	done = true;
+	sampler.join();
+	return std::max(peak.load(), GetMemoryUsage()) - before;
+}
+
+// Prints one line of benchmark results.
+inline void ReportResult(const std::string& label, double value, const char* unit)
+{
+	std::cout << "    " << std::left << std::setw(56) << label << " " << std::fixed << std::setprecision(3) << value << " " << unit << std::endl;
+	std::cout.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,77 @@
+#include "stdafx.h"
+#include "TestGLTF.h"
+
+bool LoadTestGLB(const std::filesystem::path& path, TestGLB& glb)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return false;
+
+	uint32_t header[3] = {};
+	if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+	if (header[0] != 0x46546C67U || header[1] != 2U) return false;
+
+	bool hasJson = false;
+	uint32_t chunk[2] = {};
+	while (file.read(reinterpret_cast<char*>(chunk), sizeof(chunk)))
+	{
+		std::vector<uint8_t> data(chunk[0]);
+		if (!file.read(reinterpret_cast<char*>(data.data()), data.size())) return false;
+
+		if (chunk[1] == 0x4E4F534AU)
+		{
+			glb.json = nlohmann::json::parse(data.begin(), data.end(), nullptr, false);
+			hasJson = !glb.json.is_discarded();
+		}
+		else if (chunk[1] == 0x004E4942U)
+		{
+			glb.bin = std::move(data);
+		}
+	}
+	return hasJson;
+}
+
+std::vector<double> ReadAccessor(const TestGLB& glb, int accessor)
+{
+	const nlohmann::json& info = glb.json["accessors"][accessor];
+	const nlohmann::json& view = glb.json["bufferViews"][info["bufferView"].get<int>()];
+
+	static const std::map<std::string, size_t> TYPE_COMPONENTS = { { "SCALAR", 1 }, { "VEC2", 2 }, { "VEC3", 3 }, { "VEC4", 4 }, { "MAT4", 16 } };
+	const size_t components = TYPE_COMPONENTS.at(info["type"].get<std::string>());
+	const int componentType = info["componentType"];
+	const size_t componentSize = (componentType == 5120 || componentType == 5121) ? 1 : (componentType == 5122 || componentType == 5123) ? 2 : 4;
+	const size_t count = info["count"];
+	const size_t stride = view.value("byteStride", components * componentSize);
+	const bool normalized = info.value("normalized", false);
+	const uint8_t* data = glb.bin.data() + view.value("byteOffset", size_t(0)) + info.value("byteOffset", size_t(0));
+
+	std::vector<double> values;
+	values.reserve(count * components);
+	for (size_t e = 0; e < count; ++e)
+	{
+		for (size_t c = 0; c < components; ++c)
+		{
+			const uint8_t* p = data + e * stride + c * componentSize;
+			double value = 0.0;
+			switch (componentType)
+			{
+			case 5120: { int8_t v; memcpy(&v, p, 1); value = normalized ? std::max(v / 127.0, -1.0) : v; break; }
+			case 5121: { uint8_t v; memcpy(&v, p, 1); value = normalized ? v / 255.0 : v; break; }
+			case 5122: { int16_t v; memcpy(&v, p, 2); value = normalized ? std::max(v / 32767.0, -1.0) : v; break; }
+			case 5123: { uint16_t v; memcpy(&v, p, 2); value = normalized ? v / 65535.0 : v; break; }
+			case 5125: { uint32_t v; memcpy(&v, p, 4); value = v; break; }
+			case 5126: { float v; memcpy(&v, p, 4); value = v; break; }
+			}
+			values.push_back(value);
+		}
+	}
+	return values;
+}
+
+size_t LoadAllAccessors(const std::filesystem::path& path)
+{
+	TestGLB glb;
+	if (!LoadTestGLB(path, glb)) return 0;
+	size_t values = 0;
+	for (size_t a = 0; a < glb.json["accessors"].size(); ++a) values += ReadAccessor(glb, int(a)).size();
+	return values;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// Reads back the .glb files written by MapMan::ExportGLTFScene, so that the tests can look at what was exported.
+struct TestGLB final
+{
+	nlohmann::json json;
+	std::vector<uint8_t> bin;
+};
+
+// Loads the JSON and binary chunks of a .glb file. Returns false if the file can't be read or isn't a valid .glb.
+bool LoadTestGLB(const std::filesystem::path& path, TestGLB& glb);
+
+// Returns every component of every element of the accessor as a double, in order.
+// Normalized integers are turned into the values they stand for, as in the glTF specification.
+std::vector<double> ReadAccessor(const TestGLB& glb, int accessor);
+
+// Loads the file like a loader would: parses the JSON and decodes every accessor. Returns the number of values read, or 0 if it can't be loaded.
+size_t LoadAllAccessors(const std::filesystem::path& path);
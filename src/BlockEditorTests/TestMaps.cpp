@@ -0,0 +1,187 @@
+#include "stdafx.h"
+#include "TestMaps.h"
+
+#include <sstream>
+
+// Writes a shape with one face per entry of `faces`, each given as indices into `positions`.
+// The faces are turned to point away from the shape's center, and their texture coordinates are projected along their normal.
+static void WriteShape(const std::filesystem::path& path, const char* name, const std::vector<Vector3>& positions, std::vector<std::vector<int>> faces)
+{
+	Vector3 center = Vector3Zero();
+	for (const Vector3& p : positions) center = Vector3Add(center, p);
+	center = Vector3Scale(center, 1.0f / float(positions.size()));
+
+	std::ostringstream normals, uvs, triangles;
+	int uvCount = 0;
+	for (size_t f = 0; f < faces.size(); ++f)
+	{
+		std::vector<int>& face = faces[f];
+		Vector3 normal = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(positions[face[1]], positions[face[0]]), Vector3Subtract(positions[face[2]], positions[face[0]])));
+		if (Vector3DotProduct(normal, Vector3Subtract(positions[face[0]], center)) < 0.0f)
+		{
+			std::reverse(face.begin(), face.end());
+			normal = Vector3Scale(normal, -1.0f);
+		}
+		normals << "vn " << normal.x << " " << normal.y << " " << normal.z << "\n";
+
+		// Project onto the two axes that the normal points along the least
+		const Vector3 n = { fabsf(normal.x), fabsf(normal.y), fabsf(normal.z) };
+		const int axis = (n.x >= n.y && n.x >= n.z) ? 0 : (n.y >= n.z ? 1 : 2);
+		for (int v : face)
+		{
+			const float* p = &positions[v].x;
+			uvs << "vt " << (p[axis == 0 ? 1 : 0] + 1.0f) / 2.0f << " " << (p[axis == 2 ? 1 : 2] + 1.0f) / 2.0f << "\n";
+		}
+		for (size_t t = 1; t + 1 < face.size(); ++t)
+		{
+			triangles << "f";
+			for (size_t corner : { size_t(0), t, t + 1 })
+			{
+				triangles << " " << face[corner] + 1 << "/" << uvCount + corner + 1 << "/" << f + 1;
+			}
+			triangles << "\n";
+		}
+		uvCount += int(face.size());
+	}
+
+	// The shape loader stops at the first empty line.
+	std::ofstream file(path);
+	file << "o " << name << "\n";
+	for (const Vector3& p : positions) file << "v " << p.x << " " << p.y << " " << p.z << "\n";
+	file << normals.str() << uvs.str() << triangles.str() << "\n";
+}
+
+// Returns the index of (x, y, z) in `positions`, adding it if it isn't there.
+static int Corner(std::vector<Vector3>& positions, float x, float y, float z)
+{
+	for (size_t p = 0; p < positions.size(); ++p)
+	{
+		if (Vector3Equals(positions[p], Vector3{ x, y, z })) return int(p);
+	}
+	positions.push_back(Vector3{ x, y, z });
+	return int(positions.size()) - 1;
+}
+
+// Writes a box from -1 to 1 on X and Z, and from -1 to `top` on Y.
+static void WriteBox(const std::filesystem::path& path, const char* name, float top)
+{
+	std::vector<Vector3> p;
+	std::vector<std::vector<int>> faces = {
+		{ Corner(p, -1, -1, -1), Corner(p, -1, top, -1), Corner(p, -1, top, 1), Corner(p, -1, -1, 1) },
+		{ Corner(p, 1, -1, -1), Corner(p, 1, top, -1), Corner(p, 1, top, 1), Corner(p, 1, -1, 1) },
+		{ Corner(p, -1, -1, -1), Corner(p, 1, -1, -1), Corner(p, 1, -1, 1), Corner(p, -1, -1, 1) },
+		{ Corner(p, -1, top, -1), Corner(p, 1, top, -1), Corner(p, 1, top, 1), Corner(p, -1, top, 1) },
+		{ Corner(p, -1, -1, -1), Corner(p, 1, -1, -1), Corner(p, 1, top, -1), Corner(p, -1, top, -1) },
+		{ Corner(p, -1, -1, 1), Corner(p, 1, -1, 1), Corner(p, 1, top, 1), Corner(p, -1, top, 1) },
+	};
+	WriteShape(path, name, p, faces);
+}
+
+// Writes a ramp that rises from the +Z side of its cel to the top of its -Z side.
+static void WriteWedge(const std::filesystem::path& path)
+{
+	std::vector<Vector3> p;
+	std::vector<std::vector<int>> faces = {
+		{ Corner(p, -1, -1, -1), Corner(p, 1, -1, -1), Corner(p, 1, -1, 1), Corner(p, -1, -1, 1) },
+		{ Corner(p, -1, -1, -1), Corner(p, 1, -1, -1), Corner(p, 1, 1, -1), Corner(p, -1, 1, -1) },
+		{ Corner(p, -1, -1, 1), Corner(p, 1, -1, 1), Corner(p, 1, 1, -1), Corner(p, -1, 1, -1) },
+		{ Corner(p, -1, -1, -1), Corner(p, -1, -1, 1), Corner(p, -1, 1, -1) },
+		{ Corner(p, 1, -1, -1), Corner(p, 1, -1, 1), Corner(p, 1, 1, -1) },
+	};
+	WriteShape(path, "wedge", p, faces);
+}
+
+std::unique_ptr<MapMan> MakeTestMapMan(TestAssets& assets)
+{
+	static const std::filesystem::path dir = []()
+		{
+			const std::filesystem::path dir = std::filesystem::temp_directory_path() / "blockeditor-tests" / "assets";
+			std::filesystem::create_directories(dir);
+			WriteBox(dir / "cube.obj", "cube", 1.0f);
+			WriteBox(dir / "slab.obj", "slab", 0.0f);
+			WriteWedge(dir / "wedge.obj");
+			return dir;
+		}();
+
+	// The textures don't exist. Without a graphics context only their paths matter.
+	auto map = std::make_unique<MapMan>();
+	map->NewMap(1, 1, 1);
+	assets.dir = dir;
+	assets.cube = map->GetOrAddModelID(dir / "cube.obj");
+	assets.wedge = map->GetOrAddModelID(dir / "wedge.obj");
+	assets.slab = map->GetOrAddModelID(dir / "slab.obj");
+	for (size_t t = 0; t < assets.textures.size(); ++t)
+	{
+		assets.textures[t] = map->GetOrAddTexID(dir / ("texture" + std::to_string(t) + ".png"));
+	}
+	return map;
+}
+
+Tile RandomTestTile(std::mt19937& random, const TestAssets& assets)
+{
+	const ModelID shapes[] = { assets.cube, assets.cube, assets.wedge, assets.slab };
+	return Tile(shapes[random() % 4], int(random() % 4) * 90, assets.textures[random() % assets.textures.size()], int(random() % 4) * 90);
+}
+
+void FillTestMap(TileGrid& grid, const TestAssets& assets, unsigned seed, float density)
+{
+	std::mt19937 random(seed);
+	grid.SetTileRect(0, 0, 0, int(grid.GetWidth()), 1, int(grid.GetLength()), Tile(assets.cube, 0, assets.textures[0], 0));
+	for (int y = 1; y < int(grid.GetHeight()); ++y)
+	{
+		for (int z = 0; z < int(grid.GetLength()); ++z)
+		{
+			for (int x = 0; x < int(grid.GetWidth()); ++x)
+			{
+				if (float(random() % 1000) < density * 1000.0f) grid.SetTile(x, y, z, RandomTestTile(random, assets));
+			}
+		}
+	}
+}
+
+void FillTestMapMan(MapMan& map, const TestAssets& assets, int width, int height, int length, unsigned seed, float density)
+{
+	map.NewMap(width, height, length);
+	FillTestMap(MapManInspector::Tiles(map), assets, seed, density);
+}
+
+TriangleKey MakeTriangleKey(const Vector3 (&corners)[3])
+{
+	TriangleKey key;
+	for (int c = 0; c < 3; ++c)
+	{
+		key[c] = { int32_t(lroundf(corners[c].x * 1024.0f)), int32_t(lroundf(corners[c].y * 1024.0f)), int32_t(lroundf(corners[c].z * 1024.0f)) };
+	}
+	std::rotate(key.begin(), std::min_element(key.begin(), key.end()), key.end());
+	return key;
+}
+
+std::map<int, std::vector<TriangleKey>> TrianglesByTexture(const RLModel& model)
+{
+	std::map<int, std::vector<TriangleKey>> triangles;
+	for (int m = 0; m < model.meshCount; ++m)
+	{
+		const RLMesh& mesh = model.meshes[m];
+		std::vector<TriangleKey>& list = triangles[model.meshMaterial[m]];
+		for (int tri = 0; tri < mesh.triangleCount; ++tri)
+		{
+			Vector3 corners[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				const float* vertex = &mesh.vertices[mesh.indices[tri * 3 + c] * 3];
+				corners[c] = Vector3{ vertex[0], vertex[1], vertex[2] };
+			}
+			list.push_back(MakeTriangleKey(corners));
+		}
+	}
+	for (auto& [texture, list] : triangles) std::sort(list.begin(), list.end());
+	return triangles;
+}
+
+std::filesystem::path MakeTestOutputDir(const std::string& name)
+{
+	const std::filesystem::path dir = std::filesystem::temp_directory_path() / "blockeditor-tests" / name;
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+	return dir;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "MapMan.h"
+
+// Shapes and textures for building test maps. The tests don't use the editor's data directory,
+// so the shapes are written to a temporary directory the first time they're needed.
+struct TestAssets final
+{
+	std::filesystem::path dir;
+	ModelID cube, wedge, slab; // The slab fills the bottom half of its cel
+	std::array<TexID, 4> textures;
+};
+
+// Returns a map manager with the test shapes and textures added to it.
+std::unique_ptr<MapMan> MakeTestMapMan(TestAssets& assets);
+
+// Returns a random non-empty tile made from the test assets, in any of the 16 tile orientations.
+Tile RandomTestTile(std::mt19937& random, const TestAssets& assets);
+
+// Fills the bottom layer of `grid` with cubes and places random tiles in about `density` of the cels above it.
+void FillTestMap(TileGrid& grid, const TestAssets& assets, unsigned seed, float density);
+
+// Makes a new map of the given size in `map`, filled like FillTestMap(). The tiles are placed directly, without undoable actions.
+void FillTestMapMan(MapMan& map, const TestAssets& assets, int width, int height, int length, unsigned seed, float density);
+
+// A triangle's corners, quantized so that tiny differences in rounding don't matter.
+// The corners are rotated to start with the smallest one, which keeps the triangle's winding.
+typedef std::array<std::array<int32_t, 3>, 3> TriangleKey;
+
+TriangleKey MakeTriangleKey(const Vector3 (&corners)[3]);
+
+// Returns the sorted triangles of each texture of a generated model.
+std::map<int, std::vector<TriangleKey>> TrianglesByTexture(const RLModel& model);
+
+// Makes a temporary directory for a test's output files, empty and named after the test.
+std::filesystem::path MakeTestOutputDir(const std::string& name);
+
+// Gives the tests access to the internals of TileGrid.
+struct TileGridInspector final
+{
+	static void RegenBatches(TileGrid& grid) { grid._RegenBatches(); }
+	// Throws away the render chunks, so that the next regen builds every batch from scratch.
+	static void ResetBatches(TileGrid& grid) { grid._renderChunks.clear(); }
+	static void SortInstances(TileGrid& grid) { grid._SortInstances(); }
+
+	static size_t InstanceCount(const TileGrid& grid) { return grid._instances.size(); }
+	static size_t PaletteSize(const TileGrid& grid) { return grid._palette.size(); }
+	// Returns the number of instances that the next upload would send.
+	static size_t PendingUploadSize(const TileGrid& grid)
+	{
+		const auto& buffer = grid._instanceBuffer;
+		if (buffer.outdated) return grid._instances.size();
+
+		size_t size = 0;
+		for (const auto& [begin, end] : buffer.dirtyRanges) size += end - begin;
+		return size;
+	}
+	// Acts as if the instances were uploaded, for measuring what single edits upload without a graphics context.
+	static void ForgetPendingUpload(TileGrid& grid)
+	{
+		grid._instanceBuffer.outdated = false;
+		grid._instanceBuffer.dirtyRanges.clear();
+	}
+
+	// Returns the instances of each layer of each non-empty batch, keyed by the batch's texture, shape and mesh.
+	static std::map<std::tuple<TexID, ModelID, int>, std::vector<std::vector<TileInstance>>> BatchLayers(const TileGrid& grid)
+	{
+		std::map<std::tuple<TexID, ModelID, int>, std::vector<std::vector<TileInstance>>> layers;
+		const size_t stride = grid.GetHeight() + 1;
+		for (size_t b = 0; b < grid._drawBatches.size(); ++b)
+		{
+			const size_t* starts = &grid._layerStarts[b * stride];
+			if (starts[0] == starts[grid.GetHeight()]) continue;
+
+			auto& batch = layers[{ grid._drawBatches[b].texture, grid._drawBatches[b].shape, grid._drawBatches[b].mesh }];
+			for (size_t y = 0; y < grid.GetHeight(); ++y)
+			{
+				batch.emplace_back(grid._instances.begin() + starts[y], grid._instances.begin() + starts[y + 1]);
+			}
+		}
+		return layers;
+	}
+};
+
+// Gives the tests access to the internals of MapMan.
+struct MapManInspector final
+{
+	static TileGrid& Tiles(MapMan& map) { return map._tileGrid; }
+	static EntGrid& Ents(MapMan& map) { return map._entGrid; }
+};
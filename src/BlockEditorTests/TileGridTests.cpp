@@ -0,0 +1,371 @@
+#include "stdafx.h"
+#include "TestMaps.h"
+#include "Test.h"
+
+// Makes a random edit: a single tile, an erased tile or a small box of one tile.
+static void RandomEdit(TileGrid& grid, std::mt19937& random, const TestAssets& assets)
+{
+	const int x = int(random() % grid.GetWidth()), y = int(random() % grid.GetHeight()), z = int(random() % grid.GetLength());
+	switch (random() % 4)
+	{
+	case 0: grid.UnsetTile(x, y, z); break;
+	case 1: grid.SetTileRect(x, y, z, Min(3, int(grid.GetWidth()) - x), 1, Min(3, int(grid.GetLength()) - z), RandomTestTile(random, assets)); break;
+	default: grid.SetTile(x, y, z, RandomTestTile(random, assets)); break;
+	}
+}
+
+TEST_CASE(PatchedBatchesMatchFullSort)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	TileGrid grid(mapMan.get(), 40, 6, 40, GridStorage::CHUNKED);
+	FillTestMap(grid, assets, 1, 0.1f);
+	TileGridInspector::RegenBatches(grid);
+
+	std::mt19937 random(2);
+	for (int round = 0; round < 40; ++round)
+	{
+		const int edits = 1 + int(random() % 8);
+		for (int e = 0; e < edits; ++e) RandomEdit(grid, random, assets);
+		TileGridInspector::RegenBatches(grid);
+
+		// A subsection of the whole grid starts over, so it sorts all of its instances from scratch.
+		TileGrid fresh = grid.Subsection(0, 0, 0, int(grid.GetWidth()), int(grid.GetHeight()), int(grid.GetLength()), GridStorage::CHUNKED);
+		TileGridInspector::RegenBatches(fresh);
+		CHECK(TileGridInspector::BatchLayers(grid) == TileGridInspector::BatchLayers(fresh));
+	}
+}
+
+TEST_CASE(UnchangedBatchesAreNotUploaded)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	TileGrid grid(mapMan.get(), 32, 4, 32, GridStorage::CHUNKED);
+	FillTestMap(grid, assets, 3, 0.1f);
+	TileGridInspector::RegenBatches(grid);
+	TileGridInspector::ForgetPendingUpload(grid);
+
+	// Nothing was edited, so nothing needs to be sent again.
+	TileGridInspector::RegenBatches(grid);
+	CHECK(TileGridInspector::PendingUploadSize(grid) == 0);
+
+	// Turning a tile only rewrites the layer of its own batch.
+	const Tile floor = grid.GetTile(5, 0, 5);
+	grid.SetTile(5, 0, 5, Tile(floor.shape, floor.angle + 90, floor.texture, floor.pitch));
+	TileGridInspector::RegenBatches(grid);
+	CHECK(TileGridInspector::PendingUploadSize(grid) > 0);
+	CHECK(TileGridInspector::PendingUploadSize(grid) <= 32 * 32);
+}
+
+// Stands in for OpenGL while it's alive, and counts what would have been sent to the GPU.
+struct RecordingBufferBackend final
+{
+	static inline size_t buffersCreated = 0, bufferUpdates = 0, bytesUploaded = 0, instancesDrawn = 0;
+	static inline unsigned int nextBufferId = 1;
+
+	rlBufferBackend previous;
+
+	RecordingBufferBackend()
+	{
+		Reset();
+		previous = rlSetBufferBackend(rlBufferBackend{
+			[](const void* buffer, int size, bool) { return Load(buffer, size); },
+			[](const void* buffer, int size, bool) { return Load(buffer, size); },
+			[](unsigned int, const void*, int dataSize, int) { ++bufferUpdates; bytesUploaded += size_t(dataSize); },
+			[](unsigned int) {},
+			[](RLMesh, RLMaterial, Matrix, float, unsigned int, int, int instances) { instancesDrawn += size_t(instances); },
+		});
+	}
+	~RecordingBufferBackend() { rlSetBufferBackend(previous); }
+
+	static void Reset() { buffersCreated = bufferUpdates = bytesUploaded = instancesDrawn = 0; }
+
+	static unsigned int Load(const void* buffer, int size)
+	{
+		++buffersCreated;
+		if (buffer) bytesUploaded += size_t(size);
+		return nextBufferId++;
+	}
+};
+
+// Returns the number of instances in the batches, without the room that's left between them.
+static size_t DrawnInstanceCount(const TileGrid& grid)
+{
+	size_t count = 0;
+	for (const auto& [key, layers] : TileGridInspector::BatchLayers(grid))
+	{
+		for (const auto& layer : layers) count += layer.size();
+	}
+	return count;
+}
+
+TEST_CASE(SteadyFramesUploadNothing)
+{
+	// The grid unloads its buffer when it's destroyed, so the backend has to outlive it.
+	RecordingBufferBackend backend;
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	TileGrid grid(mapMan.get(), 48, 6, 48, GridStorage::CHUNKED);
+	FillTestMap(grid, assets, 8, 0.1f);
+
+	grid.Draw(Vector3Zero());
+	const size_t instanceBytes = TileGridInspector::InstanceCount(grid) * sizeof(TileInstance);
+	CHECK(backend.buffersCreated == 1);
+	CHECK(backend.bytesUploaded == instanceBytes);
+	CHECK(backend.instancesDrawn == DrawnInstanceCount(grid));
+
+	// Once the instances are on the GPU, drawing the same map again only draws.
+	const int frames = 100;
+	backend.Reset();
+	for (int f = 0; f < frames; ++f) grid.Draw(Vector3Zero());
+	CHECK(backend.buffersCreated == 0);
+	CHECK(backend.bufferUpdates == 0);
+	CHECK(backend.bytesUploaded == 0);
+	CHECK(backend.instancesDrawn == frames * DrawnInstanceCount(grid));
+
+	// An edit is sent once, into the same buffer, and then the frames are steady again.
+	const Tile floor = grid.GetTile(20, 0, 20);
+	grid.SetTile(20, 0, 20, Tile(floor.shape, floor.angle + 90, floor.texture, floor.pitch));
+	backend.Reset();
+	grid.Draw(Vector3Zero());
+	CHECK(backend.buffersCreated == 0);
+	CHECK(backend.bytesUploaded > 0 && backend.bytesUploaded < instanceBytes);
+
+	backend.Reset();
+	for (int f = 0; f < frames; ++f) grid.Draw(Vector3Zero());
+	CHECK(backend.buffersCreated == 0);
+	CHECK(backend.bytesUploaded == 0);
+}
+
+TEST_CASE(FullPalettesAreCompacted)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	// Textures don't have to exist for the palette, so every cel gets a tile of its own
+	auto celTile = [&](int cel, int round) { return Tile(assets.cube, 0, round * 100000 + cel, 0); };
+	const int celCount = PALETTE_MAX_SIZE - 1;
+
+	for (GridStorage storage : { GridStorage::DENSE, GridStorage::CHUNKED })
+	{
+		TileGrid grid(mapMan.get(), 256, 1, 256, storage);
+		for (int c = 0; c < celCount; ++c) grid.SetTile(c, celTile(c, 0));
+		REQUIRE(TileGridInspector::PaletteSize(grid) == PALETTE_MAX_SIZE);
+
+		// With every entry in use, a new tile can't be placed and the cel keeps its tile
+		grid.SetTile(7, celTile(7, 1));
+		CHECK(grid.GetTile(7) == celTile(7, 0));
+		grid.SetTileRect(0, 0, 0, 4, 1, 1, celTile(0, 1));
+		CHECK(grid.GetTile(0) == celTile(0, 0));
+
+		// Entries whose tiles were painted over are reclaimed once new tiles need them
+		for (int c = 0; c < 1000; ++c) grid.SetTile(c, Tile());
+		for (int c = 0; c < 1000; ++c) grid.SetTile(c, celTile(c, 1));
+		CHECK(TileGridInspector::PaletteSize(grid) == PALETTE_MAX_SIZE);
+		bool allPlaced = true;
+		for (int c = 0; c < celCount; ++c) allPlaced = allPlaced && grid.GetTile(c) == celTile(c, (c < 1000) ? 1 : 0);
+		CHECK(allPlaced);
+
+		// Copied tiles that don't fit make room by compacting before any of them are placed
+		TileGrid stamp(mapMan.get(), 8, 1, 1, storage);
+		for (int x = 0; x < 8; ++x) stamp.SetTile(x, 0, 0, celTile(x, 2));
+		for (int x = 0; x < 8; ++x) grid.UnsetTile(100 + x, 0, 0);
+		grid.CopyTiles(0, 0, 10, stamp);
+		allPlaced = true;
+		for (int x = 0; x < 8; ++x) allPlaced = allPlaced && grid.GetTile(x, 0, 10) == celTile(x, 2);
+		CHECK(allPlaced);
+		CHECK(grid.GetTile(9, 0, 10) == celTile(10 * 256 + 9, 0));
+		CHECK(!grid.HasTile(100, 0, 0));
+	}
+}
+
+TEST_CASE(DownsamplingVotesForTilesAndTextures)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	const Tile cube(assets.cube, 0, assets.textures[0], 0), wedge(assets.wedge, 90, assets.textures[1], 0), slab(assets.slab, 0, assets.textures[2], 0);
+
+	// Each 2x2x2 block of the grid tests one rule, along X. The last block is cut short by the edge of the grid to 1x2x2.
+	TileGrid grid(mapMan.get(), 11, 2, 2, GridStorage::CHUNKED);
+	auto fillBlock = [&](int block, std::initializer_list<Tile> tiles)
+		{
+			int cel = 0;
+			for (const Tile& tile : tiles)
+			{
+				grid.SetTile(block * 2 + (cel % 2), (cel / 2) % 2, cel / 4, tile);
+				++cel;
+			}
+		};
+	fillBlock(0, { slab, slab, slab }); // Less than half
+	fillBlock(1, { slab, slab, slab, slab }); // Exactly half
+	fillBlock(2, { wedge, wedge, wedge, wedge, cube }); // A cube beats more common shapes, but takes their texture
+	fillBlock(3, { slab, slab, wedge, wedge, wedge }); // The most common texture wins
+	fillBlock(4, { wedge, wedge, slab, slab }); // Ties go to the first tile and texture found
+	grid.SetTile(10, 0, 0, slab); // Half of the short block
+	grid.SetTile(10, 1, 0, slab);
+
+	const TileGrid coarse = grid.Downsample(2);
+	REQUIRE(coarse.GetWidth() == 6 && coarse.GetHeight() == 1 && coarse.GetLength() == 1);
+	CHECK(!coarse.HasTile(0, 0, 0));
+	CHECK(coarse.GetTile(1, 0, 0) == slab);
+	CHECK(coarse.GetTile(2, 0, 0) == Tile(assets.cube, 0, assets.textures[1], 0));
+	CHECK(coarse.GetTile(3, 0, 0) == wedge);
+	CHECK(coarse.GetTile(4, 0, 0) == wedge);
+	CHECK(coarse.GetTile(5, 0, 0) == slab);
+
+	// A floor one cel thick fills half of every block at a factor of 2, but only a quarter at 4
+	TileGrid floor(mapMan.get(), 8, 8, 8, GridStorage::CHUNKED);
+	floor.SetTileRect(0, 0, 0, 8, 1, 8, cube);
+	const TileGrid floor2 = floor.Downsample(2), floor4 = floor.Downsample(4);
+	int filled2 = 0, filled4 = 0;
+	for (size_t c = 0; c < floor2.GetWidth() * floor2.GetHeight() * floor2.GetLength(); ++c) filled2 += floor2.GetTile(int(c)) ? 1 : 0;
+	for (size_t c = 0; c < floor4.GetWidth() * floor4.GetHeight() * floor4.GetLength(); ++c) filled4 += floor4.GetTile(int(c)) ? 1 : 0;
+	CHECK(filled2 == 4 * 4);
+	CHECK(filled4 == 0);
+}
+
+BENCHMARK(BatchRegenPerEdit)
+{
+	for (const auto& [width, height, length] : { std::array<int, 3>{ 128, 8, 128 }, std::array<int, 3>{ 256, 32, 256 } })
+	{
+		TestAssets assets;
+		auto mapMan = MakeTestMapMan(assets);
+		TileGrid grid(mapMan.get(), width, height, length, GridStorage::CHUNKED);
+		FillTestMap(grid, assets, 4, 0.1f);
+		TileGridInspector::RegenBatches(grid);
+		const std::string size = std::to_string(width) + "x" + std::to_string(height) + "x" + std::to_string(length) + ", ";
+
+		// This is what every edit used to cost, on top of uploading the whole buffer.
+		const double sortSeconds = MeasureSeconds([&]() { TileGridInspector::SortInstances(grid); }, 5);
+		ReportResult(size + "full sort of all instances", sortSeconds * 1e6, "us");
+		ReportResult(size + "whole instance buffer", double(TileGridInspector::InstanceCount(grid) * sizeof(TileInstance)) / 1024.0, "KiB");
+
+		std::mt19937 random(5);
+		const int editCount = 2000;
+		size_t uploaded = 0;
+		double seconds = 0.0;
+		for (int e = 0; e < editCount; ++e)
+		{
+			TileGridInspector::ForgetPendingUpload(grid);
+			const int x = int(random() % grid.GetWidth()), y = int(random() % grid.GetHeight()), z = int(random() % grid.GetLength());
+			if (random() % 2) grid.SetTile(x, y, z, RandomTestTile(random, assets));
+			else grid.UnsetTile(x, y, z);
+
+			seconds += MeasureSeconds([&]() { TileGridInspector::RegenBatches(grid); });
+			uploaded += TileGridInspector::PendingUploadSize(grid);
+		}
+		ReportResult(size + "regen after one tile edit", seconds * 1e6 / editCount, "us");
+		ReportResult(size + "uploaded per tile edit", double(uploaded * sizeof(TileInstance)) / editCount / 1024.0, "KiB");
+	}
+}
+
+// The batch layout that TileGrid used before its dense batch table, kept to compare regen times against:
+// per chunk and for the whole grid, a map from texture and mesh to the matrices of their instances.
+struct MapBatchLayout final
+{
+	typedef std::map<std::pair<TexID, RLMesh*>, std::vector<Matrix>> ChunkBatches;
+	struct DrawBatch
+	{
+		std::vector<Matrix> matrices;
+		std::vector<size_t> layerStarts;
+	};
+
+	std::vector<ChunkBatches> chunks;
+	std::map<std::pair<TexID, RLMesh*>, DrawBatch> drawBatches;
+	int chunksX = 0, chunksZ = 0;
+
+	void RegenChunk(const TileGrid& grid, const MapMan& mapMan, int cx, int y, int cz)
+	{
+		ChunkBatches& chunk = chunks[(y * chunksZ + cz) * chunksX + cx];
+		chunk.clear();
+		for (int z = cz * GRID_CHUNK_SIZE; z < Min((cz + 1) * GRID_CHUNK_SIZE, int(grid.GetLength())); ++z)
+		{
+			for (int x = cx * GRID_CHUNK_SIZE; x < Min((cx + 1) * GRID_CHUNK_SIZE, int(grid.GetWidth())); ++x)
+			{
+				const Tile tile = grid.GetTile(x, y, z);
+				if (!tile) continue;
+
+				const Vector3 worldPos = grid.GridToWorldPos(Vector3{ float(x), float(y), float(z) }, true);
+				const Matrix matrix = MatrixMultiply(TileRotationMatrix(tile), MatrixTranslate(worldPos.x, worldPos.y, worldPos.z));
+				const RLModel shape = mapMan.ModelFromID(tile.shape);
+				for (int m = 0; m < shape.meshCount; ++m)
+				{
+					chunk[std::make_pair(tile.texture, &shape.meshes[m])].push_back(matrix);
+				}
+			}
+		}
+	}
+
+	// Regenerates the chunks in `dirty` (or all of them if it's null), then concatenates every chunk into the draw batches.
+	void Regen(const TileGrid& grid, const MapMan& mapMan, const std::vector<std::array<int, 3>>* dirty)
+	{
+		chunksX = int((grid.GetWidth() + GRID_CHUNK_SIZE - 1) / GRID_CHUNK_SIZE);
+		chunksZ = int((grid.GetLength() + GRID_CHUNK_SIZE - 1) / GRID_CHUNK_SIZE);
+		if (!dirty)
+		{
+			chunks.assign(size_t(chunksX * chunksZ) * grid.GetHeight(), ChunkBatches());
+			for (int y = 0; y < int(grid.GetHeight()); ++y)
+				for (int cz = 0; cz < chunksZ; ++cz)
+					for (int cx = 0; cx < chunksX; ++cx) RegenChunk(grid, mapMan, cx, y, cz);
+		}
+		else
+		{
+			for (const auto& [cx, y, cz] : *dirty) RegenChunk(grid, mapMan, cx, y, cz);
+		}
+
+		drawBatches.clear();
+		for (int y = 0; y < int(grid.GetHeight()); ++y)
+		{
+			for (size_t c = y * chunksX * chunksZ; c < (y + 1) * size_t(chunksX * chunksZ); ++c)
+			{
+				for (const auto& [key, matrices] : chunks[c])
+				{
+					DrawBatch& batch = drawBatches[key];
+					if (batch.layerStarts.empty()) batch.layerStarts.assign(grid.GetHeight() + 1, 0);
+					batch.matrices.insert(batch.matrices.end(), matrices.begin(), matrices.end());
+				}
+			}
+			for (auto& [key, batch] : drawBatches) batch.layerStarts[y + 1] = batch.matrices.size();
+		}
+	}
+
+	size_t InstanceCount() const
+	{
+		size_t count = 0;
+		for (const auto& [key, batch] : drawBatches) count += batch.matrices.size();
+		return count;
+	}
+};
+
+BENCHMARK(BatchRegen)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	TileGrid grid(mapMan.get(), 128, 8, 128, GridStorage::CHUNKED);
+	FillTestMap(grid, assets, 6, 0.1f);
+
+	MapBatchLayout mapLayout;
+	const double mapFullSeconds = MeasureSeconds([&]() { mapLayout.Regen(grid, *mapMan, nullptr); }, 5);
+	const double tableFullSeconds = MeasureSeconds([&]()
+		{
+			TileGridInspector::ResetBatches(grid);
+			TileGridInspector::RegenBatches(grid);
+		}, 5);
+	CHECK(mapLayout.InstanceCount() == DrawnInstanceCount(grid));
+	ReportResult("full regen, map of matrices (before)", mapFullSeconds * 1e3, "ms");
+	ReportResult("full regen, batch table (after)", tableFullSeconds * 1e3, "ms");
+
+	// A regen after an edit only has one dirty chunk, but the old layout still concatenated every chunk again.
+	std::mt19937 random(7);
+	const int editCount = 200;
+	double mapEditSeconds = 0.0, tableEditSeconds = 0.0;
+	for (int e = 0; e < editCount; ++e)
+	{
+		const int x = int(random() % grid.GetWidth()), y = int(random() % grid.GetHeight()), z = int(random() % grid.GetLength());
+		grid.SetTile(x, y, z, RandomTestTile(random, assets));
+		const std::vector<std::array<int, 3>> dirty = { { x / GRID_CHUNK_SIZE, y, z / GRID_CHUNK_SIZE } };
+		mapEditSeconds += MeasureSeconds([&]() { mapLayout.Regen(grid, *mapMan, &dirty); });
+		tableEditSeconds += MeasureSeconds([&]() { TileGridInspector::RegenBatches(grid); });
+	}
+	ReportResult("regen after one edit, map of matrices (before)", mapEditSeconds * 1e3 / editCount, "ms");
+	ReportResult("regen after one edit, batch table (after)", tableEditSeconds * 1e3 / editCount, "ms");
+}
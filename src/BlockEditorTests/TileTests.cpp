@@ -0,0 +1,131 @@
+#include "stdafx.h"
+#include "Tile.h"
+#include "Test.h"
+
+// Grid coordinates at both ends of what a TileInstance can hold, and some in between.
+static const int EXTREME_COORDINATES[] = { 0, 1, 255, 4096, 65534, 65535 };
+
+// The corners of a cel-sized shape, plus a point that isn't symmetric about any axis.
+static const Vector3 SHAPE_POINTS[] = {
+	{ -1.0f, -1.0f, -1.0f }, { 1.0f, -1.0f, -1.0f }, { -1.0f, 1.0f, -1.0f }, { 1.0f, 1.0f, -1.0f },
+	{ -1.0f, -1.0f, 1.0f }, { 1.0f, -1.0f, 1.0f }, { -1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f },
+	{ 0.25f, -0.5f, 0.75f },
+};
+
+// Returns true if both transforms move every point of SHAPE_POINTS to the same place,
+// give or take the precision of floats at the distance of the point from the origin.
+static bool SameTransform(const Matrix& a, const Matrix& b)
+{
+	for (const Vector3& point : SHAPE_POINTS)
+	{
+		const Vector3 pa = Vector3Transform(point, a), pb = Vector3Transform(point, b);
+		const float tolerance = 1e-4f + sqrtf(Vector3DotProduct(pa, pa)) * 1e-6f;
+		if (fabsf(pa.x - pb.x) > tolerance || fabsf(pa.y - pb.y) > tolerance || fabsf(pa.z - pb.z) > tolerance) return false;
+	}
+	return true;
+}
+
+// Transforms a point the way the packed map shader does, from the axes that Assets uploads for each orientation.
+static Vector3 ShaderTransform(const TileInstance& instance, float spacing, Vector3 point)
+{
+	const Matrix& m = TileOrientationMatrices()[instance.orientation];
+	const Vector3 axes[3] = { { m.m0, m.m1, m.m2 }, { m.m4, m.m5, m.m6 }, { m.m8, m.m9, m.m10 } };
+	Vector3 position = Vector3Add(Vector3Add(Vector3Scale(axes[0], point.x), Vector3Scale(axes[1], point.y)), Vector3Scale(axes[2], point.z));
+	position.x += (float(instance.x) + 0.5f) * spacing;
+	position.y += (float(instance.y) + 0.5f) * spacing;
+	position.z += (float(instance.z) + 0.5f) * spacing;
+	return position;
+}
+
+TEST_CASE(TileOrientationsAreDistinctRotations)
+{
+	const auto& orientations = TileOrientationMatrices();
+	for (int o = 0; o < TILE_ORIENTATION_COUNT; ++o)
+	{
+		const Matrix& m = orientations[o];
+		// A rotation keeps the handedness of the axes, so the Z axis is the cross product of the other two.
+		CHECK(Vector3Equals(Vector3CrossProduct(Vector3{ m.m0, m.m1, m.m2 }, Vector3{ m.m4, m.m5, m.m6 }), Vector3{ m.m8, m.m9, m.m10 }));
+		CHECK(m.m3 == 0.0f && m.m7 == 0.0f && m.m11 == 0.0f && m.m12 == 0.0f && m.m13 == 0.0f && m.m14 == 0.0f && m.m15 == 1.0f);
+		for (int p = 0; p < o; ++p) CHECK(!SameTransform(m, orientations[p]));
+
+		// The first 16 are the tile rotations, and the rest add a roll around the Z axis to one of them.
+		if (o < 16)
+		{
+			CHECK(SameTransform(m, TileRotationMatrix(Tile(NO_MODEL, (o % 4) * 90, NO_TEX, (o / 4) * 90))));
+		}
+		else
+		{
+			bool found = false;
+			for (int roll = 90; roll < 360 && !found; roll += 90)
+			{
+				for (int t = 0; t < 16 && !found; ++t)
+				{
+					found = SameTransform(m, MatrixMultiply(MatrixRotate(Vector3{ 0.0f, 0.0f, 1.0f }, ToRadians(float(roll))), orientations[t]));
+				}
+			}
+			CHECK(found);
+		}
+	}
+}
+
+TEST_CASE(PackedTilesMatchTileTransforms)
+{
+	for (float spacing : { TILE_SPACING_DEFAULT, 1.0f, 0.375f, 7.5f })
+	{
+		// Angles outside of 0 to 270 wrap around to the same orientations.
+		for (int pitch = -180; pitch <= 450; pitch += 90)
+		{
+			for (int yaw = -180; yaw <= 450; yaw += 90)
+			{
+				const Tile tile(0, yaw, 0, pitch);
+				const Matrix rotation = TileRotationMatrix(tile);
+				for (int x : EXTREME_COORDINATES)
+				{
+					for (int y : EXTREME_COORDINATES)
+					{
+						for (int z : EXTREME_COORDINATES)
+						{
+							const TileInstance instance = PackTileInstance(x, y, z, tile);
+							CHECK(instance.x == x && instance.y == y && instance.z == z);
+							CHECK(instance.orientation < 16);
+
+							// This is the transform TileGrid used to build for each tile before instances were packed.
+							const Vector3 center = { (float(x) + 0.5f) * spacing, (float(y) + 0.5f) * spacing, (float(z) + 0.5f) * spacing };
+							CHECK(SameTransform(UnpackTileInstance(instance, spacing), MatrixMultiply(rotation, MatrixTranslate(center.x, center.y, center.z))));
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE(UnpackedTilesMatchShader)
+{
+	for (float spacing : { TILE_SPACING_DEFAULT, 0.375f })
+	{
+		for (int o = 0; o < TILE_ORIENTATION_COUNT; ++o)
+		{
+			for (int x : EXTREME_COORDINATES)
+			{
+				for (int y : EXTREME_COORDINATES)
+				{
+					for (int z : EXTREME_COORDINATES)
+					{
+						const TileInstance instance = { uint16_t(x), uint16_t(y), uint16_t(z), uint16_t(o) };
+						const Matrix matrix = UnpackTileInstance(instance, spacing);
+						for (const Vector3& point : SHAPE_POINTS)
+						{
+							const Vector3 fromMatrix = Vector3Transform(point, matrix);
+							const Vector3 fromShader = ShaderTransform(instance, spacing, point);
+							const float tolerance = 1e-4f + sqrtf(Vector3DotProduct(fromMatrix, fromMatrix)) * 1e-6f;
+							CHECK(fabsf(fromMatrix.x - fromShader.x) <= tolerance);
+							CHECK(fabsf(fromMatrix.y - fromShader.y) <= tolerance);
+							CHECK(fabsf(fromMatrix.z - fromShader.z) <= tolerance);
+						}
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,136 @@
+#include "stdafx.h"
+#include "TestMaps.h"
+#include "Test.h"
+#include "WorkerPool.h"
+
+// Sets the number of threads of the worker pool until it goes out of scope.
+struct ScopedThreadCount final
+{
+	int previous;
+
+	explicit ScopedThreadCount(int count) : previous(WorkerPool::GetThreadCount()) { WorkerPool::SetThreadCount(count); }
+	~ScopedThreadCount() { WorkerPool::SetThreadCount(previous); }
+};
+
+// Returns the bytes of every array of every mesh of the model, along with the mesh sizes and materials.
+static std::vector<uint8_t> ModelBytes(const RLModel& model)
+{
+	std::vector<uint8_t> bytes;
+	const auto append = [&](const void* data, size_t size)
+		{
+			if (data) bytes.insert(bytes.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+		};
+	append(model.meshMaterial, sizeof(int) * model.meshCount);
+	for (int m = 0; m < model.meshCount; ++m)
+	{
+		const RLMesh& mesh = model.meshes[m];
+		append(&mesh.vertexCount, sizeof(int));
+		append(&mesh.triangleCount, sizeof(int));
+		append(mesh.vertices, sizeof(float) * 3 * mesh.vertexCount);
+		append(mesh.texcoords, sizeof(float) * 2 * mesh.vertexCount);
+		append(mesh.normals, sizeof(float) * 3 * mesh.vertexCount);
+		append(mesh.indices, sizeof(unsigned short) * 3 * mesh.triangleCount);
+	}
+	return bytes;
+}
+
+TEST_CASE(JobExceptionsReachTheCaller)
+{
+	ScopedThreadCount threads(4);
+
+	// Throwing on every iteration makes the workers throw as well as the calling thread. Only one exception comes out.
+	for (size_t thrower : { size_t(37), SIZE_MAX })
+	{
+		std::atomic<size_t> calls = 0;
+		bool caught = false;
+		try
+		{
+			WorkerPool::ParallelFor(1000, [&](size_t i)
+				{
+					++calls;
+					if (thrower == SIZE_MAX || i == thrower) throw std::runtime_error("job failed");
+				});
+		}
+		catch (const std::runtime_error& error)
+		{
+			caught = std::string(error.what()) == "job failed";
+		}
+		CHECK(caught);
+		CHECK(calls < 1000);
+	}
+
+	// The calling thread has to be out of its job, or the next loop would run inline on it alone.
+	std::mutex idMutex;
+	std::set<std::thread::id> ids;
+	std::vector<int> results(64, 0);
+	WorkerPool::ParallelFor(results.size(), [&](size_t i)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			results[i] = int(i);
+			std::lock_guard<std::mutex> lock(idMutex);
+			ids.insert(std::this_thread::get_id());
+		});
+	CHECK(ids.size() > 1);
+	for (size_t i = 0; i < results.size(); ++i) CHECK(results[i] == int(i));
+}
+
+TEST_CASE(GeneratedModelsDontDependOnThreadCount)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	TileGrid grid(mapMan.get(), 64, 6, 64, GridStorage::CHUNKED);
+	FillTestMap(grid, assets, 18, 0.3f);
+
+	for (const auto& [culling, greedy, weld, chunkSize] : { std::tuple{ false, false, false, 0 }, { true, false, false, 0 }, { true, true, true, 0 }, { true, true, true, 16 } })
+	{
+		std::vector<uint8_t> serialBytes;
+		std::vector<size_t> serialChunks;
+		for (int threadCount : { 1, 2, 4, 16 })
+		{
+			ScopedThreadCount threads(threadCount);
+			std::vector<size_t> meshChunks;
+			RLModel model = grid.GenerateModel(culling, greedy, weld, nullptr, chunkSize, &meshChunks);
+			if (threadCount == 1)
+			{
+				serialBytes = ModelBytes(model);
+				serialChunks = meshChunks;
+			}
+			else
+			{
+				CHECK(ModelBytes(model) == serialBytes);
+				CHECK(meshChunks == serialChunks);
+			}
+			UnloadModel(model);
+		}
+	}
+}
+
+BENCHMARK(ModelGenerationScaling)
+{
+	TestAssets assets;
+	auto mapMan = MakeTestMapMan(assets);
+	TileGrid grid(mapMan.get(), 128, 8, 128, GridStorage::CHUNKED);
+	FillTestMap(grid, assets, 9, 0.1f);
+	TileGridInspector::RegenBatches(grid);
+
+	std::cout << "    " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+	for (const auto& [culling, greedy, weld] : { std::tuple{ true, false, false }, { true, true, true } })
+	{
+		const std::string label = std::string("128x8x128, ") + (greedy ? "culled, greedy, welded" : "culled");
+		double serialSeconds = 0.0;
+		for (int threadCount : { 1, 2, 4, 8, 16 })
+		{
+			ScopedThreadCount threads(threadCount);
+			double best = DBL_MAX;
+			for (int r = 0; r < 3; ++r)
+			{
+				RLModel model{};
+				best = std::min(best, MeasureSeconds([&]() { model = grid.GenerateModel(culling, greedy, weld); }));
+				UnloadModel(model);
+			}
+			if (threadCount == 1) serialSeconds = best;
+			ReportResult(label + ", " + std::to_string(threadCount) + " threads", best * 1e3, "ms");
+			ReportResult(label + ", " + std::to_string(threadCount) + " threads, speedup", serialSeconds / best, "x");
+		}
+	}
+}
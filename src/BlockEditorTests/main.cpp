@@ -0,0 +1,102 @@
+#include "stdafx.h"
+#include "Core.h"
+#include "Assets.h"
+#include "Test.h"
+//-----------------------------------------------------------------------------
+#if defined(_MSC_VER)
+#	pragma comment( lib, "Engine.lib" )
+#	pragma comment( lib, "psapi.lib" )
+#endif
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	define NOGDI
+#	define NOUSER
+#	include <windows.h>
+#	include <psapi.h>
+#else
+#	include <unistd.h>
+#endif
+//-----------------------------------------------------------------------------
+// Runs the editor's unit tests, or its benchmarks with --bench. Any other arguments select the tests whose names contain them.
+// Like blockeditor-cli, this runs without a window or a graphics context.
+//-----------------------------------------------------------------------------
+static size_t failedChecks = 0;
+//-----------------------------------------------------------------------------
+std::vector<TestCase>& GetTestCases()
+{
+	static std::vector<TestCase> testCases;
+	return testCases;
+}
+//-----------------------------------------------------------------------------
+size_t GetMemoryUsage()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PagefileUsage;
+#else
+	// The second number is the resident set size in pages
+	std::ifstream statm("/proc/self/statm");
+	size_t pages = 0, resident = 0;
+	statm >> pages >> resident;
+	return resident * size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+//-----------------------------------------------------------------------------
+void ReportFailure(const char* file, int line, const char* expression)
+{
+	std::cerr << "    FAILED: " << std::filesystem::path(file).filename().string() << "(" << line << "): " << expression << std::endl;
+	++failedChecks;
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	bool benchmarks = false;
+	std::vector<std::string> filters;
+	for (int a = 1; a < argc; ++a)
+	{
+		const std::string arg = argv[a];
+		if (arg == "--bench") benchmarks = true;
+		else filters.push_back(arg);
+	}
+
+	Assets::SetHeadless(true);
+
+	size_t ran = 0, failed = 0;
+	for (const TestCase& test : GetTestCases())
+	{
+		if (test.benchmark != benchmarks) continue;
+		if (!filters.empty() && std::none_of(filters.begin(), filters.end(), [&](const std::string& f) { return std::string(test.name).find(f) != std::string::npos; }))
+			continue;
+
+		std::cout << test.name << std::endl;
+		const size_t failedBefore = failedChecks;
+		const auto startTime = std::chrono::steady_clock::now();
+		try
+		{
+			test.function();
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "    FAILED: Exception: " << e.what() << std::endl;
+			++failedChecks;
+		}
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+		++ran;
+		if (failedChecks > failedBefore)
+		{
+			++failed;
+			std::cerr << "    FAIL (" << ms << " ms)" << std::endl;
+		}
+		else
+		{
+			std::cout << "    ok (" << ms << " ms)" << std::endl;
+		}
+	}
+
+	std::cout << ran - failed << " of " << ran << (benchmarks ? " benchmarks" : " tests") << " passed." << std::endl;
+	return (failed > 0) ? 1 : 0;
+}
+//-----------------------------------------------------------------------------